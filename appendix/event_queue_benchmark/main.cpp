@@ -0,0 +1,113 @@
+#include "event_queue.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace {
+// The previous implementation: `std::vector` with `erase(std::begin(events_))`.
+class vector_drain final {
+public:
+  void push_back_event(const krbn::event_queue::queued_event& queued_event) {
+    events_.push_back(queued_event);
+  }
+
+  bool empty(void) const {
+    return events_.empty();
+  }
+
+  krbn::event_queue::queued_event& get_front_event(void) {
+    return events_.front();
+  }
+
+  void erase_front_event(void) {
+    events_.erase(std::begin(events_));
+  }
+
+  void clear_events(void) {
+    events_.clear();
+  }
+
+private:
+  std::vector<krbn::event_queue::queued_event> events_;
+};
+
+std::vector<krbn::event_queue::queued_event> make_macro_events(size_t size) {
+  std::vector<krbn::event_queue::queued_event> events;
+  krbn::event_queue::queued_event::event a(krbn::key_code::a);
+  for (size_t i = 0; i < size; ++i) {
+    events.emplace_back(krbn::device_id(1),
+                        i,
+                        a,
+                        i % 2 == 0 ? krbn::event_type::key_down : krbn::event_type::key_up,
+                        a);
+  }
+  return events;
+}
+
+std::vector<krbn::event_queue::queued_event> make_mouse_events(size_t size) {
+  // 1000 Hz mouse: pointing_x and pointing_y every millisecond.
+  std::vector<krbn::event_queue::queued_event> events;
+  for (size_t i = 0; i < size; ++i) {
+    krbn::event_queue::queued_event::event e(i % 2 == 0 ? krbn::event_queue::queued_event::event::type::pointing_x
+                                                        : krbn::event_queue::queued_event::event::type::pointing_y,
+                                             1);
+    events.emplace_back(krbn::device_id(2),
+                        i / 2 * 1000000,
+                        e,
+                        krbn::event_type::single,
+                        e);
+  }
+  return events;
+}
+
+template <typename T>
+double measure(T& queue,
+               const std::vector<krbn::event_queue::queued_event>& events,
+               int iterations) {
+  std::chrono::duration<double, std::micro> total(0);
+
+  for (int i = 0; i < iterations; ++i) {
+    for (const auto& e : events) {
+      queue.push_back_event(e);
+    }
+
+    // Measure drain cost only.
+
+    auto begin = std::chrono::high_resolution_clock::now();
+
+    while (!queue.empty()) {
+      queue.get_front_event();
+      queue.erase_front_event();
+    }
+
+    total += std::chrono::high_resolution_clock::now() - begin;
+
+    queue.clear_events();
+  }
+
+  return total.count() / iterations;
+}
+
+void run(const std::string& name,
+         const std::vector<krbn::event_queue::queued_event>& events) {
+  int iterations = events.size() < 1000 ? 10000 : 10;
+
+  vector_drain before;
+  krbn::event_queue after;
+
+  std::cout << name << " (" << events.size() << " events)" << std::endl;
+  std::cout << "  std::vector erase front: " << measure(before, events, iterations) << " us/burst" << std::endl;
+  std::cout << "  event_queue:             " << measure(after, events, iterations) << " us/burst" << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  for (const auto& size : {10, 100, 10000}) {
+    run("macro replay", make_macro_events(size));
+    run("1000 Hz mouse", make_mouse_events(size));
+  }
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include "core_configuration.hpp"
+#include "manipulator/profile_manipulators_builder.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+
+namespace {
+const int iterations = 100;
+
+// Returns json files in `examples/` which can be parsed. (Some files are not karabiner.json.)
+std::vector<std::string> find_example_files(const std::string& directory) {
+  std::vector<std::string> file_paths;
+
+  if (auto dir = opendir(directory.c_str())) {
+    while (auto entry = readdir(dir)) {
+      std::string name(entry->d_name);
+      if (name.size() < 5 || name.compare(name.size() - 5, 5, ".json") != 0) {
+        continue;
+      }
+
+      auto file_path = directory + "/" + name;
+      try {
+        std::ifstream input(file_path);
+        auto json = nlohmann::json::parse(input);
+        if (json.is_object() && json.find("profiles") != std::end(json)) {
+          file_paths.push_back(file_path);
+        }
+      } catch (std::exception&) {
+      }
+    }
+    closedir(dir);
+  }
+
+  std::sort(std::begin(file_paths), std::end(file_paths));
+
+  return file_paths;
+}
+
+template <typename F>
+void measure(const std::string& name, F f) {
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (int i = 0; i < iterations; ++i) {
+    f(i);
+  }
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - begin;
+  std::cout << "  " << name << elapsed.count() / iterations << " ms/iteration" << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  auto file_paths = find_example_files(argc > 1 ? argv[1] : "../../examples");
+
+  std::cout << "parsing " << file_paths.size() << " files in examples" << std::endl;
+
+  size_t manipulators_size = 0;
+  measure("core_configuration + profile_manipulators_builder::build: ", [&](int i) {
+    manipulators_size = 0;
+    for (const auto& file_path : file_paths) {
+      // Use a new builder in order to avoid reusing manipulators.
+      krbn::manipulator::profile_manipulators_builder builder;
+      auto snapshot = builder.build(std::make_shared<krbn::core_configuration>(file_path));
+      manipulators_size += snapshot->get_simple_modifications_manipulators().size() +
+                           snapshot->get_complex_modifications_manipulators().size();
+    }
+  });
+  std::cout << "    (" << manipulators_size << " manipulators)" << std::endl;
+
+  // The same as EventViewer and the manipulator_environment json.
+  std::vector<krbn::event_queue::queued_event::event> events;
+  for (uint32_t i = 0; i < 0x100; ++i) {
+    events.emplace_back(krbn::key_code(i));
+  }
+  for (uint32_t i = 0; i < 0x100; ++i) {
+    events.emplace_back(krbn::consumer_key_code(i));
+  }
+  for (uint32_t i = 0; i <= 32; ++i) {
+    events.emplace_back(krbn::pointing_button(i));
+  }
+
+  std::vector<std::string> key_code_names;
+  for (uint32_t i = 0; i < 0x100; ++i) {
+    if (auto name = krbn::types::make_key_code_name(krbn::key_code(i))) {
+      key_code_names.push_back(*name);
+    }
+  }
+
+  size_t found_size = 0;
+  measure("types::make_key_code_name + types::make_key_code: ", [&](int i) {
+    for (int j = 0; j < 100; ++j) {
+      for (uint32_t k = 0; k < 0x100; ++k) {
+        if (krbn::types::make_key_code_name(krbn::key_code(k))) {
+          ++found_size;
+        }
+      }
+      for (const auto& name : key_code_names) {
+        if (krbn::types::make_key_code(name)) {
+          ++found_size;
+        }
+      }
+    }
+  });
+
+  size_t json_size = 0;
+  measure("event::to_json: ", [&](int i) {
+    for (int j = 0; j < 100; ++j) {
+      for (const auto& e : events) {
+        json_size += e.to_json().size();
+      }
+    }
+  });
+
+  return 0;
+}
@@ -0,0 +1,72 @@
+#include "core_configuration.hpp"
+#include "manipulator/details/basic.hpp"
+#include "manipulator/manipulator_manager.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace {
+const int steps_size = 20;
+const int iterations = 20000;
+
+// A macro mapping which types 20 keys. (Every other key is shifted.)
+nlohmann::json make_json(void) {
+  std::vector<std::string> key_codes({"a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m",
+                                      "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z"});
+
+  auto json = nlohmann::json::object();
+  json["type"] = "basic";
+  json["from"]["key_code"] = "f1";
+  json["to"] = nlohmann::json::array();
+
+  for (int i = 0; i < steps_size; ++i) {
+    auto to = nlohmann::json::object();
+    to["key_code"] = key_codes[i % key_codes.size()];
+    if (i % 2 == 0) {
+      to["modifiers"] = nlohmann::json::array({"left_shift"});
+    }
+    json["to"].push_back(to);
+  }
+
+  return json;
+}
+
+template <typename F>
+void measure(const std::string& name, F f) {
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (int i = 0; i < iterations; ++i) {
+    f(i);
+  }
+
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - begin;
+  std::cout << "  " << name << elapsed.count() / iterations << " us/firing" << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  auto json = make_json();
+  krbn::core_configuration::profile::complex_modifications::parameters parameters;
+
+  std::cout << "firing a " << steps_size << "-step macro mapping" << std::endl;
+
+  krbn::manipulator::manipulator_manager manager;
+  manager.push_back_manipulator(std::make_shared<krbn::manipulator::details::basic>(json, parameters));
+
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  auto output_event_queue = std::make_shared<krbn::event_queue>();
+
+  krbn::event_queue::queued_event::event event(krbn::key_code::f1);
+
+  measure("basic::manipulate (key_down + key_up): ", [&](int i) {
+    uint64_t time_stamp = 1000 + i * 1000;
+    input_event_queue->emplace_back_event(krbn::device_id(1), time_stamp, event, krbn::event_type::key_down, event);
+    input_event_queue->emplace_back_event(krbn::device_id(1), time_stamp + 500, event, krbn::event_type::key_up, event);
+    manager.manipulate(input_event_queue, output_event_queue);
+    output_event_queue->clear_events();
+  });
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include "manipulator/manipulator_manager.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace {
+// The previous `manipulator_manager::manipulate` which calls all manipulators for each event.
+class linear_manipulator_manager final {
+public:
+  void push_back_manipulator(std::shared_ptr<krbn::manipulator::details::base> ptr) {
+    manipulators_.push_back(ptr);
+  }
+
+  void manipulate(const std::shared_ptr<krbn::event_queue>& input_event_queue,
+                  const std::shared_ptr<krbn::event_queue>& output_event_queue) {
+    while (!input_event_queue->empty()) {
+      auto& front_input_event = input_event_queue->get_front_event();
+
+      for (auto&& m : manipulators_) {
+        m->manipulate(front_input_event,
+                      *input_event_queue,
+                      output_event_queue);
+      }
+
+      if (input_event_queue->get_front_event().get_valid()) {
+        output_event_queue->push_back_event(input_event_queue->get_front_event());
+      }
+
+      input_event_queue->erase_front_event();
+    }
+  }
+
+private:
+  std::vector<std::shared_ptr<krbn::manipulator::details::base>> manipulators_;
+};
+
+const std::vector<std::string> key_codes({
+    "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m",
+    "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z",
+    "1", "2", "3", "4", "5", "6", "7", "8", "9", "0",
+    "f1", "f2", "f3", "f4", "f5", "f6", "f7", "f8", "f9", "f10", "f11", "f12",
+});
+
+std::vector<nlohmann::json> make_manipulator_jsons(size_t size) {
+  // emacs-like bindings: control-<key> -> other key.
+  std::mt19937 engine(1234);
+  std::uniform_int_distribution<size_t> key_code_distribution(0, key_codes.size() - 1);
+
+  std::vector<nlohmann::json> result;
+  for (size_t i = 0; i < size; ++i) {
+    nlohmann::json json;
+    json["type"] = "basic";
+    json["from"]["key_code"] = key_codes[key_code_distribution(engine)];
+    json["from"]["modifiers"]["mandatory"] = nlohmann::json::array({"control"});
+    json["to"] = nlohmann::json::array({{{"key_code", key_codes[key_code_distribution(engine)]}}});
+    result.push_back(json);
+  }
+  return result;
+}
+
+template <typename T>
+double measure(T& manager,
+               int iterations) {
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  auto output_event_queue = std::make_shared<krbn::event_queue>();
+
+  std::mt19937 engine(5678);
+  std::uniform_int_distribution<size_t> key_code_distribution(0, key_codes.size() - 1);
+
+  std::chrono::duration<double, std::micro> total(0);
+  uint64_t time_stamp = 0;
+
+  for (int i = 0; i < iterations; ++i) {
+    krbn::event_queue::queued_event::event event(*krbn::types::make_key_code(key_codes[key_code_distribution(engine)]));
+
+    for (const auto& event_type : {krbn::event_type::key_down, krbn::event_type::key_up}) {
+      input_event_queue->emplace_back_event(krbn::device_id(1), ++time_stamp, event, event_type, event);
+
+      auto begin = std::chrono::high_resolution_clock::now();
+      manager.manipulate(input_event_queue, output_event_queue);
+      total += std::chrono::high_resolution_clock::now() - begin;
+
+      output_event_queue->clear_events();
+    }
+  }
+
+  return total.count() / (iterations * 2);
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  for (const auto& size : {10, 100, 1000}) {
+    krbn::core_configuration::profile::complex_modifications::parameters parameters;
+    linear_manipulator_manager before;
+    krbn::manipulator::manipulator_manager after;
+
+    for (const auto& json : make_manipulator_jsons(size)) {
+      before.push_back_manipulator(krbn::manipulator::manipulator_factory::make_manipulator(json, parameters));
+      after.push_back_manipulator(krbn::manipulator::manipulator_factory::make_manipulator(json, parameters));
+    }
+
+    std::cout << size << " manipulators" << std::endl;
+    std::cout << "  linear scan:    " << measure(before, 10000) << " us/event" << std::endl;
+    std::cout << "  dispatch table: " << measure(after, 10000) << " us/event" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include "core_configuration.hpp"
+#include "manipulator/manipulator_cache.hpp"
+#include "manipulator/manipulator_manager.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace {
+const int rules_size = 100;
+const int manipulators_size_per_rule = 10;
+
+// A profile which has 1000 manipulators.
+// The rule at `disabled_rule_index` is omitted. (Toggling a rule in Preferences.)
+krbn::core_configuration::profile::complex_modifications make_complex_modifications(int disabled_rule_index) {
+  std::vector<std::string> key_codes({"a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m",
+                                      "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z"});
+
+  auto json = nlohmann::json::object();
+  json["rules"] = nlohmann::json::array();
+
+  for (int i = 0; i < rules_size; ++i) {
+    if (i == disabled_rule_index) {
+      continue;
+    }
+
+    auto rule = nlohmann::json::object();
+    rule["description"] = "rule " + std::to_string(i);
+    rule["manipulators"] = nlohmann::json::array();
+
+    for (int j = 0; j < manipulators_size_per_rule; ++j) {
+      auto from = key_codes[(i + j) % key_codes.size()];
+      auto to = key_codes[(i * 7 + j) % key_codes.size()];
+
+      rule["manipulators"].push_back(nlohmann::json::parse(R"(
+        {
+          "type": "basic",
+          "from": {
+            "key_code": ")" + from + R"(",
+            "modifiers": {"mandatory": ["left_control"], "optional": ["any"]}
+          },
+          "to": [{"key_code": ")" + to + R"(", "modifiers": ["left_command"]}],
+          "to_if_alone": [{"key_code": "escape"}],
+          "conditions": [
+            {
+              "type": "frontmost_application_unless",
+              "bundle_identifiers": ["^com\\.vendor)" + std::to_string(i) + R"(\\.", "^com\\.apple\\.Terminal$"]
+            },
+            {
+              "type": "variable_if",
+              "name": "mode)" + std::to_string(j) + R"(",
+              "value": 1
+            }
+          ]
+        }
+      )"));
+    }
+
+    json["rules"].push_back(rule);
+  }
+
+  return krbn::core_configuration::profile::complex_modifications(json);
+}
+
+std::shared_ptr<krbn::manipulator::details::base> make_manipulator(const krbn::core_configuration::profile::complex_modifications::rule::manipulator& manipulator) {
+  auto m = krbn::manipulator::manipulator_factory::make_manipulator(manipulator.get_json(), manipulator.get_parameters());
+  for (const auto& c : manipulator.get_conditions()) {
+    m->push_back_condition(krbn::manipulator::manipulator_factory::make_condition(c.get_json()));
+  }
+  return m;
+}
+
+// The previous `device_grabber::update_complex_modifications_manipulators`.
+void rebuild(krbn::manipulator::manipulator_manager& manager,
+             const krbn::core_configuration::profile::complex_modifications& complex_modifications) {
+  manager.invalidate_manipulators();
+
+  for (const auto& rule : complex_modifications.get_rules()) {
+    for (const auto& manipulator : rule.get_manipulators()) {
+      manager.push_back_manipulator(make_manipulator(manipulator));
+    }
+  }
+}
+
+// The current `device_grabber::update_complex_modifications_manipulators`.
+void update(krbn::manipulator::manipulator_manager& manager,
+            krbn::manipulator::manipulator_cache& cache,
+            const krbn::core_configuration::profile::complex_modifications& complex_modifications) {
+  std::vector<std::shared_ptr<krbn::manipulator::details::base>> manipulators;
+
+  for (const auto& rule : complex_modifications.get_rules()) {
+    for (const auto& manipulator : rule.get_manipulators()) {
+      manipulators.push_back(cache.find_or_make(manipulator.get_json(), [&] {
+        return make_manipulator(manipulator);
+      }));
+    }
+  }
+
+  cache.commit();
+  manager.replace_manipulators(manipulators);
+}
+
+template <typename F>
+void measure(const std::string& name,
+             const std::vector<krbn::core_configuration::profile::complex_modifications>& reloads,
+             F f) {
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (const auto& complex_modifications : reloads) {
+    f(complex_modifications);
+  }
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - begin;
+  std::cout << "  " << name << elapsed.count() / reloads.size() << " ms/reload" << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  // Toggle rules one by one.
+  std::vector<krbn::core_configuration::profile::complex_modifications> reloads;
+  for (int i = 0; i < 20; ++i) {
+    reloads.push_back(make_complex_modifications(i % 2 == 0 ? -1 : i));
+  }
+
+  std::cout << "reload latency (" << rules_size * manipulators_size_per_rule << " manipulators)" << std::endl;
+
+  {
+    krbn::manipulator::manipulator_manager manager;
+    measure("full rebuild: ", reloads, [&](const auto& complex_modifications) {
+      rebuild(manager, complex_modifications);
+    });
+  }
+
+  {
+    krbn::manipulator::manipulator_manager manager;
+    krbn::manipulator::manipulator_cache cache;
+    update(manager, cache, reloads.front());
+
+    measure("incremental:  ", reloads, [&](const auto& complex_modifications) {
+      update(manager, cache, complex_modifications);
+    });
+
+    std::cout << "  reused manipulators: " << cache.get_stats().reused_count << std::endl;
+    std::cout << "  made manipulators:   " << cache.get_stats().made_count << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,158 @@
+#include "manipulator/details/post_event_to_virtual_devices.hpp"
+#include "manipulator/manipulator_manager.hpp"
+#include "manipulator/manipulator_managers_connector.hpp"
+#include "simulated_scheduler.hpp"
+#include "thread_utility.hpp"
+#include "time_utility.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace {
+class counting_client final {
+public:
+  counting_client(void) : report_count(0),
+                          x(0),
+                          y(0) {
+  }
+
+  void dispatch_keyboard_event(const pqrs::karabiner_virtual_hid_device::hid_event_service::keyboard_event& keyboard_event) {
+  }
+
+  void post_keyboard_input_report(const pqrs::karabiner_virtual_hid_device::hid_report::keyboard_input& report) {
+  }
+
+  void clear_keyboard_modifier_flags(void) {
+  }
+
+  void post_pointing_input_report(const pqrs::karabiner_virtual_hid_device::hid_report::pointing_input& report) {
+    ++report_count;
+    x += static_cast<int8_t>(report.x);
+    y += static_cast<int8_t>(report.y);
+  }
+
+  size_t report_count;
+  int64_t x;
+  int64_t y;
+};
+
+struct hid_value final {
+  uint64_t time_stamp;
+  krbn::hid_usage_page usage_page;
+  krbn::hid_usage usage;
+  int64_t integer_value;
+};
+
+// A 1000 Hz mouse which is moved for 10 seconds.
+// The values are delivered to the value callback in batches of 1-4 reports.
+std::vector<std::vector<hid_value>> make_replay(void) {
+  std::mt19937 engine(1234);
+  std::uniform_int_distribution<int64_t> delta_distribution(-8, 8);
+  std::uniform_int_distribution<int> batch_distribution(1, 4);
+
+  std::vector<std::vector<hid_value>> result;
+  bool button = false;
+
+  for (int i = 0; i < 10000;) {
+    result.emplace_back();
+    for (int n = batch_distribution(engine); n > 0 && i < 10000; --n, ++i) {
+      auto time_stamp = krbn::time_utility::nano_to_absolute(static_cast<uint64_t>(i + 1) * NSEC_PER_MSEC);
+
+      if (i % 250 == 0) {
+        button = !button;
+        result.back().push_back({time_stamp, krbn::hid_usage_page::button, krbn::hid_usage(1), button});
+      }
+      result.back().push_back({time_stamp, krbn::hid_usage_page::generic_desktop, krbn::hid_usage::gd_x, delta_distribution(engine)});
+      result.back().push_back({time_stamp, krbn::hid_usage_page::generic_desktop, krbn::hid_usage::gd_y, delta_distribution(engine)});
+      if (i % 50 == 0) {
+        result.back().push_back({time_stamp, krbn::hid_usage_page::generic_desktop, krbn::hid_usage::gd_wheel, 1});
+      }
+    }
+  }
+
+  return result;
+}
+
+void run(const std::string& name,
+         const std::vector<std::vector<hid_value>>& replay,
+         bool coalescing) {
+  // The same structure as device_grabber.
+  krbn::manipulator::manipulator_manager simple_modifications_manipulator_manager;
+  krbn::manipulator::manipulator_manager complex_modifications_manipulator_manager;
+  krbn::manipulator::manipulator_manager fn_function_keys_manipulator_manager;
+  krbn::manipulator::manipulator_manager post_event_to_virtual_devices_manipulator_manager;
+
+  auto scheduler = std::make_shared<krbn::simulated_scheduler>();
+  auto post_event_to_virtual_devices_manipulator = std::make_shared<krbn::manipulator::details::post_event_to_virtual_devices>(scheduler);
+  post_event_to_virtual_devices_manipulator->set_pointing_motion_coalescing(coalescing);
+  post_event_to_virtual_devices_manipulator_manager.push_back_manipulator(std::shared_ptr<krbn::manipulator::details::base>(post_event_to_virtual_devices_manipulator));
+
+  auto merged_input_event_queue = std::make_shared<krbn::event_queue>();
+  auto simple_modifications_applied_event_queue = std::make_shared<krbn::event_queue>();
+  auto complex_modifications_applied_event_queue = std::make_shared<krbn::event_queue>();
+  auto fn_function_keys_applied_event_queue = std::make_shared<krbn::event_queue>();
+  auto posted_event_queue = std::make_shared<krbn::event_queue>();
+
+  krbn::manipulator::manipulator_managers_connector connector;
+  connector.emplace_back_connection(simple_modifications_manipulator_manager,
+                                    merged_input_event_queue,
+                                    simple_modifications_applied_event_queue);
+  connector.emplace_back_connection(complex_modifications_manipulator_manager,
+                                    complex_modifications_applied_event_queue);
+  connector.emplace_back_connection(fn_function_keys_manipulator_manager,
+                                    fn_function_keys_applied_event_queue);
+  connector.emplace_back_connection(post_event_to_virtual_devices_manipulator_manager,
+                                    posted_event_queue);
+
+  krbn::event_queue device_event_queue;
+  if (coalescing) {
+    device_event_queue.set_pointing_motion_coalescing_window(krbn::time_utility::nano_to_absolute(8 * NSEC_PER_MSEC));
+  }
+
+  counting_client client;
+  size_t value_count = 0;
+  size_t event_count = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (const auto& batch : replay) {
+    for (const auto& v : batch) {
+      device_event_queue.emplace_back_event(krbn::device_id(1), v.time_stamp, v.usage_page, v.usage, v.integer_value);
+    }
+    value_count += batch.size();
+
+    // device_grabber::value_callback and device_grabber::manipulate
+    for (const auto& e : device_event_queue.get_events()) {
+      merged_input_event_queue->push_back_event(e);
+    }
+    event_count += device_event_queue.get_events().size();
+    device_event_queue.clear_events();
+
+    connector.manipulate();
+    posted_event_queue->clear_events();
+
+    scheduler->advance_to(batch.back().time_stamp);
+    post_event_to_virtual_devices_manipulator->post_events(client);
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - begin;
+
+  std::cout << name << std::endl;
+  std::cout << "  hid values:      " << value_count << std::endl;
+  std::cout << "  pipeline events: " << event_count << std::endl;
+  std::cout << "  reports:         " << client.report_count << std::endl;
+  std::cout << "  total motion:    (" << client.x << ", " << client.y << ")" << std::endl;
+  std::cout << "  throughput:      " << static_cast<uint64_t>(value_count / elapsed.count()) << " hid values/sec" << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  auto replay = make_replay();
+
+  run("without coalescing", replay, false);
+  run("with coalescing", replay, true);
+
+  return 0;
+}
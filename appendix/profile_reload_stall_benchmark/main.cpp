@@ -0,0 +1,208 @@
+#include "manipulator/details/post_event_to_virtual_devices.hpp"
+#include "manipulator/manipulator_managers_connector.hpp"
+#include "manipulator/profile_manipulators_builder.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+const int rules_size = 100;
+const int manipulators_size_per_rule = 10;
+const int events_size = 1000;
+const int reload_event_index = 200;
+
+// karabiner.json which has 1000 manipulators.
+// The rule at `disabled_rule_index` is omitted. (Toggling a rule in Preferences.)
+void write_core_configuration(const std::string& file_path, int disabled_rule_index) {
+  std::vector<std::string> key_codes({"b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m",
+                                      "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z"});
+
+  auto rules = nlohmann::json::array();
+
+  for (int i = 0; i < rules_size; ++i) {
+    if (i == disabled_rule_index) {
+      continue;
+    }
+
+    auto rule = nlohmann::json::object();
+    rule["description"] = "rule " + std::to_string(i);
+    rule["manipulators"] = nlohmann::json::array();
+
+    for (int j = 0; j < manipulators_size_per_rule; ++j) {
+      auto from = key_codes[(i + j) % key_codes.size()];
+      auto to = key_codes[(i * 7 + j) % key_codes.size()];
+
+      rule["manipulators"].push_back(nlohmann::json::parse(R"(
+        {
+          "type": "basic",
+          "from": {
+            "key_code": ")" + from + R"(",
+            "modifiers": {"mandatory": ["left_control"], "optional": ["any"]}
+          },
+          "to": [{"key_code": ")" + to + R"(", "modifiers": ["left_command"]}],
+          "conditions": [
+            {
+              "type": "frontmost_application_unless",
+              "bundle_identifiers": ["^com\\.vendor)" + std::to_string(i) + R"(\\.", "^com\\.apple\\.Terminal$"]
+            }
+          ]
+        }
+      )"));
+    }
+
+    rules.push_back(rule);
+  }
+
+  auto json = nlohmann::json::object();
+  json["profiles"] = nlohmann::json::array();
+  json["profiles"].push_back(nlohmann::json::object());
+  json["profiles"][0]["name"] = "Default profile";
+  json["profiles"][0]["selected"] = true;
+  json["profiles"][0]["complex_modifications"]["rules"] = rules;
+
+  std::ofstream output(file_path);
+  output << json.dump(4);
+}
+
+class pipeline final {
+public:
+  pipeline(void) : merged_input_event_queue_(std::make_shared<krbn::event_queue>()),
+                   simple_modifications_applied_event_queue_(std::make_shared<krbn::event_queue>()),
+                   complex_modifications_applied_event_queue_(std::make_shared<krbn::event_queue>()),
+                   posted_event_queue_(std::make_shared<krbn::event_queue>()),
+                   post_event_to_virtual_devices_manipulator_(std::make_shared<krbn::manipulator::details::post_event_to_virtual_devices>()) {
+    post_event_to_virtual_devices_manipulator_manager_.push_back_manipulator(std::shared_ptr<krbn::manipulator::details::base>(post_event_to_virtual_devices_manipulator_));
+
+    connector_.emplace_back_connection(simple_modifications_manipulator_manager_,
+                                       merged_input_event_queue_,
+                                       simple_modifications_applied_event_queue_);
+    connector_.emplace_back_connection(complex_modifications_manipulator_manager_,
+                                       complex_modifications_applied_event_queue_);
+    connector_.emplace_back_connection(post_event_to_virtual_devices_manipulator_manager_,
+                                       posted_event_queue_);
+  }
+
+  // The same as `device_grabber::set_profile`.
+  void set_profile(const krbn::manipulator::profile_manipulators_builder::snapshot& snapshot) {
+    simple_modifications_manipulator_manager_.replace_manipulators(snapshot.get_simple_modifications_manipulators());
+    complex_modifications_manipulator_manager_.replace_manipulators(snapshot.get_complex_modifications_manipulators());
+  }
+
+  void push_back_event(uint64_t time_stamp, krbn::event_type event_type) {
+    krbn::event_queue::queued_event::event event(krbn::key_code::a);
+    merged_input_event_queue_->emplace_back_event(krbn::device_id(1),
+                                                  time_stamp,
+                                                  event,
+                                                  event_type,
+                                                  event);
+    connector_.manipulate();
+
+    post_event_to_virtual_devices_manipulator_->clear_queue();
+    posted_event_queue_->clear_events();
+  }
+
+private:
+  std::shared_ptr<krbn::event_queue> merged_input_event_queue_;
+  std::shared_ptr<krbn::event_queue> simple_modifications_applied_event_queue_;
+  std::shared_ptr<krbn::event_queue> complex_modifications_applied_event_queue_;
+  std::shared_ptr<krbn::event_queue> posted_event_queue_;
+  krbn::manipulator::manipulator_manager simple_modifications_manipulator_manager_;
+  krbn::manipulator::manipulator_manager complex_modifications_manipulator_manager_;
+  krbn::manipulator::manipulator_manager post_event_to_virtual_devices_manipulator_manager_;
+  std::shared_ptr<krbn::manipulator::details::post_event_to_virtual_devices> post_event_to_virtual_devices_manipulator_;
+  krbn::manipulator::manipulator_managers_connector connector_;
+};
+
+// Input events arrive every 1 ms and karabiner.json is updated at `reload_event_index`.
+// Returns the maximum delay between the arrival and the completion of an input event.
+// `apply_time` is set to the time of `set_profile` in the input thread.
+double run(const std::string& file_path, bool background, double& apply_time) {
+  krbn::manipulator::profile_manipulators_builder builder;
+  pipeline pipeline;
+
+  write_core_configuration(file_path, -1);
+  pipeline.set_profile(*builder.build(std::make_shared<krbn::core_configuration>(file_path)));
+  write_core_configuration(file_path, 0);
+
+  std::mutex mutex;
+  std::shared_ptr<const krbn::manipulator::profile_manipulators_builder::snapshot> pending_snapshot;
+  std::thread worker;
+
+  std::chrono::duration<double, std::milli> max_stall(0);
+  auto begin = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < events_size; ++i) {
+    auto arrival = begin + std::chrono::milliseconds(i);
+    std::this_thread::sleep_until(arrival);
+
+    if (i == reload_event_index) {
+      if (background) {
+        // configuration_monitor (load_in_background) and device_grabber
+        worker = std::thread([&] {
+          auto snapshot = builder.build(std::make_shared<krbn::core_configuration>(file_path));
+
+          std::lock_guard<std::mutex> guard(mutex);
+          pending_snapshot = snapshot;
+        });
+      } else {
+        // The previous configuration_monitor and device_grabber
+        auto apply_begin = std::chrono::steady_clock::now();
+        pipeline.set_profile(*builder.build(std::make_shared<krbn::core_configuration>(file_path)));
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - apply_begin;
+        apply_time = elapsed.count();
+      }
+    }
+
+    // Apply the snapshot at an event boundary.
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      if (pending_snapshot) {
+        auto apply_begin = std::chrono::steady_clock::now();
+        pipeline.set_profile(*pending_snapshot);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - apply_begin;
+        apply_time = elapsed.count();
+
+        pending_snapshot = nullptr;
+      }
+    }
+
+    pipeline.push_back_event(1000 + i * 1000, i % 2 == 0 ? krbn::event_type::key_down : krbn::event_type::key_up);
+
+    auto stall = std::chrono::steady_clock::now() - arrival;
+    if (max_stall < stall) {
+      max_stall = stall;
+    }
+  }
+
+  if (worker.joinable()) {
+    worker.join();
+  }
+
+  return max_stall.count();
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  std::string file_path = "/tmp/profile_reload_stall_benchmark." + std::to_string(getpid()) + ".json";
+
+  std::cout << "reloading " << rules_size * manipulators_size_per_rule << " manipulators" << std::endl;
+
+  for (auto background : {false, true}) {
+    double apply_time = 0;
+    auto max_stall = run(file_path, background, apply_time);
+
+    std::cout << (background ? "  reload in the background thread" : "  reload in the main thread") << std::endl;
+    std::cout << "    max input stall:           " << max_stall << " ms" << std::endl;
+    std::cout << "    time in the input thread:  " << apply_time << " ms" << std::endl;
+  }
+
+  unlink(file_path.c_str());
+
+  return 0;
+}
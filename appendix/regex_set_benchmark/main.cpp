@@ -0,0 +1,185 @@
+#include "regex_set.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <json/json.hpp>
+#include <random>
+
+namespace {
+// Collect patterns of frontmost_application and input_source conditions.
+void collect_patterns(const nlohmann::json& json, std::vector<std::string>& patterns) {
+  if (json.is_array()) {
+    for (const auto& j : json) {
+      collect_patterns(j, patterns);
+    }
+
+  } else if (json.is_object()) {
+    for (auto it = std::begin(json); it != std::end(json); std::advance(it, 1)) {
+      const auto& key = it.key();
+      const auto& value = it.value();
+
+      if (key == "bundle_identifiers" || key == "file_paths") {
+        for (const auto& j : value) {
+          if (j.is_string()) {
+            patterns.push_back(j);
+          }
+        }
+      } else if (key == "input_sources") {
+        for (const auto& j : value) {
+          for (auto jt = std::begin(j); jt != std::end(j); std::advance(jt, 1)) {
+            if (jt.value().is_string()) {
+              patterns.push_back(jt.value());
+            }
+          }
+        }
+      } else {
+        collect_patterns(value, patterns);
+      }
+    }
+  }
+}
+
+void collect_directory_patterns(const std::string& directory, std::vector<std::string>& patterns) {
+  if (auto dir = opendir(directory.c_str())) {
+    while (auto entry = readdir(dir)) {
+      std::string name(entry->d_name);
+      if (name.size() > 5 && name.compare(name.size() - 5, 5, ".json") == 0) {
+        std::ifstream input(directory + "/" + name);
+        if (input) {
+          try {
+            collect_patterns(nlohmann::json::parse(input), patterns);
+          } catch (std::exception& e) {
+            // Some examples are not json (e.g., a link to KE-complex_modifications).
+          }
+        }
+      }
+    }
+    closedir(dir);
+  }
+}
+
+// Hundreds of per-application rules as seen in large user configurations.
+std::vector<std::string> make_application_patterns(size_t size) {
+  std::vector<std::string> result;
+  for (size_t i = 0; i < size; ++i) {
+    auto vendor = "com\\.vendor" + std::to_string(i % 37) + "\\.";
+    switch (i % 20) {
+      case 0:
+        result.push_back("^" + vendor);
+        break;
+      case 1:
+        result.push_back("/App" + std::to_string(i) + "\\.app/");
+        break;
+      case 2:
+        result.push_back("^" + vendor + "(app|tool)" + std::to_string(i) + "$");
+        break;
+      default:
+        result.push_back("^" + vendor + "app" + std::to_string(i) + "$");
+        break;
+    }
+  }
+  return result;
+}
+
+std::vector<std::string> make_strings(size_t size) {
+  std::mt19937 engine(1234);
+  std::uniform_int_distribution<int> distribution(0, 999);
+
+  std::vector<std::string> result;
+  for (size_t i = 0; i < size; ++i) {
+    auto n = distribution(engine);
+    result.push_back("com.vendor" + std::to_string(n % 41) + ".app" + std::to_string(n));
+  }
+  result.push_back("com.apple.Terminal");
+  result.push_back("/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal");
+  result.push_back("en");
+  return result;
+}
+
+template <typename F>
+double measure(int iterations, F f) {
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (int i = 0; i < iterations; ++i) {
+    f();
+  }
+
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - begin;
+  return elapsed.count() / iterations;
+}
+
+void run(const std::string& name,
+         const std::vector<std::string>& patterns,
+         const std::vector<std::string>& strings) {
+  std::cout << name << " (" << patterns.size() << " patterns)" << std::endl;
+
+  std::vector<std::regex> regexes;
+  krbn::regex_set regex_set;
+  size_t matched1 = 0;
+  size_t matched2 = 0;
+
+  std::cout << "  construction std::regex list: "
+            << measure(10, [&] {
+                 regexes.clear();
+                 for (const auto& p : patterns) {
+                   regexes.emplace_back(p);
+                 }
+               })
+            << " us" << std::endl;
+
+  std::cout << "  construction regex_set:       "
+            << measure(10, [&] {
+                 regex_set = krbn::regex_set(patterns);
+               })
+            << " us" << std::endl;
+
+  std::cout << "  search std::regex list:       "
+            << measure(10, [&] {
+                 for (const auto& s : strings) {
+                   for (const auto& r : regexes) {
+                     if (regex_search(std::begin(s), std::end(s), r)) {
+                       ++matched1;
+                       break;
+                     }
+                   }
+                 }
+               }) / strings.size()
+            << " us/string" << std::endl;
+
+  std::cout << "  search regex_set:             "
+            << measure(10, [&] {
+                 for (const auto& s : strings) {
+                   if (regex_set.search(s)) {
+                     ++matched2;
+                   }
+                 }
+               }) / strings.size()
+            << " us/string" << std::endl;
+
+  if (matched1 != matched2) {
+    std::cout << "  results differ: " << matched1 << " " << matched2 << std::endl;
+  }
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  std::vector<std::string> patterns;
+  collect_directory_patterns("../../examples", patterns);
+  collect_directory_patterns("../../tests/src/manipulator_conditions/json", patterns);
+
+  auto strings = make_strings(200);
+
+  run("examples and tests/src/manipulator_conditions/json", patterns, strings);
+
+  auto application_patterns = make_application_patterns(500);
+  application_patterns.insert(std::end(application_patterns),
+                              std::begin(patterns),
+                              std::end(patterns));
+  run("generated application rules", application_patterns, strings);
+
+  return 0;
+}
@@ -0,0 +1,231 @@
+#include "manipulator/details/types.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace {
+using krbn::manipulator::details::event_definition;
+using krbn::manipulator::details::from_event_definition;
+
+// The previous modifier_flag_manager: an event list with `erase_pairs` and a linear `is_pressed`.
+class legacy_modifier_flag_manager final {
+public:
+  using active_modifier_flag = krbn::modifier_flag_manager::active_modifier_flag;
+
+  void push_back_active_modifier_flag(const active_modifier_flag& flag) {
+    switch (flag.get_type()) {
+      case active_modifier_flag::type::increase:
+      case active_modifier_flag::type::decrease:
+      case active_modifier_flag::type::increase_lock:
+        active_modifier_flags_.push_back(flag);
+        erase_pairs();
+        break;
+
+      case active_modifier_flag::type::decrease_lock:
+        active_modifier_flags_.erase(std::remove_if(std::begin(active_modifier_flags_),
+                                                    std::end(active_modifier_flags_),
+                                                    [&](auto& f) {
+                                                      return f.is_paired(flag);
+                                                    }),
+                                     std::end(active_modifier_flags_));
+        break;
+    }
+  }
+
+  bool is_pressed(krbn::modifier_flag modifier_flag) const {
+    int count = 0;
+
+    for (const auto& f : active_modifier_flags_) {
+      if (f.get_modifier_flag() == modifier_flag) {
+        count += f.get_count();
+      }
+    }
+
+    return count > 0;
+  }
+
+private:
+  void erase_pairs(void) {
+    for (size_t i1 = 0; i1 < active_modifier_flags_.size(); ++i1) {
+      for (size_t i2 = i1 + 1; i2 < active_modifier_flags_.size(); ++i2) {
+        if (active_modifier_flags_[i1].is_paired(active_modifier_flags_[i2])) {
+          active_modifier_flags_.erase(std::begin(active_modifier_flags_) + i2);
+          active_modifier_flags_.erase(std::begin(active_modifier_flags_) + i1);
+          if (i1 > 0) {
+            --i1;
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  std::vector<active_modifier_flag> active_modifier_flags_;
+};
+
+// The previous `from_event_definition::test_modifiers` (unordered_set lookups on every call),
+// generalized over the modifier_flag_manager type.
+template <typename T>
+bool legacy_test_modifiers(const from_event_definition& from,
+                           const T& modifier_flag_manager) {
+  const auto& mandatory_modifiers = from.get_mandatory_modifiers();
+  const auto& optional_modifiers = from.get_optional_modifiers();
+
+  if (mandatory_modifiers.find(event_definition::modifier::any) != std::end(mandatory_modifiers)) {
+    return true;
+  }
+
+  for (int i = 0; i < static_cast<int>(event_definition::modifier::end_); ++i) {
+    auto m = event_definition::modifier(i);
+
+    if (mandatory_modifiers.find(m) != std::end(mandatory_modifiers)) {
+      if (m == event_definition::modifier::any) {
+        continue;
+      }
+
+      bool found = false;
+      for (const auto& f : event_definition::get_modifier_flags(m)) {
+        if (modifier_flag_manager.is_pressed(f)) {
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        return false;
+      }
+    }
+  }
+
+  if (optional_modifiers.find(event_definition::modifier::any) == std::end(optional_modifiers)) {
+    auto extra_modifier_flags = krbn::modifier_flag_set::all();
+
+    for (int i = 0; i < static_cast<int>(event_definition::modifier::end_); ++i) {
+      auto m = event_definition::modifier(i);
+
+      if (mandatory_modifiers.find(m) != std::end(mandatory_modifiers) ||
+          optional_modifiers.find(m) != std::end(optional_modifiers)) {
+        extra_modifier_flags.erase(event_definition::get_modifier_flags(m));
+      }
+    }
+
+    for (const auto& flag : extra_modifier_flags) {
+      if (modifier_flag_manager.is_pressed(flag)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+std::vector<from_event_definition> make_from_event_definitions(size_t size) {
+  std::mt19937 engine(1234);
+  std::uniform_int_distribution<int> modifier_distribution(1, static_cast<int>(event_definition::modifier::end_) - 1);
+  std::uniform_int_distribution<int> count_distribution(0, 3);
+
+  std::vector<from_event_definition> result;
+  for (size_t i = 0; i < size; ++i) {
+    std::unordered_set<event_definition::modifier> mandatory_modifiers;
+    std::unordered_set<event_definition::modifier> optional_modifiers;
+
+    for (int n = count_distribution(engine); n > 0; --n) {
+      mandatory_modifiers.insert(event_definition::modifier(modifier_distribution(engine)));
+    }
+    if (i % 2 == 0) {
+      optional_modifiers.insert(event_definition::modifier::any);
+    } else {
+      for (int n = count_distribution(engine); n > 0; --n) {
+        optional_modifiers.insert(event_definition::modifier(modifier_distribution(engine)));
+      }
+    }
+
+    result.emplace_back(krbn::key_code::a, mandatory_modifiers, optional_modifiers);
+  }
+  return result;
+}
+
+template <typename T>
+void press_modifiers(T& modifier_flag_manager) {
+  using active_modifier_flag = krbn::modifier_flag_manager::active_modifier_flag;
+
+  // Typical state while typing: some flags are pressed and some were released on another device.
+  for (const auto& device_id : {krbn::device_id(1), krbn::device_id(2)}) {
+    for (const auto& f : {krbn::modifier_flag::left_shift,
+                          krbn::modifier_flag::left_option,
+                          krbn::modifier_flag::right_control}) {
+      modifier_flag_manager.push_back_active_modifier_flag(active_modifier_flag(active_modifier_flag::type::increase, f, device_id));
+    }
+  }
+  modifier_flag_manager.push_back_active_modifier_flag(active_modifier_flag(active_modifier_flag::type::decrease,
+                                                                            krbn::modifier_flag::left_option,
+                                                                            krbn::device_id(2)));
+  modifier_flag_manager.push_back_active_modifier_flag(active_modifier_flag(active_modifier_flag::type::increase,
+                                                                            krbn::modifier_flag::left_command,
+                                                                            krbn::device_id(1)));
+  modifier_flag_manager.push_back_active_modifier_flag(active_modifier_flag(active_modifier_flag::type::increase_lock,
+                                                                            krbn::modifier_flag::caps_lock,
+                                                                            krbn::device_id(1)));
+}
+
+template <typename F>
+double measure(const std::vector<from_event_definition>& from_event_definitions,
+               int iterations,
+               F test) {
+  size_t matched = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (int i = 0; i < iterations; ++i) {
+    for (const auto& from : from_event_definitions) {
+      if (test(from)) {
+        ++matched;
+      }
+    }
+  }
+
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - begin;
+
+  // Prevent the loop from being optimized out.
+  if (matched == 0) {
+    std::cout << "  (no manipulators matched)" << std::endl;
+  }
+
+  return elapsed.count() / iterations;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  const int iterations = 10000;
+  auto from_event_definitions = make_from_event_definitions(500);
+
+  legacy_modifier_flag_manager before;
+  press_modifiers(before);
+
+  krbn::modifier_flag_manager after;
+  press_modifiers(after);
+
+  std::cout << "test_modifiers (" << from_event_definitions.size() << " manipulators)" << std::endl;
+
+  std::cout << "  unordered_set lookups, event list manager: "
+            << measure(from_event_definitions, iterations, [&](const auto& from) {
+                 return legacy_test_modifiers(from, before);
+               })
+            << " us/key" << std::endl;
+
+  std::cout << "  unordered_set lookups, counter manager:    "
+            << measure(from_event_definitions, iterations, [&](const auto& from) {
+                 return legacy_test_modifiers(from, after);
+               })
+            << " us/key" << std::endl;
+
+  std::cout << "  precompiled masks, counter manager:        "
+            << measure(from_event_definitions, iterations, [&](const auto& from) {
+                 return from.test_modifiers(after) != boost::none;
+               })
+            << " us/key" << std::endl;
+
+  return 0;
+}
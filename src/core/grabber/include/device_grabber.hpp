@@ -13,11 +13,15 @@
 #include "logger.hpp"
 #include "manipulator/details/post_event_to_virtual_devices.hpp"
 #include "manipulator/manipulator_managers_connector.hpp"
+#include "manipulator/profile_manipulators_builder.hpp"
 #include "spdlog_utility.hpp"
 #include "system_preferences.hpp"
+#include "thread_utility.hpp"
+#include "time_utility.hpp"
 #include "types.hpp"
 #include "virtual_hid_device_client.hpp"
 #include <IOKit/hid/IOHIDManager.h>
+#include <atomic>
 #include <boost/algorithm/string.hpp>
 #include <fstream>
 #include <json/json.hpp>
@@ -29,7 +33,8 @@ class device_grabber final {
 public:
   device_grabber(const device_grabber&) = delete;
 
-  device_grabber(void) : profile_(nlohmann::json()),
+  device_grabber(void) : profile_generation_(std::make_shared<std::atomic<uint64_t>>(0)),
+                         profile_(nlohmann::json()),
                          merged_input_event_queue_(std::make_shared<event_queue>()),
                          simple_modifications_applied_event_queue_(std::make_shared<event_queue>()),
                          complex_modifications_applied_event_queue_(std::make_shared<event_queue>()),
@@ -47,6 +52,8 @@ public:
     client_disconnected_connection = virtual_hid_device_client_.client_disconnected.connect([&]() {
       logger::get_logger().info("virtual_hid_device_client_ is disconnected");
 
+      post_event_to_virtual_devices_manipulator_->reset_keyboard_input();
+
       stop_grabbing();
     });
 
@@ -142,14 +149,60 @@ public:
                                                                          std::placeholders::_1,
                                                                          std::placeholders::_2));
 
-      configuration_monitor_ = std::make_unique<configuration_monitor>(user_core_configuration_file_path,
-                                                                       [this](std::shared_ptr<core_configuration> core_configuration) {
-                                                                         core_configuration_ = core_configuration;
+      // The first karabiner.json is loaded and applied synchronously in the configuration_monitor constructor.
+      // Updated karabiner.json is loaded and manipulators are built in the background queue of configuration_monitor
+      // in order to avoid stalling input events while loading a large configuration.
+      // The result is applied in the main queue.
+
+      auto profile_generation = profile_generation_;
+      auto generation = ++(*profile_generation);
+      profile_manipulators_builder_ = std::make_shared<manipulator::profile_manipulators_builder>();
 
-                                                                         is_grabbable_callback_log_reducer_.reset();
-                                                                         set_profile(core_configuration_->get_selected_profile());
-                                                                         grab_devices();
-                                                                       });
+      // The callback holds only a weak reference to the builder
+      // since configuration_monitor might keep the callback alive in the background queue after `stop_grabbing`.
+      std::weak_ptr<manipulator::profile_manipulators_builder> weak_profile_manipulators_builder = profile_manipulators_builder_;
+
+      configuration_monitor_ = std::make_unique<configuration_monitor>(user_core_configuration_file_path,
+                                                                       [this, profile_generation, generation, weak_profile_manipulators_builder](std::shared_ptr<core_configuration> core_configuration) {
+                                                                         auto profile_manipulators_builder = weak_profile_manipulators_builder.lock();
+                                                                         if (!profile_manipulators_builder) {
+                                                                           return;
+                                                                         }
+
+                                                                         // Builds which are running at `stop_grabbing` are canceled.
+                                                                         auto snapshot = profile_manipulators_builder->build(core_configuration,
+                                                                                                                             [profile_generation, generation] {
+                                                                                                                               return *profile_generation != generation;
+                                                                                                                             });
+
+                                                                         if (thread_utility::is_main_thread()) {
+                                                                           if (snapshot) {
+                                                                             apply_profile(*snapshot);
+                                                                           }
+                                                                           return;
+                                                                         }
+
+                                                                         // `stop_grabbing` might have released the builder and its caches while building.
+                                                                         gcd_utility::release_in_main_queue(std::move(profile_manipulators_builder));
+
+                                                                         if (!snapshot) {
+                                                                           return;
+                                                                         }
+
+                                                                         // The snapshot might hold the last reference to dropped manipulators.
+                                                                         // Thus, the block uses a raw pointer and the snapshot is released in the main queue after the block.
+                                                                         auto s = snapshot.get();
+                                                                         dispatch_async(dispatch_get_main_queue(), ^{
+                                                                           // Ignore snapshots which are built before `stop_grabbing`.
+                                                                           if (*profile_generation != generation) {
+                                                                             return;
+                                                                           }
+
+                                                                           apply_profile(*s);
+                                                                         });
+                                                                         gcd_utility::release_in_main_queue(std::move(snapshot));
+                                                                       },
+                                                                       true);
 
       virtual_hid_device_client_.connect();
     });
@@ -157,7 +210,10 @@ public:
 
   void stop_grabbing(void) {
     gcd_utility::dispatch_sync_in_main_queue(^{
+      // Cancel builds which are running in the background queue of configuration_monitor_.
+      ++(*profile_generation_);
       configuration_monitor_ = nullptr;
+      profile_manipulators_builder_ = nullptr;
 
       ungrab_devices();
 
@@ -180,6 +236,7 @@ public:
       }
 
       enable_devices();
+      update_pointing_motion_coalescing();
     });
   }
 
@@ -603,6 +660,9 @@ private:
 
   void update_virtual_hid_keyboard(void) {
     if (virtual_hid_device_client_.is_connected()) {
+      // The virtual keyboard does not keep pressed keys over initialization and termination.
+      post_event_to_virtual_devices_manipulator_->reset_keyboard_input();
+
       if (mode_ == mode::grabbing) {
         pqrs::karabiner_virtual_hid_device::properties::keyboard_initialization properties;
         if (auto k = types::make_keyboard_type(profile_.get_virtual_hid_keyboard().get_keyboard_type())) {
@@ -648,6 +708,30 @@ private:
     return false;
   }
 
+  bool get_coalesce_pointing_motion(const human_interface_device& device) const {
+    if (core_configuration_) {
+      return core_configuration_->get_selected_profile().get_device_coalesce_pointing_motion(device.get_connected_device().get_identifiers());
+    }
+    return false;
+  }
+
+  void update_pointing_motion_coalescing(void) {
+    // Merge motion events within a frame of 120 Hz display.
+    auto window = time_utility::nano_to_absolute(8 * NSEC_PER_MSEC);
+    bool coalescing = false;
+
+    for (const auto& it : hids_) {
+      if (get_coalesce_pointing_motion(*(it.second))) {
+        (it.second)->set_pointing_motion_coalescing_window(window);
+        coalescing = true;
+      } else {
+        (it.second)->set_pointing_motion_coalescing_window(boost::none);
+      }
+    }
+
+    post_event_to_virtual_devices_manipulator_->set_pointing_motion_coalescing(coalescing);
+  }
+
   bool need_to_disable_built_in_keyboard(void) const {
     for (const auto& it : hids_) {
       if (get_disable_built_in_keyboard_if_exists(*(it.second))) {
@@ -683,68 +767,26 @@ private:
     }
   }
 
-  void set_profile(const core_configuration::profile& profile) {
-    profile_ = profile;
+  // Apply a snapshot which is built in the background queue.
+  // This method is called between input events since it is called in the main queue.
+  void apply_profile(const manipulator::profile_manipulators_builder::snapshot& snapshot) {
+    is_grabbable_callback_log_reducer_.reset();
+    set_profile(snapshot);
+    grab_devices();
+  }
+
+  void set_profile(const manipulator::profile_manipulators_builder::snapshot& snapshot) {
+    core_configuration_ = snapshot.get_core_configuration();
+    profile_ = snapshot.get_profile();
 
-    update_simple_modifications_manipulators();
-    update_complex_modifications_manipulators();
+    simple_modifications_manipulator_manager_.replace_manipulators(snapshot.get_simple_modifications_manipulators());
+    complex_modifications_manipulator_manager_.replace_manipulators(snapshot.get_complex_modifications_manipulators());
     update_fn_function_keys_manipulators();
 
     update_virtual_hid_keyboard();
     update_virtual_hid_pointing();
   }
 
-  void update_simple_modifications_manipulators(void) {
-    simple_modifications_manipulator_manager_.invalidate_manipulators();
-
-    for (const auto& device : profile_.get_devices()) {
-      for (const auto& pair : device.get_simple_modifications().get_pairs()) {
-        if (auto m = make_simple_modifications_manipulator(pair)) {
-          auto c = make_device_if_condition(device);
-          m->push_back_condition(c);
-          simple_modifications_manipulator_manager_.push_back_manipulator(m);
-        }
-      }
-    }
-
-    for (const auto& pair : profile_.get_simple_modifications().get_pairs()) {
-      if (auto m = make_simple_modifications_manipulator(pair)) {
-        simple_modifications_manipulator_manager_.push_back_manipulator(m);
-      }
-    }
-  }
-
-  std::shared_ptr<manipulator::details::conditions::base> make_device_if_condition(const core_configuration::profile::device& device) const {
-    return std::make_shared<manipulator::details::conditions::device>(device.get_identifiers());
-  }
-
-  std::shared_ptr<manipulator::details::base> make_simple_modifications_manipulator(const std::pair<core_configuration::profile::simple_modifications::definition, core_configuration::profile::simple_modifications::definition>& pair) const {
-    if (pair.first.valid() && pair.second.valid()) {
-      auto from_json = pair.first.to_json();
-      from_json["modifiers"]["optional"] = "any";
-
-      auto to_json = pair.second.to_json();
-
-      return std::make_shared<manipulator::details::basic>(manipulator::details::from_event_definition(from_json),
-                                                           manipulator::details::to_event_definition(to_json));
-    }
-    return nullptr;
-  }
-
-  void update_complex_modifications_manipulators(void) {
-    complex_modifications_manipulator_manager_.invalidate_manipulators();
-
-    for (const auto& rule : profile_.get_complex_modifications().get_rules()) {
-      for (const auto& manipulator : rule.get_manipulators()) {
-        auto m = krbn::manipulator::manipulator_factory::make_manipulator(manipulator.get_json(), manipulator.get_parameters());
-        for (const auto& c : manipulator.get_conditions()) {
-          m->push_back_condition(krbn::manipulator::manipulator_factory::make_condition(c.get_json()));
-        }
-        complex_modifications_manipulator_manager_.push_back_manipulator(m);
-      }
-    }
-  }
-
   void update_fn_function_keys_manipulators(void) {
     fn_function_keys_manipulator_manager_.invalidate_manipulators();
 
@@ -806,7 +848,7 @@ private:
                                                        from_mandatory_modifiers,
                                                        from_optional_modifiers,
                                                        to_modifiers)) {
-          auto c = make_device_if_condition(device);
+          auto c = manipulator::profile_manipulators_builder::make_device_if_condition(device);
           m->push_back_condition(c);
           fn_function_keys_manipulator_manager_.push_back_manipulator(m);
         }
@@ -875,7 +917,11 @@ private:
   boost::signals2::connection client_disconnected_connection;
 
   std::unique_ptr<configuration_monitor> configuration_monitor_;
+  // It is released only in the main queue since its caches hold manipulators.
+  std::shared_ptr<manipulator::profile_manipulators_builder> profile_manipulators_builder_;
   std::shared_ptr<core_configuration> core_configuration_;
+  // It is shared with blocks which apply snapshots in order to detect `stop_grabbing` even if device_grabber is destroyed.
+  std::shared_ptr<std::atomic<uint64_t>> profile_generation_;
 
   std::unique_ptr<event_tap_manager> event_tap_manager_;
   IOHIDManagerRef _Nullable manager_;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "manipulator/details/conditions/base.hpp"
+#include <algorithm>
 
 namespace krbn {
 namespace manipulator {
@@ -12,21 +13,32 @@ public:
   }
 
   void push_back_condition(const std::shared_ptr<krbn::manipulator::details::conditions::base>& condition) {
-    conditions_.push_back(condition);
+    // Keep conditions sorted by cost.
+    // (Conditions which have the same cost are evaluated in the pushed order.)
+
+    auto it = std::upper_bound(std::begin(conditions_),
+                               std::end(conditions_),
+                               condition->get_cost(),
+                               [](int cost, const std::shared_ptr<krbn::manipulator::details::conditions::base>& c) {
+                                 return cost < c->get_cost();
+                               });
+    conditions_.insert(it, condition);
   }
 
   bool is_fulfilled(const event_queue::queued_event& queued_event,
                     const krbn::manipulator_environment& manipulator_environment) const {
-    bool result = true;
-
     for (const auto& c : conditions_) {
       if (!c->is_fulfilled(queued_event,
                            manipulator_environment)) {
-        result = false;
+        return false;
       }
     }
 
-    return result;
+    return true;
+  }
+
+  const std::vector<std::shared_ptr<krbn::manipulator::details::conditions::base>>& get_conditions(void) const {
+    return conditions_;
   }
 
 private:
@@ -4,6 +4,8 @@
 #include "manipulator/condition_manager.hpp"
 #include "manipulator/manipulator_timer.hpp"
 #include "modifier_flag_manager.hpp"
+#include <atomic>
+#include <boost/optional.hpp>
 
 namespace krbn {
 namespace manipulator {
@@ -41,7 +43,16 @@ public:
   virtual void force_post_pointing_button_event(const event_queue::queued_event& front_input_event,
                                                 event_queue& output_event_queue) = 0;
 
-  virtual void manipulator_timer_invoked(manipulator_timer::timer_id timer_id) = 0;
+  // manipulator_manager calls `manipulate` only for events equal to `get_from_event`
+  // (any event if it returns boost::none) while `needs_all_events` returns false.
+
+  virtual boost::optional<event_queue::queued_event::event> get_from_event(void) const {
+    return boost::none;
+  }
+
+  virtual bool needs_all_events(void) const {
+    return false;
+  }
 
   bool get_valid(void) const {
     return valid_;
@@ -55,7 +66,8 @@ public:
   }
 
 protected:
-  bool valid_;
+  // `get_valid` is also called from the background queue by manipulator_cache.
+  std::atomic<bool> valid_;
   condition_manager condition_manager_;
 };
 } // namespace details
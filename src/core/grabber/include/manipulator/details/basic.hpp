@@ -4,8 +4,8 @@
 #include "manipulator/details/base.hpp"
 #include "manipulator/details/types.hpp"
 #include "time_utility.hpp"
+#include <boost/functional/hash.hpp>
 #include <json/json.hpp>
-#include <unordered_set>
 #include <vector>
 
 namespace krbn {
@@ -17,7 +17,7 @@ public:
   public:
     manipulated_original_event(device_id device_id,
                                const event_queue::queued_event::event& original_event,
-                               const std::unordered_set<modifier_flag>& from_mandatory_modifiers,
+                               const modifier_flag_set& from_mandatory_modifiers,
                                uint64_t key_down_time_stamp) : device_id_(device_id),
                                                                original_event_(original_event),
                                                                from_mandatory_modifiers_(from_mandatory_modifiers),
@@ -33,7 +33,7 @@ public:
       return original_event_;
     }
 
-    const std::unordered_set<modifier_flag>& get_from_mandatory_modifiers(void) const {
+    const modifier_flag_set& get_from_mandatory_modifiers(void) const {
       return from_mandatory_modifiers_;
     }
 
@@ -58,11 +58,190 @@ public:
   private:
     device_id device_id_;
     event_queue::queued_event::event original_event_;
-    std::unordered_set<modifier_flag> from_mandatory_modifiers_;
+    modifier_flag_set from_mandatory_modifiers_;
     uint64_t key_down_time_stamp_;
     bool alone_;
   };
 
+  // Active key downs which are manipulated by `basic`, indexed by (device_id, original_event).
+  //
+  // This is a small open addressing hash table (linear probing with backward shift deletion)
+  // in order to find the corresponding key_down at key_up without a linear scan and without allocations in the steady state.
+  // Entries which have the same key are found in insertion order.
+  class manipulated_original_events final {
+  public:
+    manipulated_original_events(void) : size_(0) {
+    }
+
+    bool empty(void) const {
+      return size_ == 0;
+    }
+
+    size_t size(void) const {
+      return size_;
+    }
+
+    void emplace_back(device_id device_id,
+                      const event_queue::queued_event::event& original_event,
+                      const modifier_flag_set& from_mandatory_modifiers,
+                      uint64_t key_down_time_stamp) {
+      reserve(size_ + 1);
+
+      insert(manipulated_original_event(device_id,
+                                        original_event,
+                                        from_mandatory_modifiers,
+                                        key_down_time_stamp));
+    }
+
+    // Removes and returns the oldest entry which matches `device_id` and `original_event`.
+    boost::optional<manipulated_original_event> take(device_id device_id,
+                                                     const event_queue::queued_event::event& original_event) {
+      if (size_ == 0) {
+        return boost::none;
+      }
+
+      auto mask = slots_.size() - 1;
+      for (auto i = make_hash(device_id, original_event) & mask; slots_[i]; i = (i + 1) & mask) {
+        if (slots_[i]->get_device_id() == device_id &&
+            slots_[i]->get_original_event() == original_event) {
+          auto result = slots_[i];
+          erase_at(i);
+          return result;
+        }
+      }
+
+      return boost::none;
+    }
+
+    template <typename F>
+    void for_each(F f) {
+      if (size_ == 0) {
+        return;
+      }
+
+      for (auto& s : slots_) {
+        if (s) {
+          f(*s);
+        }
+      }
+    }
+
+    template <typename F>
+    void erase_if(F f) {
+      for (size_t i = 0; i < slots_.size(); ++i) {
+        // `erase_at` might move another entry into `i`.
+        while (slots_[i] && f(*slots_[i])) {
+          erase_at(i);
+        }
+      }
+    }
+
+  private:
+    static size_t make_hash(device_id device_id,
+                            const event_queue::queued_event::event& original_event) {
+      size_t seed = static_cast<size_t>(device_id);
+      boost::hash_combine(seed, original_event);
+      return seed;
+    }
+
+    // Keep the load factor <= 0.5.
+    void reserve(size_t size) {
+      if (size * 2 <= slots_.size()) {
+        return;
+      }
+
+      auto capacity = std::max(slots_.size() * 2, static_cast<size_t>(8));
+      while (capacity < size * 2) {
+        capacity *= 2;
+      }
+
+      std::vector<boost::optional<manipulated_original_event>> slots(capacity);
+      std::swap(slots_, slots);
+      size_ = 0;
+
+      if (slots.empty()) {
+        return;
+      }
+
+      // Start from an empty slot in order to visit each cluster from its head.
+      // (It keeps the insertion order of entries which have the same key.)
+      size_t start = 0;
+      while (slots[start]) {
+        ++start;
+      }
+
+      for (size_t n = 1; n <= slots.size(); ++n) {
+        auto& s = slots[(start + n) % slots.size()];
+        if (s) {
+          insert(std::move(*s));
+        }
+      }
+    }
+
+    void insert(manipulated_original_event&& e) {
+      auto mask = slots_.size() - 1;
+      auto i = make_hash(e.get_device_id(), e.get_original_event()) & mask;
+      while (slots_[i]) {
+        i = (i + 1) & mask;
+      }
+
+      slots_[i] = std::move(e);
+      ++size_;
+    }
+
+    void erase_at(size_t i) {
+      auto mask = slots_.size() - 1;
+
+      slots_[i] = boost::none;
+      --size_;
+
+      // Move the following entries back into the hole if their home slot allows it.
+      for (auto j = (i + 1) & mask; slots_[j]; j = (j + 1) & mask) {
+        auto home = make_hash(slots_[j]->get_device_id(), slots_[j]->get_original_event()) & mask;
+        bool stay = (i <= j) ? (i < home && home <= j)
+                             : (i < home || home <= j);
+        if (!stay) {
+          slots_[i] = std::move(slots_[j]);
+          slots_[j] = boost::none;
+          i = j;
+        }
+      }
+    }
+
+    std::vector<boost::optional<manipulated_original_event>> slots_;
+    size_t size_;
+  };
+
+  // A ready-made event which is posted by `to`, `to_if_alone`, `to_after_key_up` and `to_delayed_action`.
+  // `basic` expands to_event_definitions (including their modifiers) into to_event_templates at construction
+  // in order to avoid building events while manipulating.
+  class to_event_template final {
+  public:
+    to_event_template(const event_queue::queued_event::event& event,
+                      event_type event_type,
+                      bool lazy) : event_(event),
+                                   event_type_(event_type),
+                                   lazy_(lazy) {
+    }
+
+    const event_queue::queued_event::event& get_event(void) const {
+      return event_;
+    }
+
+    event_type get_event_type(void) const {
+      return event_type_;
+    }
+
+    bool get_lazy(void) const {
+      return lazy_;
+    }
+
+  private:
+    event_queue::queued_event::event event_;
+    event_type event_type_;
+    bool lazy_;
+  };
+
   class to_delayed_action final {
   public:
     to_delayed_action(basic& basic,
@@ -100,10 +279,17 @@ public:
       } else {
         logger::get_logger().error("complex_modifications json error: `to_delayed_action` should be object: {0}", json.dump());
       }
+
+      to_invoked_event_templates_ = make_extra_to_event_templates(to_invoked_);
+      to_canceled_event_templates_ = make_extra_to_event_templates(to_canceled_);
+    }
+
+    ~to_delayed_action(void) {
+      cancel_timer();
     }
 
     void setup(const event_queue::queued_event& front_input_event,
-               const std::unordered_set<modifier_flag>& from_mandatory_modifiers,
+               const modifier_flag_set& from_mandatory_modifiers,
                const std::shared_ptr<event_queue>& output_event_queue) {
       if (front_input_event.get_event_type() != event_type::key_down) {
         return;
@@ -118,7 +304,11 @@ public:
       from_mandatory_modifiers_ = from_mandatory_modifiers;
       output_event_queue_ = output_event_queue;
 
-      manipulator_timer_id_ = manipulator_timer::get_instance().add_entry(front_input_event.get_time_stamp() + time_utility::nano_to_absolute(300 * NSEC_PER_MSEC));
+      cancel_timer();
+      manipulator_timer_id_ = manipulator_timer::get_instance().add_entry(front_input_event.get_time_stamp() + time_utility::nano_to_absolute(300 * NSEC_PER_MSEC),
+                                                                          [this](auto timer_id) {
+                                                                            manipulator_timer_invoked(timer_id);
+                                                                          });
     }
 
     void cancel(const event_queue::queued_event& front_input_event) {
@@ -130,21 +320,32 @@ public:
         return;
       }
 
-      manipulator_timer_id_ = boost::none;
+      cancel_timer();
+
+      post_events(to_canceled_event_templates_);
+    }
 
-      post_events(to_canceled_);
+    bool pending(void) const {
+      return manipulator_timer_id_ != boost::none;
     }
 
+  private:
     void manipulator_timer_invoked(manipulator_timer::timer_id timer_id) {
       if (timer_id == manipulator_timer_id_) {
         manipulator_timer_id_ = boost::none;
-        post_events(to_invoked_);
+        post_events(to_invoked_event_templates_);
         krbn_notification_center::get_instance().input_event_arrived();
       }
     }
 
-  private:
-    void post_events(const std::vector<to_event_definition>& events) const {
+    void cancel_timer(void) {
+      if (manipulator_timer_id_) {
+        manipulator_timer::get_instance().cancel_entry(*manipulator_timer_id_);
+        manipulator_timer_id_ = boost::none;
+      }
+    }
+
+    void post_events(const std::vector<to_event_template>& event_templates) const {
       if (front_input_event_) {
         if (auto oeq = output_event_queue_.lock()) {
           uint64_t time_stamp_delay = 0;
@@ -159,10 +360,10 @@ public:
 
           // Post events
 
-          basic_.post_extra_to_events(*front_input_event_,
-                                      events,
-                                      time_stamp_delay,
-                                      *oeq);
+          basic_.post_to_event_templates(*front_input_event_,
+                                         event_templates,
+                                         time_stamp_delay,
+                                         *oeq);
 
           // Restore from_mandatory_modifiers
 
@@ -178,9 +379,11 @@ public:
     basic& basic_;
     std::vector<to_event_definition> to_invoked_;
     std::vector<to_event_definition> to_canceled_;
+    std::vector<to_event_template> to_invoked_event_templates_;
+    std::vector<to_event_template> to_canceled_event_templates_;
     boost::optional<manipulator_timer::timer_id> manipulator_timer_id_;
     boost::optional<event_queue::queued_event> front_input_event_;
-    std::unordered_set<modifier_flag> from_mandatory_modifiers_;
+    modifier_flag_set from_mandatory_modifiers_;
     std::weak_ptr<event_queue> output_event_queue_;
   };
 
@@ -236,11 +439,14 @@ public:
         logger::get_logger().error("complex_modifications json error: Unknown key: {0} in {1}", key, json.dump());
       }
     }
+
+    make_to_event_templates();
   }
 
   basic(const from_event_definition& from,
         const to_event_definition& to) : from_(from),
                                          to_({to}) {
+    make_to_event_templates();
   }
 
   virtual ~basic(void) {
@@ -283,7 +489,7 @@ public:
       }
 
       if (is_target) {
-        std::unordered_set<modifier_flag> from_mandatory_modifiers;
+        modifier_flag_set from_mandatory_modifiers;
         uint64_t key_down_time_stamp = 0;
         bool alone = false;
 
@@ -326,17 +532,11 @@ public:
 
             // Check original_event in order to determine the correspond key_down is manipulated.
 
-            auto it = std::find_if(std::begin(manipulated_original_events_),
-                                   std::end(manipulated_original_events_),
-                                   [&](const auto& manipulated_original_event) {
-                                     return manipulated_original_event.get_device_id() == front_input_event.get_device_id() &&
-                                            manipulated_original_event.get_original_event() == front_input_event.get_original_event();
-                                   });
-            if (it != std::end(manipulated_original_events_)) {
-              from_mandatory_modifiers = it->get_from_mandatory_modifiers();
-              key_down_time_stamp = it->get_key_down_time_stamp();
-              alone = it->get_alone();
-              manipulated_original_events_.erase(it);
+            if (auto e = manipulated_original_events_.take(front_input_event.get_device_id(),
+                                                           front_input_event.get_original_event())) {
+              from_mandatory_modifiers = e->get_from_mandatory_modifiers();
+              key_down_time_stamp = e->get_key_down_time_stamp();
+              alone = e->get_alone();
             } else {
               is_target = false;
             }
@@ -364,92 +564,45 @@ public:
 
           // Send events
 
-          for (auto it = std::begin(to_); it != std::end(to_); std::advance(it, 1)) {
-            if (auto event = it->to_event()) {
-              switch (front_input_event.get_event_type()) {
-                case event_type::key_down:
-                  // to_modifier down, to_key down, to_key up, to_modifier up
-
-                  {
-                    bool lazy = !preserve_to_modifiers_down();
-                    enqueue_to_modifiers(*it,
-                                         event_type::key_down,
-                                         front_input_event,
-                                         lazy,
-                                         time_stamp_delay,
-                                         *output_event_queue);
-                  }
-
-                  output_event_queue->emplace_back_event(front_input_event.get_device_id(),
-                                                         front_input_event.get_time_stamp() + time_stamp_delay++,
-                                                         *event,
-                                                         event_type::key_down,
-                                                         front_input_event.get_original_event());
-
-                  if (it != std::end(to_) - 1) {
-                    output_event_queue->emplace_back_event(front_input_event.get_device_id(),
-                                                           front_input_event.get_time_stamp() + time_stamp_delay++,
-                                                           *event,
-                                                           event_type::key_up,
-                                                           front_input_event.get_original_event());
-                  }
-
-                  if (it == std::end(to_) - 1 && preserve_to_modifiers_down()) {
-                    // Do nothing
-                  } else {
-                    bool lazy = !preserve_to_modifiers_down();
-                    enqueue_to_modifiers(*it,
-                                         event_type::key_up,
-                                         front_input_event,
-                                         lazy,
-                                         time_stamp_delay,
-                                         *output_event_queue);
-                  }
-                  break;
-
-                case event_type::key_up:
-                  if (it == std::end(to_) - 1) {
-                    output_event_queue->emplace_back_event(front_input_event.get_device_id(),
-                                                           front_input_event.get_time_stamp() + time_stamp_delay++,
-                                                           *event,
-                                                           event_type::key_up,
-                                                           front_input_event.get_original_event());
-
-                    if (preserve_to_modifiers_down()) {
-                      enqueue_to_modifiers(*it,
-                                           event_type::key_up,
-                                           front_input_event,
-                                           false,
-                                           time_stamp_delay,
-                                           *output_event_queue);
-                    }
-
-                    post_extra_to_events(front_input_event,
-                                         to_after_key_up_,
-                                         time_stamp_delay,
-                                         *output_event_queue);
-
-                    uint64_t nanoseconds = time_utility::absolute_to_nano(front_input_event.get_time_stamp() - key_down_time_stamp);
-                    if (alone &&
-                        nanoseconds < parameters_.get_basic_to_if_alone_timeout_milliseconds() * NSEC_PER_MSEC) {
-                      post_extra_to_events(front_input_event,
-                                           to_if_alone_,
-                                           time_stamp_delay,
-                                           *output_event_queue);
-                    }
-                  }
-                  break;
-
-                case event_type::single:
-                  break;
+          switch (front_input_event.get_event_type()) {
+            case event_type::key_down:
+              post_to_event_templates(front_input_event,
+                                      to_key_down_event_templates_,
+                                      time_stamp_delay,
+                                      *output_event_queue);
+              break;
+
+            case event_type::key_up:
+              if (to_key_up_event_templates_) {
+                post_to_event_templates(front_input_event,
+                                        *to_key_up_event_templates_,
+                                        time_stamp_delay,
+                                        *output_event_queue);
+
+                post_to_event_templates(front_input_event,
+                                        to_after_key_up_event_templates_,
+                                        time_stamp_delay,
+                                        *output_event_queue);
+
+                uint64_t nanoseconds = time_utility::absolute_to_nano(front_input_event.get_time_stamp() - key_down_time_stamp);
+                if (alone &&
+                    nanoseconds < parameters_.get_basic_to_if_alone_timeout_milliseconds() * NSEC_PER_MSEC) {
+                  post_to_event_templates(front_input_event,
+                                          to_if_alone_event_templates_,
+                                          time_stamp_delay,
+                                          *output_event_queue);
+                }
               }
-            }
+              break;
+
+            case event_type::single:
+              break;
           }
 
           // Restore from_mandatory_modifiers
 
-          if ((front_input_event.get_event_type() == event_type::key_down && !preserve_from_mandatory_modifiers_up()) ||
-              (front_input_event.get_event_type() == event_type::key_up && preserve_from_mandatory_modifiers_up())) {
+          if ((front_input_event.get_event_type() == event_type::key_down && !preserve_from_mandatory_modifiers_up_) ||
+              (front_input_event.get_event_type() == event_type::key_up && preserve_from_mandatory_modifiers_up_)) {
             post_lazy_modifier_key_events(front_input_event,
                                           from_mandatory_modifiers,
                                           event_type::key_down,
@@ -496,12 +649,9 @@ public:
   virtual void handle_device_ungrabbed_event(device_id device_id,
                                              const event_queue& output_event_queue,
                                              uint64_t time_stamp) {
-    manipulated_original_events_.erase(std::remove_if(std::begin(manipulated_original_events_),
-                                                      std::end(manipulated_original_events_),
-                                                      [&](const auto& e) {
-                                                        return e.get_device_id() == device_id;
-                                                      }),
-                                       std::end(manipulated_original_events_));
+    manipulated_original_events_.erase_if([&](const auto& e) {
+      return e.get_device_id() == device_id;
+    });
   }
 
   virtual void handle_event_from_ignored_device(const event_queue::queued_event& front_input_event,
@@ -524,10 +674,23 @@ public:
                                                 event_queue& output_event_queue) {
   }
 
-  virtual void manipulator_timer_invoked(manipulator_timer::timer_id timer_id) {
-    if (to_delayed_action_) {
-      to_delayed_action_->manipulator_timer_invoked(timer_id);
+  virtual boost::optional<event_queue::queued_event::event> get_from_event(void) const {
+    if (auto key_code = from_.get_key_code()) {
+      return event_queue::queued_event::event(*key_code);
     }
+    if (auto consumer_key_code = from_.get_consumer_key_code()) {
+      return event_queue::queued_event::event(*consumer_key_code);
+    }
+    if (auto pointing_button = from_.get_pointing_button()) {
+      return event_queue::queued_event::event(*pointing_button);
+    }
+    return boost::none;
+  }
+
+  virtual bool needs_all_events(void) const {
+    // `unset_alone_if_needed` and `to_delayed_action::cancel` have to observe other events.
+    return !manipulated_original_events_.empty() ||
+           (to_delayed_action_ && to_delayed_action_->pending());
   }
 
   const from_event_definition& get_from(void) const {
@@ -538,12 +701,11 @@ public:
     return to_;
   }
 
-  void enqueue_to_modifiers(const to_event_definition& to,
-                            event_type event_type,
-                            const event_queue::queued_event& front_input_event,
-                            bool lazy,
-                            uint64_t& time_stamp_delay,
-                            event_queue& output_event_queue) {
+private:
+  static void push_back_to_modifier_event_templates(std::vector<to_event_template>& event_templates,
+                                                    const to_event_definition& to,
+                                                    event_type event_type,
+                                                    bool lazy) {
     for (const auto& modifier : to.get_modifiers()) {
       // `event_definition::get_modifiers` might return two modifier_flags.
       // (eg. `modifier_flag::left_shift` and `modifier_flag::right_shift` for `modifier::shift`.)
@@ -553,89 +715,113 @@ public:
       if (!modifier_flags.empty()) {
         auto modifier_flag = modifier_flags.front();
         if (auto key_code = types::make_key_code(modifier_flag)) {
-          output_event_queue.emplace_back_event(front_input_event.get_device_id(),
-                                                front_input_event.get_time_stamp() + time_stamp_delay++,
-                                                event_queue::queued_event::event(*key_code),
-                                                event_type,
-                                                front_input_event.get_original_event(),
-                                                lazy);
+          event_templates.emplace_back(event_queue::queued_event::event(*key_code),
+                                       event_type,
+                                       lazy);
         }
       }
     }
   }
 
-private:
-  bool preserve_from_mandatory_modifiers_up(void) const {
-    if (to_.empty()) {
-      return false;
+  // Events of `to_if_alone`, `to_after_key_up` and `to_delayed_action`.
+  static std::vector<to_event_template> make_extra_to_event_templates(const std::vector<to_event_definition>& to_events) {
+    std::vector<to_event_template> event_templates;
+
+    for (const auto& to : to_events) {
+      if (auto event = to.to_event()) {
+        push_back_to_modifier_event_templates(event_templates, to, event_type::key_down, true);
+        event_templates.emplace_back(*event, event_type::key_down, false);
+        event_templates.emplace_back(*event, event_type::key_up, false);
+        push_back_to_modifier_event_templates(event_templates, to, event_type::key_up, true);
+      }
     }
 
-    if (auto event = to_.back().to_event()) {
-      if (auto key_code = event->get_key_code()) {
-        if (types::make_modifier_flag(*key_code) != boost::none) {
-          return true;
+    return event_templates;
+  }
+
+  void make_to_event_templates(void) {
+    preserve_from_mandatory_modifiers_up_ = false;
+
+    if (!to_.empty()) {
+      if (auto event = to_.back().to_event()) {
+        if (auto key_code = event->get_key_code()) {
+          if (types::make_modifier_flag(*key_code) != boost::none) {
+            preserve_from_mandatory_modifiers_up_ = true;
+          }
         }
       }
     }
 
-    return false;
-  }
+    bool preserve_to_modifiers_down = preserve_from_mandatory_modifiers_up_;
+
+    to_key_down_event_templates_.clear();
+    to_key_up_event_templates_ = boost::none;
+
+    for (auto it = std::begin(to_); it != std::end(to_); std::advance(it, 1)) {
+      if (auto event = it->to_event()) {
+        bool last = (it == std::end(to_) - 1);
+
+        // key_down: to_modifier down, to_key down, to_key up, to_modifier up
+
+        push_back_to_modifier_event_templates(to_key_down_event_templates_, *it, event_type::key_down, !preserve_to_modifiers_down);
+
+        to_key_down_event_templates_.emplace_back(*event, event_type::key_down, false);
 
-  bool preserve_to_modifiers_down(void) const {
-    return preserve_from_mandatory_modifiers_up();
+        if (!last) {
+          to_key_down_event_templates_.emplace_back(*event, event_type::key_up, false);
+        }
+
+        if (last && preserve_to_modifiers_down) {
+          // Do nothing
+        } else {
+          push_back_to_modifier_event_templates(to_key_down_event_templates_, *it, event_type::key_up, !preserve_to_modifiers_down);
+        }
+
+        // key_up: the last to_key up
+
+        if (last) {
+          to_key_up_event_templates_ = std::vector<to_event_template>();
+          to_key_up_event_templates_->emplace_back(*event, event_type::key_up, false);
+
+          if (preserve_to_modifiers_down) {
+            push_back_to_modifier_event_templates(*to_key_up_event_templates_, *it, event_type::key_up, false);
+          }
+        }
+      }
+    }
+
+    to_after_key_up_event_templates_ = make_extra_to_event_templates(to_after_key_up_);
+    to_if_alone_event_templates_ = make_extra_to_event_templates(to_if_alone_);
   }
 
   void post_lazy_modifier_key_events(const event_queue::queued_event& front_input_event,
-                                     const std::unordered_set<modifier_flag>& modifiers,
+                                     const modifier_flag_set& modifiers,
                                      event_type event_type,
                                      uint64_t& time_stamp_delay,
                                      event_queue& output_event_queue) {
     for (const auto& m : modifiers) {
       if (auto key_code = types::make_key_code(m)) {
-        event_queue::queued_event event(front_input_event.get_device_id(),
-                                        front_input_event.get_time_stamp() + time_stamp_delay++,
-                                        event_queue::queued_event::event(*key_code),
-                                        event_type,
-                                        front_input_event.get_original_event(),
-                                        true);
-        output_event_queue.push_back_event(event);
+        output_event_queue.emplace_back_event(front_input_event.get_device_id(),
+                                              front_input_event.get_time_stamp() + time_stamp_delay++,
+                                              event_queue::queued_event::event(*key_code),
+                                              event_type,
+                                              front_input_event.get_original_event(),
+                                              true);
       }
     }
   }
 
-  void post_extra_to_events(const event_queue::queued_event& front_input_event,
-                            const std::vector<to_event_definition>& to_events,
-                            uint64_t& time_stamp_delay,
-                            event_queue& output_event_queue) {
-    for (auto it = std::begin(to_events); it != std::end(to_events); std::advance(it, 1)) {
-      auto& to = *it;
-      if (auto event = to.to_event()) {
-        enqueue_to_modifiers(to,
-                             event_type::key_down,
-                             front_input_event,
-                             true,
-                             time_stamp_delay,
-                             output_event_queue);
-
-        output_event_queue.emplace_back_event(front_input_event.get_device_id(),
-                                              front_input_event.get_time_stamp() + time_stamp_delay++,
-                                              *event,
-                                              event_type::key_down,
-                                              front_input_event.get_original_event());
-
-        output_event_queue.emplace_back_event(front_input_event.get_device_id(),
-                                              front_input_event.get_time_stamp() + time_stamp_delay++,
-                                              *event,
-                                              event_type::key_up,
-                                              front_input_event.get_original_event());
-
-        enqueue_to_modifiers(to,
-                             event_type::key_up,
-                             front_input_event,
-                             true,
-                             time_stamp_delay,
-                             output_event_queue);
-      }
+  void post_to_event_templates(const event_queue::queued_event& front_input_event,
+                               const std::vector<to_event_template>& event_templates,
+                               uint64_t& time_stamp_delay,
+                               event_queue& output_event_queue) {
+    for (const auto& t : event_templates) {
+      output_event_queue.emplace_back_event(front_input_event.get_device_id(),
+                                            front_input_event.get_time_stamp() + time_stamp_delay++,
+                                            t.get_event(),
+                                            t.get_event_type(),
+                                            front_input_event.get_original_event(),
+                                            t.get_lazy());
     }
   }
 
@@ -660,9 +846,9 @@ private:
     return;
 
   run:
-    for (auto& e : manipulated_original_events_) {
+    manipulated_original_events_.for_each([](auto& e) {
       e.unset_alone();
-    }
+    });
   }
 
   core_configuration::profile::complex_modifications::parameters parameters_;
@@ -673,7 +859,14 @@ private:
   std::vector<to_event_definition> to_if_alone_;
   std::unique_ptr<to_delayed_action> to_delayed_action_;
 
-  std::vector<manipulated_original_event> manipulated_original_events_;
+  bool preserve_from_mandatory_modifiers_up_;
+  std::vector<to_event_template> to_key_down_event_templates_;
+  // boost::none if the last `to` is not an event. (Nothing is posted at key_up in that case.)
+  boost::optional<std::vector<to_event_template>> to_key_up_event_templates_;
+  std::vector<to_event_template> to_after_key_up_event_templates_;
+  std::vector<to_event_template> to_if_alone_event_templates_;
+
+  manipulated_original_events manipulated_original_events_;
 };
 } // namespace details
 } // namespace manipulator
@@ -2,6 +2,7 @@
 
 #include "event_queue.hpp"
 #include "manipulator_environment.hpp"
+#include <boost/optional.hpp>
 
 namespace krbn {
 namespace manipulator {
@@ -9,6 +10,39 @@ namespace details {
 namespace conditions {
 class base {
 protected:
+  // Memoized result of `is_fulfilled` for a pair of (manipulator_environment generation, device_id).
+  class cached_result final {
+  public:
+    cached_result(void) : generation_(0),
+                          device_id_(device_id::zero),
+                          result_(false) {
+    }
+
+    boost::optional<bool> find(const event_queue::queued_event& queued_event,
+                               const manipulator_environment& manipulator_environment) const {
+      // manipulator_environment generations start at 1.
+      if (generation_ == manipulator_environment.get_generation() &&
+          device_id_ == queued_event.get_device_id()) {
+        return result_;
+      }
+      return boost::none;
+    }
+
+    bool update(const event_queue::queued_event& queued_event,
+                const manipulator_environment& manipulator_environment,
+                bool result) {
+      generation_ = manipulator_environment.get_generation();
+      device_id_ = queued_event.get_device_id();
+      result_ = result;
+      return result;
+    }
+
+  private:
+    uint64_t generation_;
+    device_id device_id_;
+    bool result_;
+  };
+
   base(void) {
   }
 
@@ -18,6 +52,16 @@ public:
 
   virtual bool is_fulfilled(const event_queue::queued_event& queued_event,
                             const manipulator_environment& manipulator_environment) const = 0;
+
+  // Estimated cost of `is_fulfilled`.
+  // condition_manager evaluates cheaper conditions first and stops at the first unfulfilled condition.
+  //
+  //   0: nop
+  //   1: variable (a map lookup)
+  //   2: device (device_identifiers lookup)
+  //   3: frontmost_application (regex)
+  //   4: input_source (regex)
+  virtual int get_cost(void) const = 0;
 };
 } // namespace conditions
 } // namespace details
@@ -63,8 +63,30 @@ public:
 
   virtual bool is_fulfilled(const event_queue::queued_event& queued_event,
                             const manipulator_environment& manipulator_environment) const {
+    if (auto r = cached_result_.find(queued_event, manipulator_environment)) {
+      return *r;
+    }
+
+    return cached_result_.update(queued_event,
+                                 manipulator_environment,
+                                 test_device(queued_event.get_device_id()));
+  }
+
+  virtual int get_cost(void) const {
+    return 2;
+  }
+
+private:
+  struct definition final {
+    boost::optional<vendor_id> vendor_id;
+    boost::optional<product_id> product_id;
+    boost::optional<bool> is_keyboard;
+    boost::optional<bool> is_pointing_device;
+  };
+
+  bool test_device(device_id device_id) const {
     if (!definitions_.empty()) {
-      if (auto di = types::find_device_identifiers(queued_event.get_device_id())) {
+      if (auto di = types::find_device_identifiers(device_id)) {
         for (const auto& d : definitions_) {
           bool fulfilled = true;
 
@@ -103,14 +125,6 @@ public:
     }
   }
 
-private:
-  struct definition final {
-    boost::optional<vendor_id> vendor_id;
-    boost::optional<product_id> product_id;
-    boost::optional<bool> is_keyboard;
-    boost::optional<bool> is_pointing_device;
-  };
-
   void handle_identifiers_json(const nlohmann::json& json) {
     for (const auto& j : json) {
       if (j.is_object()) {
@@ -154,6 +168,8 @@ private:
 
   type type_;
   std::vector<definition> definitions_;
+
+  mutable cached_result cached_result_;
 };
 } // namespace conditions
 } // namespace details
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "manipulator/details/conditions/base.hpp"
-#include <regex>
+#include "regex_set.hpp"
 #include <string>
 #include <vector>
 
@@ -35,31 +35,23 @@ public:
           }
         } else if (key == "bundle_identifiers") {
           if (value.is_array()) {
+            std::vector<std::string> patterns;
             for (const auto& j : value) {
               if (j.is_string()) {
-                std::string s = j;
-                try {
-                  std::regex r(s);
-                  bundle_identifiers_.push_back(r);
-                } catch (std::exception& e) {
-                  logger::get_logger().error("complex_modifications json error: Regex error: \"{0}\" {1}", s, e.what());
-                }
+                patterns.push_back(j);
               }
             }
+            bundle_identifiers_ = regex_set(patterns);
           }
         } else if (key == "file_paths") {
           if (value.is_array()) {
+            std::vector<std::string> patterns;
             for (const auto& j : value) {
               if (j.is_string()) {
-                std::string s = j;
-                try {
-                  std::regex r(s);
-                  file_paths_.push_back(r);
-                } catch (std::exception& e) {
-                  logger::get_logger().error("complex_modifications json error: Regex error: \"{0}\" {1}", s, e.what());
-                }
+                patterns.push_back(j);
               }
             }
+            file_paths_ = regex_set(patterns);
           }
         } else {
           logger::get_logger().error("complex_modifications json error: Unknown key: {0} in {1}", key, json.dump());
@@ -73,46 +65,26 @@ public:
 
   virtual bool is_fulfilled(const event_queue::queued_event& queued_event,
                             const manipulator_environment& manipulator_environment) const {
-    if (cached_result_ && cached_result_->first == manipulator_environment.get_frontmost_application()) {
-      return cached_result_->second;
+    if (auto r = cached_result_.find(queued_event, manipulator_environment)) {
+      return *r;
     }
 
     auto& current_bundle_identifier = manipulator_environment.get_frontmost_application().get_bundle_identifier();
     auto& current_file_path = manipulator_environment.get_frontmost_application().get_file_path();
 
-    // Bundle identifiers
+    // Bundle identifiers and file paths
 
     bool result = false;
 
-    for (const auto& b : bundle_identifiers_) {
-      if (regex_search(std::begin(current_bundle_identifier),
-                       std::end(current_bundle_identifier),
-                       b)) {
-        switch (type_) {
-          case type::frontmost_application_if:
-            result = true;
-            goto finish;
-          case type::frontmost_application_unless:
-            result = false;
-            goto finish;
-        }
-      }
-    }
-
-    // File paths
-
-    for (const auto& f : file_paths_) {
-      if (regex_search(std::begin(current_file_path),
-                       std::end(current_file_path),
-                       f)) {
-        switch (type_) {
-          case type::frontmost_application_if:
-            result = true;
-            goto finish;
-          case type::frontmost_application_unless:
-            result = false;
-            goto finish;
-        }
+    if (bundle_identifiers_.search(current_bundle_identifier) ||
+        file_paths_.search(current_file_path)) {
+      switch (type_) {
+        case type::frontmost_application_if:
+          result = true;
+          goto finish;
+        case type::frontmost_application_unless:
+          result = false;
+          goto finish;
       }
     }
 
@@ -128,16 +100,19 @@ public:
     }
 
   finish:
-    cached_result_ = std::make_pair(manipulator_environment.get_frontmost_application(), result);
-    return result;
+    return cached_result_.update(queued_event, manipulator_environment, result);
+  }
+
+  virtual int get_cost(void) const {
+    return 3;
   }
 
 private:
   type type_;
-  std::vector<std::regex> bundle_identifiers_;
-  std::vector<std::regex> file_paths_;
+  regex_set bundle_identifiers_;
+  regex_set file_paths_;
 
-  mutable boost::optional<std::pair<manipulator_environment::frontmost_application, bool>> cached_result_;
+  mutable cached_result cached_result_;
 };
 } // namespace conditions
 } // namespace details
@@ -48,8 +48,8 @@ public:
 
   virtual bool is_fulfilled(const event_queue::queued_event& queued_event,
                             const manipulator_environment& manipulator_environment) const {
-    if (cached_result_ && cached_result_->first == manipulator_environment.get_input_source_identifiers()) {
-      return cached_result_->second;
+    if (auto r = cached_result_.find(queued_event, manipulator_environment)) {
+      return *r;
     }
 
     bool result = false;
@@ -79,15 +79,18 @@ public:
     }
 
   finish:
-    cached_result_ = std::make_pair(manipulator_environment.get_input_source_identifiers(), result);
-    return result;
+    return cached_result_.update(queued_event, manipulator_environment, result);
+  }
+
+  virtual int get_cost(void) const {
+    return 4;
   }
 
 private:
   type type_;
   std::vector<input_source_selector> input_source_selectors_;
 
-  mutable boost::optional<std::pair<input_source_identifiers, bool>> cached_result_;
+  mutable cached_result cached_result_;
 };
 } // namespace conditions
 } // namespace details
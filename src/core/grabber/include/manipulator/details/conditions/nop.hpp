@@ -18,6 +18,10 @@ public:
                             const manipulator_environment& manipulator_environment) const {
     return true;
   }
+
+  virtual int get_cost(void) const {
+    return 0;
+  }
 };
 } // namespace conditions
 } // namespace details
@@ -16,7 +16,8 @@ public:
   };
 
   variable(const nlohmann::json& json) : base(),
-                                         type_(type::variable_if) {
+                                         type_(type::variable_if),
+                                         value_(0) {
     if (json.is_object()) {
       for (auto it = std::begin(json); it != std::end(json); std::advance(it, 1)) {
         // it.key() is always std::string.
@@ -49,6 +50,8 @@ public:
         }
       }
     }
+
+    variable_id_ = manipulator_environment::make_variable_id(name_);
   }
 
   virtual ~variable(void) {
@@ -56,18 +59,35 @@ public:
 
   virtual bool is_fulfilled(const event_queue::queued_event& queued_event,
                             const manipulator_environment& manipulator_environment) const {
+    if (auto r = cached_result_.find(queued_event, manipulator_environment)) {
+      return *r;
+    }
+
+    bool result = false;
+
     switch (type_) {
       case type::variable_if:
-        return manipulator_environment.get_variable(name_) == value_;
+        result = (manipulator_environment.get_variable(variable_id_) == value_);
+        break;
       case type::variable_unless:
-        return manipulator_environment.get_variable(name_) != value_;
+        result = (manipulator_environment.get_variable(variable_id_) != value_);
+        break;
     }
+
+    return cached_result_.update(queued_event, manipulator_environment, result);
+  }
+
+  virtual int get_cost(void) const {
+    return 1;
   }
 
 private:
   type type_;
   std::string name_;
+  manipulator_environment::variable_id variable_id_;
   int value_;
+
+  mutable cached_result cached_result_;
 };
 } // namespace conditions
 } // namespace details
@@ -47,9 +47,6 @@ public:
   virtual void force_post_pointing_button_event(const event_queue::queued_event& front_input_event,
                                                 event_queue& output_event_queue) {
   }
-
-  virtual void manipulator_timer_invoked(manipulator_timer::timer_id timer_id) {
-  }
 };
 } // namespace details
 } // namespace manipulator
@@ -4,15 +4,18 @@
 
 #include "console_user_server_client.hpp"
 #include "keyboard_repeat_detector.hpp"
+#include "main_queue_scheduler.hpp"
 #include "manipulator/details/base.hpp"
 #include "manipulator/details/types.hpp"
+#include "ring_buffer.hpp"
 #include "stream_utility.hpp"
 #include "time_utility.hpp"
 #include "types.hpp"
 #include "virtual_hid_device_client.hpp"
+#include <algorithm>
+#include <bitset>
 #include <boost/optional.hpp>
 #include <boost/variant.hpp>
-#include <mach/mach_time.h>
 
 namespace krbn {
 namespace manipulator {
@@ -206,11 +209,19 @@ public:
       uint64_t time_stamp_;
     };
 
-    queue(void) : last_event_modifier_key_(false),
-                  last_event_time_stamp_(0) {
+    queue(void) : queue(main_queue_scheduler::get_instance()) {
     }
 
-    const std::vector<event>& get_events(void) const {
+    queue(const std::shared_ptr<scheduler>& scheduler) : scheduler_(scheduler),
+                                                         keyboard_input_changed_(false),
+                                                         keyboard_input_modifiers_changed_(false),
+                                                         pointing_motion_coalescing_(false),
+                                                         last_event_modifier_key_(false),
+                                                         last_event_time_stamp_(0) {
+      events_.reserve(256);
+    }
+
+    const ring_buffer<event>& get_events(void) const {
       return events_;
     }
 
@@ -230,8 +241,8 @@ public:
       // ----------------------------------------
       // modify time_stamp if needed
 
-      auto m = types::make_modifier_flag(hid_usage_page, hid_usage);
-      adjust_time_stamp(time_stamp, m != boost::none);
+      auto attributes = types::find_key_code_attributes(hid_usage_page, hid_usage);
+      adjust_time_stamp(time_stamp, attributes.is_modifier());
 
       // ----------------------------------------
 
@@ -245,6 +256,19 @@ public:
                             uint64_t time_stamp) {
       adjust_time_stamp(time_stamp, false);
 
+      // Merge motion into the last report if they are posted at the same time with the same buttons.
+      if (pointing_motion_coalescing_ && !events_.empty()) {
+        auto& back = events_.back();
+        if (back.get_time_stamp() == time_stamp) {
+          if (auto r = back.get_pointing_input()) {
+            if (auto merged = merge_pointing_input(*r, pointing_input)) {
+              back = event(*merged, time_stamp);
+              return;
+            }
+          }
+        }
+      }
+
       events_.emplace_back(pointing_input,
                            time_stamp);
     }
@@ -279,7 +303,18 @@ public:
       return events_.empty();
     }
 
-    void post_events(virtual_hid_device_client& virtual_hid_device_client) {
+    bool get_pointing_motion_coalescing(void) const {
+      return pointing_motion_coalescing_;
+    }
+
+    void set_pointing_motion_coalescing(bool value) {
+      pointing_motion_coalescing_ = value;
+    }
+
+    // Key transitions which are posted at once are coalesced into `hid_report::keyboard_input` reports.
+    // (See `add_to_keyboard_input`.)
+    template <typename T>
+    void post_events(T& virtual_hid_device_client) {
       if (timer_ && timer_->fired()) {
         timer_ = nullptr;
       }
@@ -287,7 +322,7 @@ public:
         return;
       }
 
-      uint64_t now = mach_absolute_time();
+      uint64_t now = scheduler_->now();
 
       while (!events_.empty()) {
         auto& e = events_.front();
@@ -295,19 +330,32 @@ public:
           // If e.get_time_stamp() is too large, we reduce the delay to 3 seconds.
           auto when = std::min(e.get_time_stamp(), now + time_utility::nano_to_absolute(3 * NSEC_PER_SEC));
 
-          timer_ = std::make_unique<gcd_utility::main_queue_after_timer>(when, ^{
+          post_keyboard_input(virtual_hid_device_client);
+
+          timer_ = scheduler_->make_timer(when, [this, &virtual_hid_device_client] {
             post_events(virtual_hid_device_client);
           });
           return;
         }
 
         if (auto keyboard_event = e.get_keyboard_event()) {
-          virtual_hid_device_client.dispatch_keyboard_event(*keyboard_event);
+          if (!add_to_keyboard_input(*keyboard_event, virtual_hid_device_client)) {
+            post_keyboard_input(virtual_hid_device_client);
+            virtual_hid_device_client.dispatch_keyboard_event(*keyboard_event);
+          }
+        } else {
+          post_keyboard_input(virtual_hid_device_client);
         }
+
         if (auto pointing_input = e.get_pointing_input()) {
           virtual_hid_device_client.post_pointing_input_report(*pointing_input);
         }
         if (e.get_type() == event::type::clear_keyboard_modifier_flags) {
+          if (keyboard_input_.modifiers != 0) {
+            keyboard_input_.modifiers = 0;
+            keyboard_input_changed_ = true;
+            post_keyboard_input(virtual_hid_device_client);
+          }
           virtual_hid_device_client.clear_keyboard_modifier_flags();
         }
         if (auto shell_command = e.get_shell_command()) {
@@ -333,16 +381,149 @@ public:
           }
         }
 
-        events_.erase(std::begin(events_));
+        events_.pop_front();
       }
+
+      post_keyboard_input(virtual_hid_device_client);
     }
 
     void clear(void) {
       events_.clear();
       keyboard_repeat_detector_.clear();
+      reset_keyboard_input();
+    }
+
+    // Forget the keys in `keyboard_input_`.
+    // Call this method when the virtual keyboard is initialized, terminated or reset
+    // in order to avoid posting stale keys in the next report.
+    void reset_keyboard_input(void) {
+      keyboard_input_ = pqrs::karabiner_virtual_hid_device::hid_report::keyboard_input();
+      keyboard_input_changed_keys_.reset();
+      keyboard_input_changed_ = false;
+      keyboard_input_modifiers_changed_ = false;
+    }
+
+    template <typename T>
+    void reset_virtual_hid_keyboard(T& virtual_hid_device_client) {
+      virtual_hid_device_client.reset_virtual_hid_keyboard();
+      reset_keyboard_input();
     }
 
   private:
+    // Keys in the keyboard_or_keypad usage page are posted by `post_keyboard_input_report`
+    // while `keyboard_input_.keys` has a free slot.
+    // Modifiers are set into `keyboard_input_.modifiers` and the other keys are set into `keyboard_input_.keys`.
+    // Keys which do not fit into `keyboard_input_.keys` and the other usage pages are posted by `dispatch_keyboard_event`.
+    // A key up is always posted in the same way as the key down.
+    //
+    // Returns false if the event should be posted by `dispatch_keyboard_event`.
+    template <typename T>
+    bool add_to_keyboard_input(const pqrs::karabiner_virtual_hid_device::hid_event_service::keyboard_event& keyboard_event,
+                               T& virtual_hid_device_client) {
+      if (keyboard_event.usage_page != pqrs::karabiner_virtual_hid_device::usage_page::keyboard_or_keypad) {
+        return false;
+      }
+
+      auto usage = static_cast<uint32_t>(keyboard_event.usage);
+      if (usage == 0 ||
+          usage >= keyboard_input_changed_keys_.size()) {
+        return false;
+      }
+
+      bool modifier = (static_cast<uint32_t>(key_code::left_control) <= usage &&
+                       usage <= static_cast<uint32_t>(key_code::right_command));
+
+      auto begin = std::begin(keyboard_input_.keys);
+      auto end = std::end(keyboard_input_.keys);
+      auto it = std::find(begin, end, usage);
+
+      if (!modifier) {
+        if (keyboard_event.value) {
+          if (it != end) {
+            return true;
+          }
+          it = std::find(begin, end, 0);
+          if (it == end) {
+            return false;
+          }
+        } else {
+          if (it == end) {
+            return false;
+          }
+        }
+      }
+
+      // Post the current report before changing the same key twice in order to keep each transition.
+      // Modifiers and the other keys are not changed in the same report in order to keep their order. (See `adjust_time_stamp`.)
+      if (keyboard_input_changed_keys_.test(usage) ||
+          (keyboard_input_changed_ && keyboard_input_modifiers_changed_ != modifier)) {
+        post_keyboard_input(virtual_hid_device_client);
+      }
+
+      if (modifier) {
+        uint8_t bit = 0x1 << (usage - static_cast<uint32_t>(key_code::left_control));
+        uint8_t modifiers = keyboard_event.value ? (keyboard_input_.modifiers | bit)
+                                                 : (keyboard_input_.modifiers & ~bit);
+        if (modifiers != keyboard_input_.modifiers) {
+          keyboard_input_.modifiers = modifiers;
+          set_keyboard_input_changed(usage, true);
+        }
+        return true;
+      }
+
+      if (keyboard_event.value) {
+        *it = static_cast<uint8_t>(usage);
+      } else {
+        std::copy(std::next(it), end, it);
+        *std::prev(end) = 0;
+      }
+
+      set_keyboard_input_changed(usage, false);
+      return true;
+    }
+
+    void set_keyboard_input_changed(uint32_t usage, bool modifier) {
+      keyboard_input_changed_keys_.set(usage);
+      keyboard_input_changed_ = true;
+      keyboard_input_modifiers_changed_ = modifier;
+    }
+
+    static boost::optional<pqrs::karabiner_virtual_hid_device::hid_report::pointing_input> merge_pointing_input(const pqrs::karabiner_virtual_hid_device::hid_report::pointing_input& report1,
+                                                                                                                const pqrs::karabiner_virtual_hid_device::hid_report::pointing_input& report2) {
+      if (!std::equal(std::begin(report1.buttons), std::end(report1.buttons), std::begin(report2.buttons))) {
+        return boost::none;
+      }
+
+      pqrs::karabiner_virtual_hid_device::hid_report::pointing_input result = report1;
+      if (!add_pointing_value(result.x, report2.x) ||
+          !add_pointing_value(result.y, report2.y) ||
+          !add_pointing_value(result.vertical_wheel, report2.vertical_wheel) ||
+          !add_pointing_value(result.horizontal_wheel, report2.horizontal_wheel)) {
+        return boost::none;
+      }
+      return result;
+    }
+
+    // The pointing_input fields are signed 8 bit values.
+    static bool add_pointing_value(uint8_t& value, uint8_t delta) {
+      auto v = static_cast<int>(static_cast<int8_t>(value)) + static_cast<int>(static_cast<int8_t>(delta));
+      if (v < -127 || 127 < v) {
+        return false;
+      }
+      value = static_cast<uint8_t>(v);
+      return true;
+    }
+
+    template <typename T>
+    void post_keyboard_input(T& virtual_hid_device_client) {
+      if (keyboard_input_changed_) {
+        virtual_hid_device_client.post_keyboard_input_report(keyboard_input_);
+        keyboard_input_changed_keys_.reset();
+        keyboard_input_changed_ = false;
+        keyboard_input_modifiers_changed_ = false;
+      }
+    }
+
     void adjust_time_stamp(uint64_t& time_stamp,
                            bool is_modifier_key) {
       // Wait is 5 milliseconds
@@ -364,8 +545,16 @@ public:
       }
     }
 
-    std::vector<event> events_;
-    std::unique_ptr<gcd_utility::main_queue_after_timer> timer_;
+    std::shared_ptr<scheduler> scheduler_;
+    ring_buffer<event> events_;
+    std::unique_ptr<scheduler::timer> timer_;
+
+    pqrs::karabiner_virtual_hid_device::hid_report::keyboard_input keyboard_input_;
+    std::bitset<256> keyboard_input_changed_keys_;
+    bool keyboard_input_changed_;
+    bool keyboard_input_modifiers_changed_;
+
+    bool pointing_motion_coalescing_;
 
     keyboard_repeat_detector keyboard_repeat_detector_;
 
@@ -455,15 +644,14 @@ public:
           modifier_flag::fn,
       };
       for (const auto& m : modifier_flags) {
-        bool pressed = pressed_modifier_flags_.find(m) != std::end(pressed_modifier_flags_);
+        bool pressed = pressed_modifier_flags_.contains(m);
 
         if (modifier_flag_manager.is_pressed(m)) {
           if (!pressed) {
             if (auto key_code = types::make_key_code(m)) {
-              if (auto hid_usage_page = types::make_hid_usage_page(*key_code)) {
-                if (auto hid_usage = types::make_hid_usage(*key_code)) {
-                  enqueue_key_event(*hid_usage_page, *hid_usage, event_type::key_down, queue, time_stamp);
-                }
+              auto attributes = types::get_key_code_attributes(*key_code);
+              if (attributes.has_hid_usage()) {
+                enqueue_key_event(attributes.get_hid_usage_page(), attributes.get_hid_usage(), event_type::key_down, queue, time_stamp);
               }
             }
             pressed_modifier_flags_.insert(m);
@@ -472,10 +660,9 @@ public:
         } else {
           if (pressed) {
             if (auto key_code = types::make_key_code(m)) {
-              if (auto hid_usage_page = types::make_hid_usage_page(*key_code)) {
-                if (auto hid_usage = types::make_hid_usage(*key_code)) {
-                  enqueue_key_event(*hid_usage_page, *hid_usage, event_type::key_up, queue, time_stamp);
-                }
+              auto attributes = types::get_key_code_attributes(*key_code);
+              if (attributes.has_hid_usage()) {
+                enqueue_key_event(attributes.get_hid_usage_page(), attributes.get_hid_usage(), event_type::key_up, queue, time_stamp);
               }
             }
             pressed_modifier_flags_.erase(m);
@@ -534,12 +721,15 @@ public:
     }
 
     std::vector<std::pair<device_id, std::pair<hid_usage_page, hid_usage>>> pressed_keys_;
-    std::unordered_set<modifier_flag> pressed_modifier_flags_;
+    modifier_flag_set pressed_modifier_flags_;
   };
 
-  post_event_to_virtual_devices(void) : base(),
-                                        queue_(),
-                                        pressed_buttons_(0) {
+  post_event_to_virtual_devices(void) : post_event_to_virtual_devices(main_queue_scheduler::get_instance()) {
+  }
+
+  post_event_to_virtual_devices(const std::shared_ptr<scheduler>& scheduler) : base(),
+                                                                              queue_(scheduler),
+                                                                              pressed_buttons_(0) {
   }
 
   virtual ~post_event_to_virtual_devices(void) {
@@ -604,29 +794,27 @@ public:
       switch (front_input_event.get_event().get_type()) {
         case event_queue::queued_event::event::type::key_code:
           if (auto key_code = front_input_event.get_event().get_key_code()) {
-            if (auto hid_usage_page = types::make_hid_usage_page(*key_code)) {
-              if (auto hid_usage = types::make_hid_usage(*key_code)) {
-                if (types::make_modifier_flag(*key_code) == boost::none) {
-                  switch (front_input_event.get_event_type()) {
-                    case event_type::key_down:
-                      key_event_dispatcher_.dispatch_key_down_event(front_input_event.get_device_id(),
-                                                                    *hid_usage_page,
-                                                                    *hid_usage,
-                                                                    queue_,
-                                                                    front_input_event.get_time_stamp());
-                      break;
-
-                    case event_type::key_up:
-                      key_event_dispatcher_.dispatch_key_up_event(*hid_usage_page,
-                                                                  *hid_usage,
-                                                                  queue_,
-                                                                  front_input_event.get_time_stamp());
-                      break;
+            auto attributes = types::get_key_code_attributes(*key_code);
+            if (attributes.has_hid_usage() &&
+                !attributes.is_modifier()) {
+              switch (front_input_event.get_event_type()) {
+                case event_type::key_down:
+                  key_event_dispatcher_.dispatch_key_down_event(front_input_event.get_device_id(),
+                                                                attributes.get_hid_usage_page(),
+                                                                attributes.get_hid_usage(),
+                                                                queue_,
+                                                                front_input_event.get_time_stamp());
+                  break;
 
-                    case event_type::single:
-                      break;
-                  }
-                }
+                case event_type::key_up:
+                  key_event_dispatcher_.dispatch_key_up_event(attributes.get_hid_usage_page(),
+                                                              attributes.get_hid_usage(),
+                                                              queue_,
+                                                              front_input_event.get_time_stamp());
+                  break;
+
+                case event_type::single:
+                  break;
               }
             }
           }
@@ -830,14 +1018,12 @@ public:
     pressed_buttons_ = output_event_queue.get_pointing_button_manager().get_hid_report_bits();
   }
 
-  virtual void manipulator_timer_invoked(manipulator_timer::timer_id timer_id) {
-  }
-
   virtual void set_valid(bool value) {
     // This manipulator is always valid.
   }
 
-  void post_events(virtual_hid_device_client& virtual_hid_device_client) {
+  template <typename T>
+  void post_events(T& virtual_hid_device_client) {
     queue_.post_events(virtual_hid_device_client);
   }
 
@@ -845,10 +1031,23 @@ public:
     return queue_;
   }
 
+  void set_pointing_motion_coalescing(bool value) {
+    queue_.set_pointing_motion_coalescing(value);
+  }
+
   void clear_queue(void) {
     return queue_.clear();
   }
 
+  void reset_keyboard_input(void) {
+    queue_.reset_keyboard_input();
+  }
+
+  template <typename T>
+  void reset_virtual_hid_keyboard(T& virtual_hid_device_client) {
+    queue_.reset_virtual_hid_keyboard(virtual_hid_device_client);
+  }
+
   const key_event_dispatcher& get_key_event_dispatcher(void) const {
     return key_event_dispatcher_;
   }
@@ -856,7 +1055,6 @@ public:
 private:
   queue queue_;
   key_event_dispatcher key_event_dispatcher_;
-  std::unordered_set<modifier_flag> pressed_modifier_flags_;
   uint32_t pressed_buttons_;
 };
 
@@ -4,6 +4,7 @@
 
 #include "event_queue.hpp"
 #include "modifier_flag_manager.hpp"
+#include "modifier_flag_set.hpp"
 #include "stream_utility.hpp"
 #include <boost/optional.hpp>
 #include <boost/variant.hpp>
@@ -171,7 +172,7 @@ public:
     return modifiers;
   }
 
-  static std::vector<modifier_flag> get_modifier_flags(modifier modifier) {
+  static modifier_flag_set get_modifier_flags(modifier modifier) {
     switch (modifier) {
       case modifier::any:
         return {};
@@ -455,6 +456,8 @@ public:
                 [&](const std::string& key, const nlohmann::json& value) {
                   return extra_json_handler(key, value);
                 });
+
+    update_modifier_masks();
   }
 
   from_event_definition(key_code key_code,
@@ -462,6 +465,7 @@ public:
                         const std::unordered_set<modifier>& optional_modifiers) : event_definition(key_code),
                                                                                   mandatory_modifiers_(mandatory_modifiers),
                                                                                   optional_modifiers_(optional_modifiers) {
+    update_modifier_masks();
   }
 
   virtual ~from_event_definition(void) {
@@ -475,64 +479,36 @@ public:
     return optional_modifiers_;
   }
 
-  boost::optional<std::unordered_set<modifier_flag>> test_modifiers(const modifier_flag_manager& modifier_flag_manager) const {
-    std::unordered_set<modifier_flag> modifier_flags;
+  boost::optional<modifier_flag_set> test_modifiers(const modifier_flag_manager& modifier_flag_manager) const {
+    auto pressed_bits = modifier_flag_manager.get_pressed_bits();
 
     // If mandatory_modifiers_ contains modifier::any, return all active modifier_flags.
 
-    if (mandatory_modifiers_.find(modifier::any) != std::end(mandatory_modifiers_)) {
-      for (auto i = static_cast<uint32_t>(modifier_flag::zero) + 1; i != static_cast<uint32_t>(modifier_flag::end_); ++i) {
-        auto flag = modifier_flag(i);
-        if (modifier_flag_manager.is_pressed(flag)) {
-          modifier_flags.insert(flag);
-        }
-      }
-      return modifier_flags;
+    if (mandatory_any_) {
+      return modifier_flag_set::from_bits(pressed_bits);
     }
 
     // Check modifier_flag state.
+    // Each mandatory modifier requires one of its modifier_flags (eg. left_shift or right_shift for shift).
+    // We use the first pressed modifier_flag as `test_modifier` does.
 
-    for (int i = 0; i < static_cast<int>(modifier::end_); ++i) {
-      auto m = modifier(i);
+    uint32_t modifier_flags_bits = 0;
 
-      if (mandatory_modifiers_.find(m) != std::end(mandatory_modifiers_)) {
-        auto pair = test_modifier(modifier_flag_manager, m);
-        if (!pair.first) {
-          return boost::none;
-        }
-        if (pair.second != modifier_flag::zero) {
-          modifier_flags.insert(pair.second);
-        }
+    for (const auto& mask : mandatory_modifier_masks_) {
+      auto bits = pressed_bits & mask;
+      if (bits == 0) {
+        return boost::none;
       }
+      modifier_flags_bits |= (bits & -bits);
     }
 
     // If optional_modifiers_ does not contain modifier::any, we have to check modifier flags strictly.
 
-    if (optional_modifiers_.find(modifier::any) == std::end(optional_modifiers_)) {
-      std::unordered_set<modifier_flag> extra_modifier_flags;
-      for (auto m = static_cast<uint32_t>(modifier_flag::zero) + 1; m != static_cast<uint32_t>(modifier_flag::end_); ++m) {
-        extra_modifier_flags.insert(modifier_flag(m));
-      }
-
-      for (int i = 0; i < static_cast<int>(modifier::end_); ++i) {
-        auto m = modifier(i);
-
-        if (mandatory_modifiers_.find(m) != std::end(mandatory_modifiers_) ||
-            optional_modifiers_.find(m) != std::end(optional_modifiers_)) {
-          for (const auto& flag : get_modifier_flags(m)) {
-            extra_modifier_flags.erase(flag);
-          }
-        }
-      }
-
-      for (const auto& flag : extra_modifier_flags) {
-        if (modifier_flag_manager.is_pressed(flag)) {
-          return boost::none;
-        }
-      }
+    if (pressed_bits & extra_modifier_flags_mask_) {
+      return boost::none;
     }
 
-    return modifier_flags;
+    return modifier_flag_set::from_bits(modifier_flags_bits);
   }
 
   static std::pair<bool, modifier_flag> test_modifier(const modifier_flag_manager& modifier_flag_manager,
@@ -541,12 +517,9 @@ public:
       return std::make_pair(true, modifier_flag::zero);
     }
 
-    auto modifier_flags = get_modifier_flags(modifier);
-    if (!modifier_flags.empty()) {
-      for (const auto& m : modifier_flags) {
-        if (modifier_flag_manager.is_pressed(m)) {
-          return std::make_pair(true, m);
-        }
+    for (const auto& m : get_modifier_flags(modifier)) {
+      if (modifier_flag_manager.is_pressed(m)) {
+        return std::make_pair(true, m);
       }
     }
 
@@ -581,8 +554,41 @@ private:
     return false;
   }
 
+  void update_modifier_masks(void) {
+    mandatory_any_ = (mandatory_modifiers_.find(modifier::any) != std::end(mandatory_modifiers_));
+
+    mandatory_modifier_masks_.clear();
+    extra_modifier_flags_mask_ = 0;
+
+    auto extra_modifier_flags = modifier_flag_set::all();
+
+    for (int i = 0; i < static_cast<int>(modifier::end_); ++i) {
+      auto m = modifier(i);
+
+      if (mandatory_modifiers_.find(m) != std::end(mandatory_modifiers_)) {
+        if (m != modifier::any) {
+          mandatory_modifier_masks_.push_back(get_modifier_flags(m).get_bits());
+        }
+        extra_modifier_flags.erase(get_modifier_flags(m));
+      }
+
+      if (optional_modifiers_.find(m) != std::end(optional_modifiers_)) {
+        extra_modifier_flags.erase(get_modifier_flags(m));
+      }
+    }
+
+    if (optional_modifiers_.find(modifier::any) == std::end(optional_modifiers_)) {
+      extra_modifier_flags_mask_ = extra_modifier_flags.get_bits();
+    }
+  }
+
   std::unordered_set<modifier> mandatory_modifiers_;
   std::unordered_set<modifier> optional_modifiers_;
+
+  // Masks compiled from mandatory_modifiers_ and optional_modifiers_ (bits of `modifier_flag_set`).
+  bool mandatory_any_;
+  std::vector<uint32_t> mandatory_modifier_masks_;
+  uint32_t extra_modifier_flags_mask_;
 };
 
 class to_event_definition final : public event_definition {
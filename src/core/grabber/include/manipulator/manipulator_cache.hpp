@@ -0,0 +1,163 @@
+#pragma once
+
+#include "manipulator/details/base.hpp"
+#include <boost/functional/hash.hpp>
+#include <functional>
+#include <json/json.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace krbn {
+namespace manipulator {
+// Keeps manipulators by the json which they are made from
+// in order to reuse unchanged manipulators (and their state) when the configuration is reloaded.
+//
+// Usage:
+//   1. Call `find_or_make` for each manipulator in the new configuration.
+//   2. Call `commit`.
+//      Manipulators which are not used since the last `commit` are dropped from the cache.
+//      (Call `rollback` instead of `commit` in order to abandon the new configuration.)
+//   3. Call `take_dropped_manipulators` and release them in the main queue.
+//      (Manipulators must be destroyed in the main queue since they cancel timers in their destructors.)
+class manipulator_cache final {
+public:
+  struct stats final {
+    stats(void) : reused_count(0),
+                  made_count(0) {
+    }
+
+    // The number of manipulators which are reused.
+    uint64_t reused_count;
+    // The number of manipulators which are made by `make`.
+    uint64_t made_count;
+  };
+
+  manipulator_cache(const manipulator_cache&) = delete;
+
+  manipulator_cache(void) {
+  }
+
+  // Returns a manipulator which was made from the same `json` before the last `commit`.
+  // If there is no such manipulator, returns a manipulator made by `make`. (`make` might return nullptr.)
+  std::shared_ptr<details::base> find_or_make(const nlohmann::json& json,
+                                              const std::function<std::shared_ptr<details::base>(void)>& make) {
+    auto hash = make_hash(json);
+
+    auto range = entries_.equal_range(hash);
+    for (auto it = range.first; it != range.second; std::advance(it, 1)) {
+      // Invalidated manipulators must not be reused.
+      if (it->second.second->get_valid() &&
+          it->second.first == json) {
+        auto m = it->second.second;
+        next_entries_.emplace(hash, std::move(it->second));
+        entries_.erase(it);
+
+        ++stats_.reused_count;
+        return m;
+      }
+    }
+
+    auto m = make();
+    if (m) {
+      next_entries_.emplace(hash, std::make_pair(json, m));
+
+      ++stats_.made_count;
+    }
+    return m;
+  }
+
+  void commit(void) {
+    drop_entries(entries_);
+    entries_ = std::move(next_entries_);
+    next_entries_.clear();
+  }
+
+  // Keeps all manipulators in the cache as if `find_or_make` was not called since the last `commit`.
+  void rollback(void) {
+    entries_.insert(std::make_move_iterator(std::begin(next_entries_)),
+                    std::make_move_iterator(std::end(next_entries_)));
+    next_entries_.clear();
+  }
+
+  void clear(void) {
+    drop_entries(entries_);
+    drop_entries(next_entries_);
+  }
+
+  // Returns manipulators which are dropped by `commit` or `clear`.
+  // The cache does not hold them anymore.
+  std::vector<std::shared_ptr<details::base>> take_dropped_manipulators(void) {
+    std::vector<std::shared_ptr<details::base>> manipulators;
+    manipulators.swap(dropped_manipulators_);
+    return manipulators;
+  }
+
+  size_t size(void) const {
+    return entries_.size();
+  }
+
+  const stats& get_stats(void) const {
+    return stats_;
+  }
+
+  // A stable hash of `json` which does not depend on the order of object keys.
+  // (`std::hash<nlohmann::json>` is slow since it uses `dump`.)
+  static size_t make_hash(const nlohmann::json& json) {
+    size_t seed = static_cast<size_t>(json.type());
+
+    switch (json.type()) {
+      case nlohmann::json::value_t::object:
+        // Use `object_t` directly since `iter_impl::key` copies the key.
+        for (const auto& pair : json.get_ref<const nlohmann::json::object_t&>()) {
+          boost::hash_combine(seed, pair.first);
+          boost::hash_combine(seed, make_hash(pair.second));
+        }
+        break;
+
+      case nlohmann::json::value_t::array:
+        for (const auto& j : json.get_ref<const nlohmann::json::array_t&>()) {
+          boost::hash_combine(seed, make_hash(j));
+        }
+        break;
+
+      case nlohmann::json::value_t::string:
+        boost::hash_combine(seed, json.get_ref<const std::string&>());
+        break;
+
+      case nlohmann::json::value_t::boolean:
+        boost::hash_combine(seed, json.get<bool>());
+        break;
+
+      case nlohmann::json::value_t::number_integer:
+      case nlohmann::json::value_t::number_unsigned:
+      case nlohmann::json::value_t::number_float:
+        // Use double in order to get the same hash for `1` and `1.0` which are equal in nlohmann::json.
+        boost::hash_combine(seed, json.get<double>());
+        break;
+
+      case nlohmann::json::value_t::null:
+      case nlohmann::json::value_t::discarded:
+        break;
+    }
+
+    return seed;
+  }
+
+private:
+  // hash -> (json, manipulator)
+  typedef std::unordered_multimap<size_t, std::pair<nlohmann::json, std::shared_ptr<details::base>>> entries;
+
+  void drop_entries(entries& entries) {
+    for (auto&& pair : entries) {
+      dropped_manipulators_.push_back(std::move(pair.second.second));
+    }
+    entries.clear();
+  }
+
+  entries entries_;
+  entries next_entries_;
+  std::vector<std::shared_ptr<details::base>> dropped_manipulators_;
+  stats stats_;
+};
+} // namespace manipulator
+} // namespace krbn
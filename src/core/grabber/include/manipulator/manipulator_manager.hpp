@@ -1,6 +1,10 @@
 #pragma once
 
 #include "manipulator/manipulator_factory.hpp"
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace krbn {
 namespace manipulator {
@@ -9,24 +13,16 @@ public:
   manipulator_manager(const manipulator_manager&) = delete;
 
   manipulator_manager(void) {
-    manipulator_timer_connection_ = manipulator_timer::get_instance().timer_invoked.connect([&](auto timer_id) {
-      for (auto&& m : manipulators_) {
-        m->manipulator_timer_invoked(timer_id);
-      }
-    });
-  }
-
-  ~manipulator_manager(void) {
-    manipulator_timer_connection_.disconnect();
   }
 
   void push_back_manipulator(const nlohmann::json& json,
                              const core_configuration::profile::complex_modifications::parameters& parameters) {
-    manipulators_.push_back(manipulator_factory::make_manipulator(json, parameters));
+    push_back_manipulator(manipulator_factory::make_manipulator(json, parameters));
   }
 
   void push_back_manipulator(std::shared_ptr<details::base> ptr) {
     manipulators_.push_back(ptr);
+    add_to_dispatch_table(manipulators_.size() - 1);
   }
 
   void manipulate(const std::shared_ptr<event_queue>& input_event_queue,
@@ -98,10 +94,17 @@ public:
           case event_queue::queued_event::event::type::pointing_horizontal_wheel:
           case event_queue::queued_event::event::type::shell_command:
           case event_queue::queued_event::event::type::select_input_source:
-            for (auto&& m : manipulators_) {
+            update_dispatch_targets(front_input_event.get_event());
+
+            for (const auto& i : dispatch_targets_) {
+              auto& m = manipulators_[i];
               m->manipulate(front_input_event,
                             *input_event_queue,
                             output_event_queue);
+
+              if (m->needs_all_events()) {
+                add_to_all_events_manipulators(i);
+              }
             }
             break;
         }
@@ -125,6 +128,37 @@ public:
     remove_invalid_manipulators();
   }
 
+  // Replace manipulators with `manipulators`.
+  // The current manipulators which are not in `manipulators` are invalidated.
+  // (They are kept until they become inactive as well as `invalidate_manipulators`.)
+  void replace_manipulators(const std::vector<std::shared_ptr<details::base>>& manipulators) {
+    std::unordered_set<details::base*> set;
+    for (const auto& m : manipulators) {
+      set.insert(m.get());
+    }
+
+    std::vector<std::shared_ptr<details::base>> new_manipulators;
+    for (auto&& m : manipulators_) {
+      if (set.find(m.get()) == std::end(set)) {
+        m->set_valid(false);
+        if (m->active()) {
+          new_manipulators.push_back(m);
+        }
+      }
+    }
+    new_manipulators.insert(std::end(new_manipulators),
+                            std::begin(manipulators),
+                            std::end(manipulators));
+
+    manipulators_ = std::move(new_manipulators);
+
+    rebuild_dispatch_table();
+  }
+
+  const std::vector<std::shared_ptr<details::base>>& get_manipulators(void) const {
+    return manipulators_;
+  }
+
   size_t get_manipulators_size(void) {
     return manipulators_.size();
   }
@@ -140,6 +174,8 @@ public:
 
 private:
   void remove_invalid_manipulators(void) {
+    auto size = manipulators_.size();
+
     manipulators_.erase(std::remove_if(std::begin(manipulators_),
                                        std::end(manipulators_),
                                        [](const auto& it) {
@@ -147,10 +183,134 @@ private:
                                          return !it->get_valid() && !it->active();
                                        }),
                         std::end(manipulators_));
+
+    if (manipulators_.size() != size) {
+      rebuild_dispatch_table();
+    }
+  }
+
+  // dispatch table
+
+  static boost::optional<uint64_t> make_dispatch_key(const event_queue::queued_event::event& event) {
+    if (auto key_code = event.get_key_code()) {
+      return (static_cast<uint64_t>(event.get_type()) << 32) | static_cast<uint32_t>(*key_code);
+    }
+    if (auto consumer_key_code = event.get_consumer_key_code()) {
+      return (static_cast<uint64_t>(event.get_type()) << 32) | static_cast<uint32_t>(*consumer_key_code);
+    }
+    if (auto pointing_button = event.get_pointing_button()) {
+      return (static_cast<uint64_t>(event.get_type()) << 32) | static_cast<uint32_t>(*pointing_button);
+    }
+    return boost::none;
+  }
+
+  void add_to_dispatch_table(size_t index) {
+    const auto& m = manipulators_[index];
+
+    boost::optional<uint64_t> key;
+    if (auto e = m->get_from_event()) {
+      key = make_dispatch_key(*e);
+    }
+
+    if (key) {
+      dispatch_table_[*key].push_back(index);
+    } else {
+      any_event_manipulators_.push_back(index);
+    }
+
+    if (m->needs_all_events()) {
+      add_to_all_events_manipulators(index);
+    }
+  }
+
+  void rebuild_dispatch_table(void) {
+    dispatch_table_.clear();
+    any_event_manipulators_.clear();
+    all_events_manipulators_.clear();
+
+    for (size_t i = 0; i < manipulators_.size(); ++i) {
+      add_to_dispatch_table(i);
+    }
+  }
+
+  void add_to_all_events_manipulators(size_t index) {
+    auto it = std::lower_bound(std::begin(all_events_manipulators_),
+                               std::end(all_events_manipulators_),
+                               index);
+    if (it == std::end(all_events_manipulators_) || *it != index) {
+      all_events_manipulators_.insert(it, index);
+    }
+  }
+
+  // Collect indices of manipulators which have to handle `event` into `dispatch_targets_`.
+  // The indices are sorted in order to keep the manipulators order.
+  //
+  // The dispatch table buckets and `any_event_manipulators_` are sorted since indices are added in ascending order,
+  // and `all_events_manipulators_` is kept sorted.
+  // Thus, they are merged in linear time. (`all_events_manipulators_` might overlap with the others.)
+  void update_dispatch_targets(const event_queue::queued_event::event& event) {
+    // Remove manipulators which do not need all events anymore.
+    all_events_manipulators_.erase(std::remove_if(std::begin(all_events_manipulators_),
+                                                  std::end(all_events_manipulators_),
+                                                  [&](auto i) {
+                                                    return !manipulators_[i]->needs_all_events();
+                                                  }),
+                                   std::end(all_events_manipulators_));
+
+    auto any_it = std::begin(any_event_manipulators_);
+    auto any_end = std::end(any_event_manipulators_);
+    auto all_it = std::begin(all_events_manipulators_);
+    auto all_end = std::end(all_events_manipulators_);
+    auto key_it = any_end;
+    auto key_end = any_end;
+
+    if (auto key = make_dispatch_key(event)) {
+      auto it = dispatch_table_.find(*key);
+      if (it != std::end(dispatch_table_)) {
+        key_it = std::begin(it->second);
+        key_end = std::end(it->second);
+      }
+    }
+
+    dispatch_targets_.clear();
+
+    while (any_it != any_end ||
+           all_it != all_end ||
+           key_it != key_end) {
+      auto index = std::numeric_limits<size_t>::max();
+      if (any_it != any_end) {
+        index = std::min(index, *any_it);
+      }
+      if (all_it != all_end) {
+        index = std::min(index, *all_it);
+      }
+      if (key_it != key_end) {
+        index = std::min(index, *key_it);
+      }
+
+      dispatch_targets_.push_back(index);
+
+      if (any_it != any_end && *any_it == index) {
+        ++any_it;
+      }
+      if (all_it != all_end && *all_it == index) {
+        ++all_it;
+      }
+      if (key_it != key_end && *key_it == index) {
+        ++key_it;
+      }
+    }
   }
 
   std::vector<std::shared_ptr<details::base>> manipulators_;
-  boost::signals2::connection manipulator_timer_connection_;
+
+  // Manipulators indexed by `make_dispatch_key(get_from_event())`.
+  std::unordered_map<uint64_t, std::vector<size_t>> dispatch_table_;
+  // Manipulators which `get_from_event` returns boost::none.
+  std::vector<size_t> any_event_manipulators_;
+  // Manipulators which `needs_all_events` returned true. (sorted)
+  std::vector<size_t> all_events_manipulators_;
+  std::vector<size_t> dispatch_targets_;
 };
 } // namespace manipulator
 } // namespace krbn
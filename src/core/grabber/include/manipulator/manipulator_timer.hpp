@@ -2,10 +2,12 @@
 
 #include "boost_defs.hpp"
 
-#include "gcd_utility.hpp"
-#include <boost/signals2.hpp>
-#include <deque>
-#include <mach/mach_time.h>
+#include "main_queue_scheduler.hpp"
+#include <algorithm>
+#include <boost/optional.hpp>
+#include <functional>
+#include <unordered_map>
+#include <vector>
 
 namespace krbn {
 namespace manipulator {
@@ -34,7 +36,7 @@ public:
       return when_;
     }
 
-    bool compare(const entry& other) {
+    bool compare(const entry& other) const {
       if (when_ != other.when_) {
         return when_ < other.when_;
       } else {
@@ -47,92 +49,251 @@ public:
     uint64_t when_;
   };
 
+  struct stats final {
+    stats(void) : wakeup_count(0),
+                  invoked_count(0),
+                  canceled_count(0),
+                  avoided_wakeup_count(0) {
+    }
+
+    // The number of `signal` calls.
+    uint64_t wakeup_count;
+    // The number of invoked entries.
+    uint64_t invoked_count;
+    // The number of `cancel_entry` calls which canceled a pending entry.
+    uint64_t canceled_count;
+    // The number of `cancel_entry` calls which postponed or removed the next wakeup.
+    uint64_t avoided_wakeup_count;
+  };
+
+  // Entries are kept in a binary heap ordered by `entry::compare`.
+  // Each entry has its own callback, so only the owner of the entry is invoked.
+  // Canceled entries are removed from `callbacks_` and skipped (and eventually dropped) from the heap lazily.
+  //
+  // The dispatch timer is rearmed only when the earliest pending entry is changed,
+  // so canceled entries never wake the main queue.
   class core final {
   public:
-    boost::signals2::signal<void(timer_id)> timer_invoked;
+    core(void) : core(main_queue_scheduler::get_instance()) {
+    }
 
-    core(void) : enabled_(false) {
+    core(const std::shared_ptr<krbn::scheduler>& scheduler) : scheduler_(scheduler),
+                                                              enabled_(false) {
     }
 
-    // For unit testing
-    const std::deque<entry>& get_entries(void) const {
-      return entries_;
+    void set_scheduler(const std::shared_ptr<krbn::scheduler>& scheduler) {
+      std::lock_guard<std::mutex> guard(mutex_);
+
+      timer_ = nullptr;
+      timer_when_ = boost::none;
+      scheduler_ = scheduler;
+
+      set_timer();
+    }
+
+    stats get_stats(void) const {
+      std::lock_guard<std::mutex> guard(mutex_);
+
+      return stats_;
+    }
+
+    // For unit testing (pending entries in invocation order)
+    std::vector<entry> get_entries(void) const {
+      std::lock_guard<std::mutex> guard(mutex_);
+
+      std::vector<entry> result;
+      for (const auto& e : entries_) {
+        if (callbacks_.find(e.get_timer_id()) != std::end(callbacks_)) {
+          result.push_back(e);
+        }
+      }
+      std::sort(std::begin(result),
+                std::end(result),
+                [](auto& a, auto& b) {
+                  return a.compare(b);
+                });
+      return result;
     }
 
     void enable(void) {
       std::lock_guard<std::mutex> guard(mutex_);
 
       enabled_ = true;
+
+      set_timer();
     }
 
     void disable(void) {
       std::lock_guard<std::mutex> guard(mutex_);
 
       enabled_ = false;
+
+      set_timer();
     }
 
-    timer_id add_entry(uint64_t when) {
+    timer_id add_entry(uint64_t when,
+                       const std::function<void(timer_id)>& callback) {
       std::lock_guard<std::mutex> guard(mutex_);
 
       entries_.emplace_back(when);
       auto result = entries_.back().get_timer_id();
+      std::push_heap(std::begin(entries_),
+                     std::end(entries_),
+                     heap_compare);
 
-      std::sort(std::begin(entries_),
-                std::end(entries_),
-                [](auto& a, auto& b) {
-                  return a.compare(b);
-                });
+      callbacks_[result] = callback;
 
       set_timer();
 
       return result;
     }
 
+    void cancel_entry(timer_id timer_id) {
+      std::lock_guard<std::mutex> guard(mutex_);
+
+      auto next_when = get_next_when();
+
+      if (callbacks_.erase(timer_id) == 0) {
+        return;
+      }
+
+      ++stats_.canceled_count;
+
+      if (next_when) {
+        auto when = get_next_when();
+        if (!when || *when > *next_when) {
+          ++stats_.avoided_wakeup_count;
+        }
+      }
+
+      // Drop canceled entries from the heap when they are the majority.
+      if (entries_.size() > 2 * callbacks_.size() + 8) {
+        entries_.erase(std::remove_if(std::begin(entries_),
+                                      std::end(entries_),
+                                      [&](auto& e) {
+                                        return callbacks_.find(e.get_timer_id()) == std::end(callbacks_);
+                                      }),
+                       std::end(entries_));
+        std::make_heap(std::begin(entries_),
+                       std::end(entries_),
+                       heap_compare);
+      }
+
+      set_timer();
+    }
+
     void signal(uint64_t now) {
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        ++stats_.wakeup_count;
+      }
+
       for (;;) {
         boost::optional<timer_id> id;
+        std::function<void(timer_id)> callback;
 
         {
           std::lock_guard<std::mutex> guard(mutex_);
 
+          pop_canceled_entries();
+
           if (!entries_.empty() && entries_.front().get_when() <= now) {
             id = entries_.front().get_timer_id();
-            entries_.pop_front();
+            std::pop_heap(std::begin(entries_),
+                          std::end(entries_),
+                          heap_compare);
+            entries_.pop_back();
+
+            auto it = callbacks_.find(*id);
+            callback = std::move(it->second);
+            callbacks_.erase(it);
+
+            ++stats_.invoked_count;
           }
         }
 
         if (id) {
-          timer_invoked(*id);
+          if (callback) {
+            callback(*id);
+          }
         } else {
           break;
         }
       }
 
-      set_timer();
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        set_timer();
+      }
     }
 
   private:
+    // std::push_heap makes a max heap; keep the earliest entry at the front.
+    static bool heap_compare(const entry& a, const entry& b) {
+      return b.compare(a);
+    }
+
+    void pop_canceled_entries(void) {
+      while (!entries_.empty() &&
+             callbacks_.find(entries_.front().get_timer_id()) == std::end(callbacks_)) {
+        std::pop_heap(std::begin(entries_),
+                      std::end(entries_),
+                      heap_compare);
+        entries_.pop_back();
+      }
+    }
+
+    boost::optional<uint64_t> get_next_when(void) {
+      pop_canceled_entries();
+
+      if (entries_.empty()) {
+        return boost::none;
+      }
+      return entries_.front().get_when();
+    }
+
     void set_timer(void) {
+      auto when = get_next_when();
       if (!enabled_) {
-        timer_ = nullptr;
+        when = boost::none;
+      }
+
+      if (when == timer_when_) {
         return;
       }
 
-      if (entries_.empty()) {
+      timer_when_ = when;
+
+      if (!when) {
         timer_ = nullptr;
         return;
       }
 
-      timer_ = std::make_unique<gcd_utility::main_queue_after_timer>(entries_.front().get_when(), ^{
-        uint64_t now = mach_absolute_time();
+      timer_ = scheduler_->make_timer(*when, [this] {
+        uint64_t now = 0;
+
+        {
+          std::lock_guard<std::mutex> guard(mutex_);
+
+          // The timer has been fired.
+          timer_when_ = boost::none;
+          now = scheduler_->now();
+        }
+
         signal(now);
       });
     }
 
-    std::mutex mutex_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<krbn::scheduler> scheduler_;
     bool enabled_;
-    std::deque<entry> entries_;
-    std::unique_ptr<gcd_utility::main_queue_after_timer> timer_;
+    std::vector<entry> entries_;
+    std::unordered_map<timer_id, std::function<void(timer_id)>> callbacks_;
+    std::unique_ptr<krbn::scheduler::timer> timer_;
+    boost::optional<uint64_t> timer_when_;
+    stats stats_;
   };
 
   static core& get_instance(void) {
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "core_configuration.hpp"
+#include "manipulator/manipulator_cache.hpp"
+#include "manipulator/manipulator_factory.hpp"
+#include <functional>
+
+namespace krbn {
+namespace manipulator {
+// Makes simple_modifications and complex_modifications manipulators of the selected profile.
+//
+// `build` is expensive (parsing json, compiling regexes) and it does not touch manipulator_managers.
+// Thus, device_grabber calls `build` in a background queue and applies the result in the main queue.
+//
+// Note:
+//   `build` is not thread-safe. Call it from one queue.
+class profile_manipulators_builder final {
+public:
+  // An immutable result of `build`.
+  class snapshot final {
+  public:
+    snapshot(const std::shared_ptr<core_configuration>& core_configuration,
+             std::vector<std::shared_ptr<details::base>>&& simple_modifications_manipulators,
+             std::vector<std::shared_ptr<details::base>>&& complex_modifications_manipulators,
+             std::vector<std::shared_ptr<details::base>>&& dropped_manipulators) : core_configuration_(core_configuration),
+                                                                                   simple_modifications_manipulators_(std::move(simple_modifications_manipulators)),
+                                                                                   complex_modifications_manipulators_(std::move(complex_modifications_manipulators)),
+                                                                                   dropped_manipulators_(std::move(dropped_manipulators)) {
+    }
+
+    const std::shared_ptr<core_configuration>& get_core_configuration(void) const {
+      return core_configuration_;
+    }
+
+    const core_configuration::profile& get_profile(void) const {
+      return core_configuration_->get_selected_profile();
+    }
+
+    const std::vector<std::shared_ptr<details::base>>& get_simple_modifications_manipulators(void) const {
+      return simple_modifications_manipulators_;
+    }
+
+    const std::vector<std::shared_ptr<details::base>>& get_complex_modifications_manipulators(void) const {
+      return complex_modifications_manipulators_;
+    }
+
+    // Manipulators which are dropped from the cache by `build`.
+    // The snapshot keeps them in order to destroy them where the snapshot is released (the main queue) instead of the build queue.
+    const std::vector<std::shared_ptr<details::base>>& get_dropped_manipulators(void) const {
+      return dropped_manipulators_;
+    }
+
+  private:
+    std::shared_ptr<core_configuration> core_configuration_;
+    std::vector<std::shared_ptr<details::base>> simple_modifications_manipulators_;
+    std::vector<std::shared_ptr<details::base>> complex_modifications_manipulators_;
+    std::vector<std::shared_ptr<details::base>> dropped_manipulators_;
+  };
+
+  profile_manipulators_builder(const profile_manipulators_builder&) = delete;
+
+  profile_manipulators_builder(void) {
+  }
+
+  // Unchanged manipulators since the last `build` are reused in order to avoid rebuilding all manipulators when a rule is toggled.
+  // (The state of reused manipulators such as held keys is also kept.)
+  //
+  // `build` returns nullptr if `canceled` returns true while building.
+  // (The cache is kept as if `build` was not called.)
+  //
+  // `build` never destroys manipulators. Dropped manipulators are moved into the snapshot.
+  // Release the snapshot (and the builder) in the main queue.
+  std::shared_ptr<const snapshot> build(const std::shared_ptr<core_configuration>& core_configuration,
+                                        const std::function<bool(void)>& canceled = nullptr) {
+    const auto& profile = core_configuration->get_selected_profile();
+
+    auto simple_modifications_manipulators = make_simple_modifications_manipulators(profile, canceled);
+    auto complex_modifications_manipulators = make_complex_modifications_manipulators(profile, canceled);
+
+    if (canceled && canceled()) {
+      simple_modifications_manipulator_cache_.rollback();
+      complex_modifications_manipulator_cache_.rollback();
+      return nullptr;
+    }
+
+    simple_modifications_manipulator_cache_.commit();
+    complex_modifications_manipulator_cache_.commit();
+
+    auto dropped_manipulators = simple_modifications_manipulator_cache_.take_dropped_manipulators();
+    for (auto&& m : complex_modifications_manipulator_cache_.take_dropped_manipulators()) {
+      dropped_manipulators.push_back(std::move(m));
+    }
+
+    return std::make_shared<snapshot>(core_configuration,
+                                      std::move(simple_modifications_manipulators),
+                                      std::move(complex_modifications_manipulators),
+                                      std::move(dropped_manipulators));
+  }
+
+  static std::shared_ptr<details::conditions::base> make_device_if_condition(const core_configuration::profile::device& device) {
+    return std::make_shared<details::conditions::device>(device.get_identifiers());
+  }
+
+private:
+  std::vector<std::shared_ptr<details::base>> make_simple_modifications_manipulators(const core_configuration::profile& profile,
+                                                                                     const std::function<bool(void)>& canceled) {
+    std::vector<std::shared_ptr<details::base>> manipulators;
+
+    for (const auto& device : profile.get_devices()) {
+      if (canceled && canceled()) {
+        return manipulators;
+      }
+
+      for (const auto& pair : device.get_simple_modifications().get_pairs()) {
+        auto json = nlohmann::json::array({device.get_identifiers().to_json(),
+                                           pair.first.to_json(),
+                                           pair.second.to_json()});
+        auto m = simple_modifications_manipulator_cache_.find_or_make(json, [&] {
+          auto m = make_simple_modifications_manipulator(pair);
+          if (m) {
+            auto c = make_device_if_condition(device);
+            m->push_back_condition(c);
+          }
+          return m;
+        });
+        if (m) {
+          manipulators.push_back(m);
+        }
+      }
+    }
+
+    for (const auto& pair : profile.get_simple_modifications().get_pairs()) {
+      auto json = nlohmann::json::array({nullptr,
+                                         pair.first.to_json(),
+                                         pair.second.to_json()});
+      auto m = simple_modifications_manipulator_cache_.find_or_make(json, [&] {
+        return make_simple_modifications_manipulator(pair);
+      });
+      if (m) {
+        manipulators.push_back(m);
+      }
+    }
+
+    return manipulators;
+  }
+
+  static std::shared_ptr<details::base> make_simple_modifications_manipulator(const std::pair<core_configuration::profile::simple_modifications::definition, core_configuration::profile::simple_modifications::definition>& pair) {
+    if (pair.first.valid() && pair.second.valid()) {
+      auto from_json = pair.first.to_json();
+      from_json["modifiers"]["optional"] = "any";
+
+      auto to_json = pair.second.to_json();
+
+      return std::make_shared<details::basic>(details::from_event_definition(from_json),
+                                              details::to_event_definition(to_json));
+    }
+    return nullptr;
+  }
+
+  std::vector<std::shared_ptr<details::base>> make_complex_modifications_manipulators(const core_configuration::profile& profile,
+                                                                                      const std::function<bool(void)>& canceled) {
+    // Manipulators depend on the global parameters which are not included in the manipulator json.
+    auto parameters_json = profile.get_complex_modifications().get_parameters().to_json();
+    if (complex_modifications_parameters_json_ != parameters_json) {
+      complex_modifications_manipulator_cache_.clear();
+      complex_modifications_parameters_json_ = parameters_json;
+    }
+
+    std::vector<std::shared_ptr<details::base>> manipulators;
+
+    for (const auto& rule : profile.get_complex_modifications().get_rules()) {
+      if (canceled && canceled()) {
+        return manipulators;
+      }
+
+      for (const auto& manipulator : rule.get_manipulators()) {
+        auto m = complex_modifications_manipulator_cache_.find_or_make(manipulator.get_json(), [&] {
+          auto m = manipulator_factory::make_manipulator(manipulator.get_json(), manipulator.get_parameters());
+          for (const auto& c : manipulator.get_conditions()) {
+            m->push_back_condition(manipulator_factory::make_condition(c.get_json()));
+          }
+          return m;
+        });
+        manipulators.push_back(m);
+      }
+    }
+
+    return manipulators;
+  }
+
+  manipulator_cache simple_modifications_manipulator_cache_;
+  manipulator_cache complex_modifications_manipulator_cache_;
+  nlohmann::json complex_modifications_parameters_json_;
+};
+} // namespace manipulator
+} // namespace krbn
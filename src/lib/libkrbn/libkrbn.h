@@ -141,6 +141,11 @@ bool libkrbn_core_configuration_get_selected_profile_device_disable_built_in_key
 void libkrbn_core_configuration_set_selected_profile_device_disable_built_in_keyboard_if_exists(libkrbn_core_configuration* _Nonnull p,
                                                                                                 libkrbn_device_identifiers* _Nullable device_identifiers,
                                                                                                 bool value);
+bool libkrbn_core_configuration_get_selected_profile_device_coalesce_pointing_motion(libkrbn_core_configuration* _Nonnull p,
+                                                                                     libkrbn_device_identifiers* _Nullable device_identifiers);
+void libkrbn_core_configuration_set_selected_profile_device_coalesce_pointing_motion(libkrbn_core_configuration* _Nonnull p,
+                                                                                     libkrbn_device_identifiers* _Nullable device_identifiers,
+                                                                                     bool value);
 
 // ----------------------------------------
 // libkrbn_complex_modifications_assets_manager
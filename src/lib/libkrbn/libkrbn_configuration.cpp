@@ -437,6 +437,28 @@ void libkrbn_core_configuration_set_selected_profile_device_disable_built_in_key
   }
 }
 
+bool libkrbn_core_configuration_get_selected_profile_device_coalesce_pointing_motion(libkrbn_core_configuration* p,
+                                                                                     libkrbn_device_identifiers* device_identifiers) {
+  if (auto c = reinterpret_cast<libkrbn_core_configuration_class*>(p)) {
+    if (device_identifiers) {
+      auto identifiers = libkrbn_cpp::make_device_identifiers(*device_identifiers);
+      return c->get_core_configuration().get_selected_profile().get_device_coalesce_pointing_motion(identifiers);
+    }
+  }
+  return false;
+}
+
+void libkrbn_core_configuration_set_selected_profile_device_coalesce_pointing_motion(libkrbn_core_configuration* p,
+                                                                                     libkrbn_device_identifiers* device_identifiers,
+                                                                                     bool value) {
+  if (auto c = reinterpret_cast<libkrbn_core_configuration_class*>(p)) {
+    if (device_identifiers) {
+      auto identifiers = libkrbn_cpp::make_device_identifiers(*device_identifiers);
+      c->get_core_configuration().get_selected_profile().set_device_coalesce_pointing_motion(identifiers, value);
+    }
+  }
+}
+
 bool libkrbn_configuration_monitor_initialize(libkrbn_configuration_monitor** out, libkrbn_configuration_monitor_callback callback, void* refcon) {
   if (!out) return false;
   // return if already initialized.
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "logger.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <json/json.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace krbn {
+// Writes json to a file in a background thread.
+//
+// `async_save` does not wait for file I/O.
+// The file is written `interval` after the first `async_save` since the last write,
+// and only the latest json is written. (Updates in the interval are coalesced.)
+// Later updates do not postpone the write, so the file lags at most `interval` behind continuous updates.
+//
+// `async_save_with` takes a function which makes json instead of json.
+// The function is called in the background thread when the file is written,
+// so callers can defer taking a snapshot of their state and building json until then.
+//
+// The file is replaced atomically by writing a temporary file and renaming it.
+// Pending json is written before the destructor returns.
+class async_json_file_writer final {
+public:
+  async_json_file_writer(const async_json_file_writer&) = delete;
+
+  async_json_file_writer(const std::string& file_path,
+                         std::chrono::milliseconds interval) : file_path_(file_path),
+                                                               interval_(interval),
+                                                               writing_(false),
+                                                               flush_requested_(false),
+                                                               exit_(false),
+                                                               write_count_(0) {
+    thread_ = std::thread([this] {
+      run();
+    });
+  }
+
+  ~async_json_file_writer(void) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_ = true;
+    }
+    cv_.notify_one();
+
+    thread_.join();
+  }
+
+  const std::string& get_file_path(void) const {
+    return file_path_;
+  }
+
+  void async_save(nlohmann::json json) {
+    async_save_with([json = std::move(json)] {
+      return json;
+    });
+  }
+
+  void async_save_with(std::function<nlohmann::json(void)> make_json) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (!pending_json_) {
+        deadline_ = std::chrono::steady_clock::now() + interval_;
+      }
+      pending_json_ = std::move(make_json);
+    }
+    cv_.notify_one();
+  }
+
+  // Writes the pending json without waiting for `interval` and waits until it is written.
+  void flush(void) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    flush_requested_ = true;
+    cv_.notify_one();
+
+    written_cv_.wait(lock, [this] {
+      return !pending_json_ && !writing_;
+    });
+
+    flush_requested_ = false;
+  }
+
+  // The number of files which are written.
+  size_t get_write_count(void) const {
+    return write_count_;
+  }
+
+private:
+  void run(void) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (;;) {
+      if (pending_json_) {
+        if (!exit_ &&
+            !flush_requested_ &&
+            std::chrono::steady_clock::now() < deadline_) {
+          cv_.wait_until(lock, deadline_);
+          continue;
+        }
+
+        auto make_json = std::move(pending_json_);
+        pending_json_ = nullptr;
+        writing_ = true;
+
+        lock.unlock();
+        write(make_json());
+        lock.lock();
+
+        writing_ = false;
+        written_cv_.notify_all();
+        continue;
+      }
+
+      if (exit_) {
+        break;
+      }
+
+      cv_.wait(lock);
+    }
+  }
+
+  void write(const nlohmann::json& json) {
+    filesystem::create_directory_with_intermediate_directories(filesystem::dirname(file_path_), 0755);
+
+    auto tmp_file_path = file_path_ + ".tmp";
+
+    {
+      std::ofstream output(tmp_file_path);
+      if (!output) {
+        logger::get_logger().warn("Failed to open {0}", tmp_file_path);
+        return;
+      }
+
+      output << std::setw(4) << json << std::endl;
+
+      if (!output) {
+        logger::get_logger().warn("Failed to write {0}", tmp_file_path);
+        unlink(tmp_file_path.c_str());
+        return;
+      }
+    }
+
+    if (rename(tmp_file_path.c_str(), file_path_.c_str()) != 0) {
+      logger::get_logger().warn("Failed to rename {0}", tmp_file_path);
+      unlink(tmp_file_path.c_str());
+      return;
+    }
+
+    ++write_count_;
+  }
+
+  std::string file_path_;
+  std::chrono::milliseconds interval_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable written_cv_;
+  std::function<nlohmann::json(void)> pending_json_;
+  std::chrono::steady_clock::time_point deadline_;
+  bool writing_;
+  bool flush_requested_;
+  bool exit_;
+
+  std::atomic<size_t> write_count_;
+  std::thread thread_;
+};
+} // namespace krbn
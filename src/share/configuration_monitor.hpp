@@ -6,15 +6,29 @@
 #include "file_monitor.hpp"
 #include "filesystem.hpp"
 #include "logger.hpp"
+#include <atomic>
+#include <mutex>
 
 namespace krbn {
 class configuration_monitor final {
 public:
   typedef std::function<void(std::shared_ptr<core_configuration> core_configuration)> core_configuration_updated_callback;
 
+  // `callback` is called in the main queue.
+  // If `load_in_background` is true, karabiner.json is reloaded and `callback` is called in a background serial queue
+  // in order to avoid blocking the main queue while loading a large karabiner.json.
+  // (The first karabiner.json is loaded and `callback` is called in the constructor even if `load_in_background` is true.)
   configuration_monitor(const std::string& user_core_configuration_file_path,
-                        const core_configuration_updated_callback& callback) : user_core_configuration_file_path_(user_core_configuration_file_path),
-                                                                               callback_(callback) {
+                        const core_configuration_updated_callback& callback,
+                        bool load_in_background = false) : loader_(std::make_shared<loader>(user_core_configuration_file_path, callback)),
+                                                           load_requested_(false) {
+    if (load_in_background) {
+      queue_ = std::make_unique<gcd_utility::scoped_queue>();
+
+      loader_->load();
+      load_requested_ = true;
+    }
+
     std::vector<std::pair<std::string, std::vector<std::string>>> targets = {
         {constants::get_system_configuration_directory(), {constants::get_system_core_configuration_file_path()}},
         {filesystem::dirname(user_core_configuration_file_path), {user_core_configuration_file_path}},
@@ -27,7 +41,7 @@ public:
 
     // file_monitor doesn't call the callback if target files are not exists.
     // Thus, we call the callback manually at here if the callback is not called yet.
-    if (!core_configuration_) {
+    if (!load_requested_) {
       core_configuration_file_updated_callback();
     }
   }
@@ -37,35 +51,95 @@ public:
     gcd_utility::dispatch_sync_in_main_queue(^{
       file_monitor_ = nullptr;
     });
+
+    // Pending loads are canceled without waiting for them.
+    // (They keep `loader_` and `callback` alive until they are finished.
+    // Thus, `callback` should not own objects which must be released in the main queue.)
+    loader_->cancel();
   }
 
   std::shared_ptr<core_configuration> get_core_configuration(void) {
-    return core_configuration_;
+    return loader_->get_core_configuration();
   }
 
 private:
-  void core_configuration_file_updated_callback(void) {
-    logger::get_logger().info("Load karabiner.json...");
-
-    std::string file_path = constants::get_system_core_configuration_file_path();
-    if (filesystem::exists(user_core_configuration_file_path_)) {
-      file_path = user_core_configuration_file_path_;
+  // The state which is shared with loads in the background queue.
+  class loader final {
+  public:
+    loader(const std::string& user_core_configuration_file_path,
+           const core_configuration_updated_callback& callback) : user_core_configuration_file_path_(user_core_configuration_file_path),
+                                                                  callback_(callback),
+                                                                  canceled_(false) {
     }
 
-    auto c = std::make_shared<core_configuration>(file_path);
-    if (!core_configuration_ || c->is_loaded()) {
+    void load(void) {
+      if (canceled_) {
+        return;
+      }
+
+      logger::get_logger().info("Load karabiner.json...");
+
+      std::string file_path = constants::get_system_core_configuration_file_path();
+      if (filesystem::exists(user_core_configuration_file_path_)) {
+        file_path = user_core_configuration_file_path_;
+      }
+
+      auto c = std::make_shared<core_configuration>(file_path);
+
+      {
+        std::lock_guard<std::mutex> guard(core_configuration_mutex_);
+
+        if (core_configuration_ && !c->is_loaded()) {
+          return;
+        }
+
+        core_configuration_ = c;
+      }
+
+      if (canceled_) {
+        return;
+      }
+
       logger::get_logger().info("core_configuration is updated.");
-      core_configuration_ = c;
       if (callback_) {
-        callback_(core_configuration_);
+        callback_(c);
       }
     }
-  }
 
-  std::string user_core_configuration_file_path_;
-  core_configuration_updated_callback callback_;
+    void cancel(void) {
+      canceled_ = true;
+    }
+
+    std::shared_ptr<core_configuration> get_core_configuration(void) {
+      std::lock_guard<std::mutex> guard(core_configuration_mutex_);
+
+      return core_configuration_;
+    }
+
+  private:
+    std::string user_core_configuration_file_path_;
+    core_configuration_updated_callback callback_;
+    std::atomic<bool> canceled_;
+    std::shared_ptr<core_configuration> core_configuration_;
+    std::mutex core_configuration_mutex_;
+  };
+
+  void core_configuration_file_updated_callback(void) {
+    load_requested_ = true;
+
+    if (queue_) {
+      auto l = loader_;
+      dispatch_async(queue_->get(), ^{
+        l->load();
+      });
+    } else {
+      loader_->load();
+    }
+  }
 
+  std::shared_ptr<loader> loader_;
+  std::unique_ptr<gcd_utility::scoped_queue> queue_;
   std::unique_ptr<file_monitor> file_monitor_;
-  std::shared_ptr<core_configuration> core_configuration_;
+  bool load_requested_;
 };
 } // namespace krbn
@@ -259,6 +259,25 @@ public:
         }
       }
     }
+    bool get_device_coalesce_pointing_motion(const device_identifiers& identifiers) const {
+      for (const auto& d : devices_) {
+        if (d.get_identifiers() == identifiers) {
+          return d.get_coalesce_pointing_motion();
+        }
+      }
+      return false;
+    }
+    void set_device_coalesce_pointing_motion(const device_identifiers& identifiers,
+                                             bool coalesce_pointing_motion) {
+      add_device(identifiers);
+
+      for (auto&& device : devices_) {
+        if (device.get_identifiers() == identifiers) {
+          device.set_coalesce_pointing_motion(coalesce_pointing_motion);
+          return;
+        }
+      }
+    }
 
   private:
     void add_device(const device_identifiers& identifiers) {
@@ -6,6 +6,7 @@ public:
                                        identifiers_(json.find("identifiers") != json.end() ? json["identifiers"] : nlohmann::json()),
                                        ignore_(false),
                                        disable_built_in_keyboard_if_exists_(false),
+                                       coalesce_pointing_motion_(false),
                                        simple_modifications_(json.find("simple_modifications") != json.end() ? json["simple_modifications"] : nlohmann::json::array()),
                                        fn_function_keys_(make_default_fn_function_keys_json()) {
     {
@@ -20,6 +21,12 @@ public:
         disable_built_in_keyboard_if_exists_ = json[key];
       }
     }
+    {
+      const std::string key = "coalesce_pointing_motion";
+      if (json.find(key) != json.end() && json[key].is_boolean()) {
+        coalesce_pointing_motion_ = json[key];
+      }
+    }
     {
       const std::string key = "fn_function_keys";
       if (json.find(key) != json.end()) {
@@ -87,6 +94,7 @@ public:
     j["identifiers"] = identifiers_;
     j["ignore"] = ignore_;
     j["disable_built_in_keyboard_if_exists"] = disable_built_in_keyboard_if_exists_;
+    j["coalesce_pointing_motion"] = coalesce_pointing_motion_;
     j["simple_modifications"] = simple_modifications_;
     j["fn_function_keys"] = fn_function_keys_;
     return j;
@@ -110,6 +118,13 @@ public:
     disable_built_in_keyboard_if_exists_ = value;
   }
 
+  bool get_coalesce_pointing_motion(void) const {
+    return coalesce_pointing_motion_;
+  }
+  void set_coalesce_pointing_motion(bool value) {
+    coalesce_pointing_motion_ = value;
+  }
+
   const simple_modifications& get_simple_modifications(void) const {
     return simple_modifications_;
   }
@@ -129,6 +144,7 @@ private:
   device_identifiers identifiers_;
   bool ignore_;
   bool disable_built_in_keyboard_if_exists_;
+  bool coalesce_pointing_motion_;
   simple_modifications simple_modifications_;
   simple_modifications fn_function_keys_;
 };
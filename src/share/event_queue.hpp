@@ -5,10 +5,13 @@
 #include "manipulator_environment.hpp"
 #include "modifier_flag_manager.hpp"
 #include "pointing_button_manager.hpp"
+#include "ring_buffer.hpp"
 #include "stream_utility.hpp"
 #include "types.hpp"
+#include <boost/functional/hash.hpp>
 #include <boost/optional.hpp>
-#include <boost/variant.hpp>
+#include <mutex>
+#include <unordered_set>
 
 namespace krbn {
 class event_queue final {
@@ -42,11 +45,11 @@ public:
       };
 
       event(void) : type_(type::none),
-                    value_(boost::blank()) {
+                    has_value_(false),
+                    value_(0) {
       }
 
-      event(const nlohmann::json& json) : type_(type::none),
-                                          value_(boost::blank()) {
+      event(const nlohmann::json& json) : event() {
         if (json.is_object()) {
           auto it_type = json.find("type");
           if (it_type != std::end(json)) {
@@ -60,7 +63,7 @@ public:
                 auto it = json.find("key_code");
                 if (it != std::end(json)) {
                   if (auto v = types::make_key_code(it->get<std::string>())) {
-                    value_ = *v;
+                    set_value(static_cast<int64_t>(*v));
                   }
                 }
                 break;
@@ -70,7 +73,7 @@ public:
                 auto it = json.find("consumer_key_code");
                 if (it != std::end(json)) {
                   if (auto v = types::make_consumer_key_code(it->get<std::string>())) {
-                    value_ = *v;
+                    set_value(static_cast<int64_t>(*v));
                   }
                 }
                 break;
@@ -80,7 +83,7 @@ public:
                 auto it = json.find("pointing_button");
                 if (it != std::end(json)) {
                   if (auto v = types::make_pointing_button(it->get<std::string>())) {
-                    value_ = *v;
+                    set_value(static_cast<int64_t>(*v));
                   }
                 }
                 break;
@@ -93,7 +96,7 @@ public:
               case type::caps_lock_state_changed: {
                 auto it = json.find("integer_value");
                 if (it != std::end(json)) {
-                  value_ = it->get<int>();
+                  set_value(it->get<int>());
                 }
                 break;
               }
@@ -101,7 +104,7 @@ public:
               case type::shell_command: {
                 auto it = json.find("shell_command");
                 if (it != std::end(json)) {
-                  value_ = it->get<std::string>();
+                  set_value(interned_values<std::string>::intern(it->get<std::string>()));
                 }
                 break;
               }
@@ -113,7 +116,7 @@ public:
                   for (const auto& j : *it) {
                     input_source_selectors.emplace_back(j);
                   }
-                  value_ = input_source_selectors;
+                  set_value(interned_values<std::vector<input_source_selector>>::intern(input_source_selectors));
                 }
                 break;
               }
@@ -134,7 +137,8 @@ public:
                       pair.second = *i;
                     }
                   }
-                  value_ = pair;
+                  set_value(make_set_variable_value(manipulator_environment::make_variable_id(pair.first),
+                                                    pair.second));
                 }
                 break;
               }
@@ -142,7 +146,7 @@ public:
               case type::frontmost_application_changed: {
                 auto it = json.find("frontmost_application");
                 if (it != std::end(json)) {
-                  value_ = manipulator_environment::frontmost_application(*it);
+                  set_value(interned_values<manipulator_environment::frontmost_application>::intern(manipulator_environment::frontmost_application(*it)));
                 }
                 break;
               }
@@ -150,7 +154,7 @@ public:
               case type::input_source_changed: {
                 auto it = json.find("input_source_identifiers");
                 if (it != std::end(json)) {
-                  value_ = input_source_identifiers(*it);
+                  set_value(interned_values<input_source_identifiers>::intern(input_source_identifiers(*it)));
                 }
                 break;
               }
@@ -251,40 +255,45 @@ public:
       }
 
       event(key_code key_code) : type_(type::key_code),
-                                 value_(key_code) {
+                                 has_value_(true),
+                                 value_(static_cast<int64_t>(key_code)) {
       }
 
       event(consumer_key_code consumer_key_code) : type_(type::consumer_key_code),
-                                                   value_(consumer_key_code) {
+                                                   has_value_(true),
+                                                   value_(static_cast<int64_t>(consumer_key_code)) {
       }
 
       event(pointing_button pointing_button) : type_(type::pointing_button),
-                                               value_(pointing_button) {
+                                               has_value_(true),
+                                               value_(static_cast<int64_t>(pointing_button)) {
       }
 
       event(type type,
             int64_t integer_value) : type_(type),
+                                     has_value_(true),
                                      value_(integer_value) {
       }
 
       static event make_shell_command_event(const std::string& shell_command) {
         event e;
         e.type_ = type::shell_command;
-        e.value_ = shell_command;
+        e.set_value(interned_values<std::string>::intern(shell_command));
         return e;
       }
 
       static event make_select_input_source_event(const std::vector<input_source_selector>& input_source_selector) {
         event e;
         e.type_ = type::select_input_source;
-        e.value_ = input_source_selector;
+        e.set_value(interned_values<std::vector<krbn::input_source_selector>>::intern(input_source_selector));
         return e;
       }
 
       static event make_set_variable_event(const std::pair<std::string, int>& pair) {
         event e;
         e.type_ = type::set_variable;
-        e.value_ = pair;
+        e.set_value(make_set_variable_value(manipulator_environment::make_variable_id(pair.first),
+                                            pair.second));
         return e;
       }
 
@@ -312,15 +321,15 @@ public:
                                                             const std::string& file_path) {
         event e;
         e.type_ = type::frontmost_application_changed;
-        e.value_ = manipulator_environment::frontmost_application(bundle_identifier,
-                                                                  file_path);
+        e.set_value(interned_values<manipulator_environment::frontmost_application>::intern(manipulator_environment::frontmost_application(bundle_identifier,
+                                                                                                                                          file_path)));
         return e;
       }
 
       static event make_input_source_changed_event(const input_source_identifiers& input_source_identifiers) {
         event e;
         e.type_ = type::input_source_changed;
-        e.value_ = input_source_identifiers;
+        e.set_value(interned_values<krbn::input_source_identifiers>::intern(input_source_identifiers));
         return e;
       }
 
@@ -329,112 +338,147 @@ public:
       }
 
       boost::optional<key_code> get_key_code(void) const {
-        try {
-          if (type_ == type::key_code) {
-            return boost::get<key_code>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::key_code && has_value_) {
+          return key_code(value_);
         }
         return boost::none;
       }
 
       boost::optional<consumer_key_code> get_consumer_key_code(void) const {
-        try {
-          if (type_ == type::consumer_key_code) {
-            return boost::get<consumer_key_code>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::consumer_key_code && has_value_) {
+          return consumer_key_code(value_);
         }
         return boost::none;
       }
 
       boost::optional<pointing_button> get_pointing_button(void) const {
-        try {
-          if (type_ == type::pointing_button) {
-            return boost::get<pointing_button>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::pointing_button && has_value_) {
+          return pointing_button(value_);
         }
         return boost::none;
       }
 
       boost::optional<int64_t> get_integer_value(void) const {
-        try {
-          if (type_ == type::pointing_x ||
-              type_ == type::pointing_y ||
-              type_ == type::pointing_vertical_wheel ||
-              type_ == type::pointing_horizontal_wheel ||
-              type_ == type::caps_lock_state_changed) {
-            return boost::get<int64_t>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if ((type_ == type::pointing_x ||
+             type_ == type::pointing_y ||
+             type_ == type::pointing_vertical_wheel ||
+             type_ == type::pointing_horizontal_wheel ||
+             type_ == type::caps_lock_state_changed) &&
+            has_value_) {
+          return value_;
         }
         return boost::none;
       }
 
       boost::optional<std::string> get_shell_command(void) const {
-        try {
-          if (type_ == type::shell_command) {
-            return boost::get<std::string>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::shell_command && has_value_) {
+          return interned_values<std::string>::get(value_);
         }
         return boost::none;
       }
 
       boost::optional<std::vector<input_source_selector>> get_input_source_selectors(void) const {
-        try {
-          if (type_ == type::select_input_source) {
-            return boost::get<std::vector<input_source_selector>>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::select_input_source && has_value_) {
+          return interned_values<std::vector<input_source_selector>>::get(value_);
         }
         return boost::none;
       }
 
       boost::optional<std::pair<std::string, int>> get_set_variable(void) const {
-        try {
-          if (type_ == type::set_variable) {
-            return boost::get<std::pair<std::string, int>>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (auto v = get_set_variable_id_and_value()) {
+          return std::make_pair(manipulator_environment::get_variable_name(v->first),
+                                v->second);
+        }
+        return boost::none;
+      }
+
+      boost::optional<std::pair<manipulator_environment::variable_id, int>> get_set_variable_id_and_value(void) const {
+        if (type_ == type::set_variable && has_value_) {
+          return std::make_pair(static_cast<manipulator_environment::variable_id>(static_cast<uint64_t>(value_) >> 32),
+                                static_cast<int>(static_cast<int32_t>(static_cast<uint32_t>(value_))));
         }
         return boost::none;
       }
 
       boost::optional<manipulator_environment::frontmost_application> get_frontmost_application(void) const {
-        try {
-          if (type_ == type::frontmost_application_changed) {
-            return boost::get<manipulator_environment::frontmost_application>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::frontmost_application_changed && has_value_) {
+          return interned_values<manipulator_environment::frontmost_application>::get(value_);
         }
         return boost::none;
       }
 
       boost::optional<input_source_identifiers> get_input_source_identifiers(void) const {
-        try {
-          if (type_ == type::input_source_changed) {
-            return boost::get<input_source_identifiers>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::input_source_changed && has_value_) {
+          return interned_values<input_source_identifiers>::get(value_);
         }
         return boost::none;
       }
 
       bool operator==(const event& other) const {
+        // Payloads are interned, so equal payloads have the same handle.
         return get_type() == other.get_type() &&
+               has_value_ == other.has_value_ &&
                value_ == other.value_;
       }
 
+      // For boost::hash. Consistent with `operator==`.
+      friend size_t hash_value(const event& value) {
+        size_t seed = static_cast<size_t>(value.type_);
+        boost::hash_combine(seed, value.has_value_);
+        boost::hash_combine(seed, value.value_);
+        return seed;
+      }
+
     private:
+      // Large payloads (shell_command, input_source_selectors, etc.) are stored in `interned_values`
+      // and `event` holds only their handle in order to keep `event` trivially copyable.
+      //
+      // The handle is the address of the interned value.
+      // Interned values are never moved or removed, so `get` does not require the lock.
+      template <typename T>
+      class interned_values final {
+      public:
+        static int64_t intern(const T& value) {
+          std::lock_guard<std::mutex> guard(get_mutex());
+
+          auto it = get_values().insert(value).first;
+          return static_cast<int64_t>(reinterpret_cast<intptr_t>(&(*it)));
+        }
+
+        static const T& get(int64_t handle) {
+          return *reinterpret_cast<const T*>(static_cast<intptr_t>(handle));
+        }
+
+      private:
+        static std::mutex& get_mutex(void) {
+          static std::mutex mutex;
+          return mutex;
+        }
+
+        // The elements of std::unordered_set are not moved by rehashing.
+        static std::unordered_set<T, boost::hash<T>>& get_values(void) {
+          static std::unordered_set<T, boost::hash<T>> values;
+          return values;
+        }
+      };
+
       static event make_virtual_event(type type) {
         event e;
         e.type_ = type;
-        e.value_ = boost::blank();
         return e;
       }
 
+      void set_value(int64_t value) {
+        has_value_ = true;
+        value_ = value;
+      }
+
+      // set_variable is stored as (variable_id << 32 | value).
+      static int64_t make_set_variable_value(manipulator_environment::variable_id id, int value) {
+        return static_cast<int64_t>((static_cast<uint64_t>(id) << 32) |
+                                    static_cast<uint32_t>(value));
+      }
+
       static const char* to_c_string(type t) {
 #define TO_C_STRING(TYPE) \
   case type::TYPE:        \
@@ -500,20 +544,18 @@ public:
       }
 
       type type_;
+      bool has_value_;
 
-      boost::variant<key_code, // For type::key_code
-                     consumer_key_code, // For type::consumer_key_code
-                     pointing_button, // For type::pointing_button
-                     int64_t, // For type::pointing_x, type::pointing_y, type::pointing_vertical_wheel, type::pointing_horizontal_wheel
-                     std::string, // For shell_command
-                     std::vector<input_source_selector>, // For select_input_source
-                     std::pair<std::string, int>, // For set_variable
-                     manipulator_environment::frontmost_application, // For frontmost_application_changed
-                     input_source_identifiers, // For input_source_changed
-                     boost::blank> // For virtual events
-          value_;
+      // key_code, consumer_key_code, pointing_button: the enum value
+      // pointing_x, pointing_y, pointing_vertical_wheel, pointing_horizontal_wheel, caps_lock_state_changed: integer_value
+      // set_variable: variable_id and value (See `make_set_variable_value`.)
+      // shell_command, select_input_source, frontmost_application_changed, input_source_changed: handle of interned_values
+      int64_t value_;
     };
 
+    static_assert(std::is_trivially_copyable<event>::value, "event should be trivially copyable");
+    static_assert(sizeof(event) == 16, "sizeof(event) should be 16");
+
     queued_event(device_id device_id,
                  uint64_t time_stamp,
                  const class event& event,
@@ -647,7 +689,19 @@ public:
 
   event_queue(const event_queue&) = delete;
 
-  event_queue(void) : time_stamp_delay_(0) {
+  event_queue(void) : events_(256),
+                      time_stamp_delay_(0) {
+  }
+
+  // Pointing motion events (pointing_x, pointing_y and wheels) from physical devices are merged into
+  // the preceding motion event of the same type while the window is set.
+  // (See `coalesce_pointing_motion_event`.)
+  const boost::optional<uint64_t>& get_pointing_motion_coalescing_window(void) const {
+    return pointing_motion_coalescing_window_;
+  }
+
+  void set_pointing_motion_coalescing_window(const boost::optional<uint64_t>& value) {
+    pointing_motion_coalescing_window_ = value;
   }
 
   // from physical device
@@ -689,35 +743,26 @@ public:
     switch (usage_page) {
       case hid_usage_page::generic_desktop:
         switch (usage) {
-          case hid_usage::gd_x: {
-            queued_event::event event(queued_event::event::type::pointing_x, integer_value);
-            emplace_back_event(device_id,
-                               time_stamp,
-                               event,
-                               event_type::single,
-                               event);
+          case hid_usage::gd_x:
+            emplace_back_pointing_motion_event(device_id,
+                                               time_stamp,
+                                               queued_event::event::type::pointing_x,
+                                               integer_value);
             return true;
-          }
 
-          case hid_usage::gd_y: {
-            queued_event::event event(queued_event::event::type::pointing_y, integer_value);
-            emplace_back_event(device_id,
-                               time_stamp,
-                               event,
-                               event_type::single,
-                               event);
+          case hid_usage::gd_y:
+            emplace_back_pointing_motion_event(device_id,
+                                               time_stamp,
+                                               queued_event::event::type::pointing_y,
+                                               integer_value);
             return true;
-          }
 
-          case hid_usage::gd_wheel: {
-            queued_event::event event(queued_event::event::type::pointing_vertical_wheel, integer_value);
-            emplace_back_event(device_id,
-                               time_stamp,
-                               event,
-                               event_type::single,
-                               event);
+          case hid_usage::gd_wheel:
+            emplace_back_pointing_motion_event(device_id,
+                                               time_stamp,
+                                               queued_event::event::type::pointing_vertical_wheel,
+                                               integer_value);
             return true;
-          }
 
           default:
             break;
@@ -726,15 +771,12 @@ public:
 
       case hid_usage_page::consumer:
         switch (usage) {
-          case hid_usage::csmr_acpan: {
-            queued_event::event event(queued_event::event::type::pointing_horizontal_wheel, integer_value);
-            emplace_back_event(device_id,
-                               time_stamp,
-                               event,
-                               event_type::single,
-                               event);
+          case hid_usage::csmr_acpan:
+            emplace_back_pointing_motion_event(device_id,
+                                               time_stamp,
+                                               queued_event::event::type::pointing_horizontal_wheel,
+                                               integer_value);
             return true;
-          }
 
           default:
             break;
@@ -810,7 +852,7 @@ public:
       manipulator_environment_.set_input_source_identifiers(*input_source_identifiers);
     }
     if (event_type == event_type::key_down) {
-      if (auto set_variable = event.get_set_variable()) {
+      if (auto set_variable = event.get_set_variable_id_and_value()) {
         manipulator_environment_.set_variable(set_variable->first,
                                               set_variable->second);
       }
@@ -836,7 +878,7 @@ public:
   }
 
   void erase_front_event(void) {
-    events_.erase(std::begin(events_));
+    events_.pop_front();
     if (events_.empty()) {
       time_stamp_delay_ = 0;
     }
@@ -846,7 +888,7 @@ public:
     return events_.empty();
   }
 
-  const std::vector<queued_event>& get_events(void) const {
+  const ring_buffer<queued_event>& get_events(void) const {
     return events_;
   }
 
@@ -878,8 +920,9 @@ public:
     return manipulator_environment_;
   }
 
-  void enable_manipulator_environment_json_output(const std::string& file_path) {
-    manipulator_environment_.enable_json_output(file_path);
+  void enable_manipulator_environment_json_output(const std::string& file_path,
+                                                  std::chrono::milliseconds interval = std::chrono::milliseconds(100)) {
+    manipulator_environment_.enable_json_output(file_path, interval);
   }
 
   void disable_manipulator_environment_json_output(void) {
@@ -970,24 +1013,102 @@ public:
   }
 
 private:
-  void sort_events(void) {
-    for (size_t i = 0; i < events_.size() - 1;) {
-      if (needs_swap(events_[i], events_[i + 1])) {
-        std::swap(events_[i], events_[i + 1]);
-        if (i > 0) {
-          --i;
+  void emplace_back_pointing_motion_event(device_id device_id,
+                                          uint64_t time_stamp,
+                                          queued_event::event::type type,
+                                          int64_t integer_value) {
+    if (coalesce_pointing_motion_event(device_id, time_stamp, type, integer_value)) {
+      return;
+    }
+
+    queued_event::event event(type, integer_value);
+    emplace_back_event(device_id,
+                       time_stamp,
+                       event,
+                       event_type::single,
+                       event);
+  }
+
+  // Add `integer_value` into the last motion event of the same type if the following conditions are satisfied.
+  //
+  // * The event is sent from the same device within the window.
+  // * Only motion events exist after the event. (We never merge events across button or key transitions.)
+  // * The merged value fits into the signed 8 bit field of `hid_report::pointing_input`.
+  bool coalesce_pointing_motion_event(device_id device_id,
+                                      uint64_t time_stamp,
+                                      queued_event::event::type type,
+                                      int64_t integer_value) {
+    if (!pointing_motion_coalescing_window_) {
+      return false;
+    }
+
+    time_stamp += time_stamp_delay_;
+
+    for (size_t i = events_.size(); i > 0; --i) {
+      auto& e = events_[i - 1];
+
+      if (e.get_device_id() != device_id ||
+          e.get_lazy() ||
+          e.get_event_type() != event_type::single ||
+          !(e.get_event() == e.get_original_event()) ||
+          !is_pointing_motion_event(e.get_event()) ||
+          e.get_time_stamp() + *pointing_motion_coalescing_window_ < time_stamp) {
+        return false;
+      }
+
+      if (e.get_event().get_type() == type) {
+        if (auto v = e.get_event().get_integer_value()) {
+          auto value = *v + integer_value;
+          if (value < -127 || 127 < value) {
+            return false;
+          }
+
+          queued_event::event event(type, value);
+          e = queued_event(device_id,
+                           e.get_time_stamp(),
+                           event,
+                           event_type::single,
+                           event);
+          return true;
         }
-        continue;
+        return false;
+      }
+    }
+
+    return false;
+  }
+
+  static bool is_pointing_motion_event(const queued_event::event& event) {
+    switch (event.get_type()) {
+      case queued_event::event::type::pointing_x:
+      case queued_event::event::type::pointing_y:
+      case queued_event::event::type::pointing_vertical_wheel:
+      case queued_event::event::type::pointing_horizontal_wheel:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  void sort_events(void) {
+    // All events except the last one are already sorted.
+    // Thus, we only have to move the last event backward.
+    // (`needs_swap` returns false if time stamps are different.)
+
+    for (size_t i = events_.size() - 1; i > 0; --i) {
+      if (!needs_swap(events_[i - 1], events_[i])) {
+        break;
       }
-      ++i;
+      std::swap(events_[i - 1], events_[i]);
     }
   }
 
-  std::vector<queued_event> events_;
+  ring_buffer<queued_event> events_;
   modifier_flag_manager modifier_flag_manager_;
   pointing_button_manager pointing_button_manager_;
   manipulator_environment manipulator_environment_;
   uint64_t time_stamp_delay_;
+  boost::optional<uint64_t> pointing_motion_coalescing_window_;
 }; // namespace krbn
 
 // For unit tests
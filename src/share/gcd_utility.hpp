@@ -2,6 +2,7 @@
 
 #include "thread_utility.hpp"
 #include <dispatch/dispatch.h>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -38,6 +39,16 @@ public:
     }
   }
 
+  // Release `object` in main thread even if the caller is in another thread.
+  // (The block holds only a raw pointer in order not to leave the last reference in the caller.)
+  template <typename T>
+  static void release_in_main_queue(std::shared_ptr<T>&& object) {
+    auto p = new std::shared_ptr<T>(std::move(object));
+    dispatch_async(dispatch_get_main_queue(), ^{
+      delete p;
+    });
+  }
+
   class main_queue_timer final {
   public:
     main_queue_timer(dispatch_time_t start, uint64_t interval, uint64_t leeway, void (^_Nonnull block)(void)) {
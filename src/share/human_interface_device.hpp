@@ -553,6 +553,12 @@ public:
     });
   }
 
+  void set_pointing_motion_coalescing_window(const boost::optional<uint64_t>& value) {
+    gcd_utility::dispatch_sync_in_main_queue(^{
+      input_event_queue_.set_pointing_motion_coalescing_window(value);
+    });
+  }
+
   grabbable_state is_grabbable(void) {
     if (is_grabbable_callback_) {
       auto state = is_grabbable_callback_(*this);
@@ -14,7 +14,7 @@ public:
            event_type event_type) {
     switch (event_type) {
       case event_type::key_down:
-        if (types::make_modifier_flag(hid_usage_page, hid_usage) == boost::none) {
+        if (!types::find_key_code_attributes(hid_usage_page, hid_usage).is_modifier()) {
           repeating_key_ = std::make_pair(hid_usage_page, hid_usage);
         }
         break;
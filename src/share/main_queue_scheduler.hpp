@@ -0,0 +1,51 @@
+#pragma once
+
+#include "gcd_utility.hpp"
+#include "scheduler.hpp"
+#include <mach/mach_time.h>
+#include <mutex>
+
+namespace krbn {
+class main_queue_scheduler final : public scheduler {
+public:
+  class timer final : public scheduler::timer {
+  public:
+    timer(uint64_t when,
+          const std::function<void(void)>& function) {
+      // The block owns a copy of `function` since `function` may destroy this timer.
+      auto f = function;
+      timer_ = std::make_unique<gcd_utility::main_queue_after_timer>(when, ^{
+        f();
+      });
+    }
+
+    virtual bool fired(void) const {
+      return timer_->fired();
+    }
+
+  private:
+    std::unique_ptr<gcd_utility::main_queue_after_timer> timer_;
+  };
+
+  virtual uint64_t now(void) const {
+    return mach_absolute_time();
+  }
+
+  virtual std::unique_ptr<scheduler::timer> make_timer(uint64_t when,
+                                                       const std::function<void(void)>& function) {
+    return std::make_unique<timer>(when, function);
+  }
+
+  static std::shared_ptr<scheduler> get_instance(void) {
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> guard(mutex);
+
+    static std::shared_ptr<scheduler> instance;
+    if (!instance) {
+      instance = std::make_shared<main_queue_scheduler>();
+    }
+
+    return instance;
+  }
+};
+} // namespace krbn
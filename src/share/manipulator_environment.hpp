@@ -1,12 +1,20 @@
 #pragma once
 
-#include "filesystem.hpp"
+#include "async_json_file_writer.hpp"
 #include "logger.hpp"
 #include "types.hpp"
-#include <fstream>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <json/json.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/optional.hpp>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace krbn {
 class manipulator_environment final {
@@ -69,30 +77,105 @@ public:
              file_path_ == other.file_path_;
     }
 
+    // For boost::hash. Consistent with `operator==`.
+    friend size_t hash_value(const frontmost_application& value) {
+      size_t seed = 0;
+      boost::hash_combine(seed, value.bundle_identifier_);
+      boost::hash_combine(seed, value.file_path_);
+      return seed;
+    }
+
   private:
     std::string bundle_identifier_;
     std::string file_path_;
   };
 
+  // Variable names are interned into dense ids when manipulators are made
+  // in order to avoid hashing names in `set_variable` and `variable_if` while manipulating.
+  // Ids are shared by all manipulator_environment instances.
+  using variable_id = uint32_t;
+
+  static variable_id make_variable_id(const std::string& name) {
+    std::lock_guard<std::mutex> guard(get_variable_names_mutex());
+
+    auto& ids = get_variable_ids();
+    auto it = ids.find(name);
+    if (it != std::end(ids)) {
+      return it->second;
+    }
+
+    auto& names = get_variable_names();
+    auto id = static_cast<variable_id>(names.size());
+    names.push_back(name);
+    ids[name] = id;
+    return id;
+  }
+
+  // Returns boost::none if `name` is not interned yet. (`find_variable_id` does not intern `name`.)
+  static boost::optional<variable_id> find_variable_id(const std::string& name) {
+    std::lock_guard<std::mutex> guard(get_variable_names_mutex());
+
+    auto& ids = get_variable_ids();
+    auto it = ids.find(name);
+    if (it != std::end(ids)) {
+      return it->second;
+    }
+    return boost::none;
+  }
+
+  static std::string get_variable_name(variable_id id) {
+    std::lock_guard<std::mutex> guard(get_variable_names_mutex());
+
+    auto& names = get_variable_names();
+    if (id < names.size()) {
+      return names[id];
+    }
+    return "";
+  }
+
   manipulator_environment(const manipulator_environment&) = delete;
 
-  manipulator_environment(void) {
+  manipulator_environment(void) : generation_(make_generation()),
+                                  json_output_requested_(false) {
+  }
+
+  ~manipulator_environment(void) {
+    // Pending json is made from members in the writer thread.
+    // Thus, release json_file_writer_ before other members.
+    json_file_writer_ = nullptr;
   }
 
   nlohmann::json to_json(void) const {
-    return nlohmann::json({
-        {"frontmost_application", frontmost_application_.to_json()},
-        {"input_source_identifiers", input_source_identifiers_.to_json()},
-        {"variables", variables_},
-    });
+    return make_json(frontmost_application_,
+                     input_source_identifiers_,
+                     variables_);
   }
 
-  void enable_json_output(const std::string& output_json_file_path) {
-    output_json_file_path_ = output_json_file_path;
+  // `generation` is changed whenever frontmost_application, input_source_identifiers or variables are changed.
+  // Generations are unique across all manipulator_environment instances,
+  // so conditions can memoize their results with the generation.
+  uint64_t get_generation(void) const {
+    return generation_;
   }
 
+  // The json file is written in a background thread in order not to block the event pipeline.
+  // Changes within `interval` are coalesced. (See async_json_file_writer.)
+  void enable_json_output(const std::string& output_json_file_path,
+                          std::chrono::milliseconds interval = std::chrono::milliseconds(100)) {
+    json_file_writer_ = nullptr;
+    json_output_requested_ = false;
+    json_file_writer_ = std::make_unique<async_json_file_writer>(output_json_file_path, interval);
+  }
+
+  // Pending changes are written before `disable_json_output` returns.
   void disable_json_output(void) {
-    output_json_file_path_.clear();
+    json_file_writer_ = nullptr;
+    json_output_requested_ = false;
+  }
+
+  // nullptr if json output is disabled.
+  async_json_file_writer* get_json_file_writer(void) const {
+    return json_file_writer_.get();
   }
 
   const frontmost_application& get_frontmost_application(void) const {
@@ -100,7 +183,11 @@ public:
   }
 
   void set_frontmost_application(const frontmost_application& value) {
-    frontmost_application_ = value;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      frontmost_application_ = value;
+    }
+    generation_ = make_generation();
     save_to_file();
   }
 
@@ -109,42 +196,123 @@ public:
   }
 
   void set_input_source_identifiers(const input_source_identifiers& value) {
-    input_source_identifiers_ = value;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      input_source_identifiers_ = value;
+    }
+    generation_ = make_generation();
     save_to_file();
   }
 
+  int get_variable(variable_id id) const {
+    if (id < variables_.size() && variables_[id]) {
+      return *(variables_[id]);
+    }
+    return 0;
+  }
+
   int get_variable(const std::string& name) const {
-    auto it = variables_.find(name);
-    if (it != std::end(variables_)) {
-      return it->second;
+    if (auto id = find_variable_id(name)) {
+      return get_variable(*id);
     }
     return 0;
   }
 
-  void set_variable(const std::string& name, int value) {
-    // logger::get_logger().info("set_variable {0} {1}", name, value);
-    variables_[name] = value;
+  void set_variable(variable_id id, int value) {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (id >= variables_.size()) {
+        variables_.resize(id + 1);
+      }
+      variables_[id] = value;
+    }
+    generation_ = make_generation();
     save_to_file();
   }
 
+  void set_variable(const std::string& name, int value) {
+    set_variable(make_variable_id(name), value);
+  }
+
 private:
-  void save_to_file(void) const {
-    if (!output_json_file_path_.empty()) {
-      filesystem::create_directory_with_intermediate_directories(filesystem::dirname(output_json_file_path_), 0755);
+  static uint64_t make_generation(void) {
+    static std::atomic<uint64_t> generation(0);
+    return ++generation;
+  }
 
-      std::ofstream output(output_json_file_path_);
-      if (output) {
-        output << std::setw(4) << to_json() << std::endl;
-      } else {
-        logger::get_logger().warn("Failed to open {0}", output_json_file_path_);
+  static std::mutex& get_variable_names_mutex(void) {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static std::unordered_map<std::string, variable_id>& get_variable_ids(void) {
+    static std::unordered_map<std::string, variable_id> ids;
+    return ids;
+  }
+
+  static std::deque<std::string>& get_variable_names(void) {
+    static std::deque<std::string> names;
+    return names;
+  }
+
+  static nlohmann::json make_json(const frontmost_application& frontmost_application,
+                                  const input_source_identifiers& input_source_identifiers,
+                                  const std::vector<boost::optional<int>>& variables) {
+    auto variables_json = nlohmann::json::object();
+    {
+      std::lock_guard<std::mutex> guard(get_variable_names_mutex());
+
+      auto& names = get_variable_names();
+      for (variable_id id = 0; id < variables.size(); ++id) {
+        if (variables[id] && id < names.size()) {
+          variables_json[names[id]] = *(variables[id]);
+        }
       }
     }
+
+    return nlohmann::json({
+        {"frontmost_application", frontmost_application.to_json()},
+        {"input_source_identifiers", input_source_identifiers.to_json()},
+        {"variables", variables_json},
+    });
+  }
+
+  // Only mark that json output is requested in order not to copy the state for each change.
+  // The writer thread takes one snapshot of the state when the file is written (once per `interval`),
+  // and json is made and variable names are resolved in the writer thread.
+  void save_to_file(void) {
+    if (json_file_writer_ && !json_output_requested_.exchange(true)) {
+      json_file_writer_->async_save_with([this] {
+        // Changes after here request the next output.
+        json_output_requested_ = false;
+
+        frontmost_application frontmost_application;
+        input_source_identifiers input_source_identifiers;
+        std::vector<boost::optional<int>> variables;
+        {
+          std::lock_guard<std::mutex> guard(mutex_);
+          frontmost_application = frontmost_application_;
+          input_source_identifiers = input_source_identifiers_;
+          variables = variables_;
+        }
+
+        return make_json(frontmost_application,
+                         input_source_identifiers,
+                         variables);
+      });
+    }
   }
 
-  std::string output_json_file_path_;
+  uint64_t generation_;
+  std::unique_ptr<async_json_file_writer> json_file_writer_;
+  std::atomic<bool> json_output_requested_;
+  // Setters change the state with `mutex_` since the writer thread reads the state.
+  // (Getters are called in the same thread as setters, so they do not lock.)
+  std::mutex mutex_;
   frontmost_application frontmost_application_;
   input_source_identifiers input_source_identifiers_;
-  std::unordered_map<std::string, int> variables_;
+  // Indexed by variable_id. (boost::none if the variable is not set.)
+  std::vector<boost::optional<int>> variables_;
 };
 
 inline std::ostream& operator<<(std::ostream& stream, const manipulator_environment::frontmost_application& value) {
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "types.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
 #include <thread>
 #include <vector>
 
@@ -75,83 +78,167 @@ public:
     device_id device_id_;
   };
 
-  const std::vector<active_modifier_flag>& get_active_modifier_flags(void) const {
-    return active_modifier_flags_;
+  modifier_flag_manager(void) : pressed_bits_(0) {
+    counts_.fill(0);
+  }
+
+  // Rebuild the list of active flags from the counters.
+  // Paired increase and decrease are not included.
+  std::vector<active_modifier_flag> get_active_modifier_flags(void) const {
+    std::vector<active_modifier_flag> result;
+
+    for (const auto& d : device_counts_) {
+      for (size_t i = 0; i < flags_size; ++i) {
+        auto type = d.counts[i] > 0 ? active_modifier_flag::type::increase
+                                    : active_modifier_flag::type::decrease;
+        for (int n = 0; n < std::abs(d.counts[i]); ++n) {
+          result.emplace_back(type, modifier_flag(i), d.device_id);
+        }
+        for (int n = 0; n < d.lock_counts[i]; ++n) {
+          result.emplace_back(active_modifier_flag::type::increase_lock, modifier_flag(i), d.device_id);
+        }
+      }
+    }
+
+    return result;
   }
 
   void push_back_active_modifier_flag(const active_modifier_flag& flag) {
+    auto index = static_cast<size_t>(flag.get_modifier_flag());
+    if (index >= flags_size) {
+      return;
+    }
+
+    auto& d = find_or_create_device_counts(flag.get_device_id());
+
     switch (flag.get_type()) {
       case active_modifier_flag::type::increase:
       case active_modifier_flag::type::decrease:
+        d.counts[index] += flag.get_count();
+        counts_[index] += flag.get_count();
+        break;
+
       case active_modifier_flag::type::increase_lock:
-        active_modifier_flags_.push_back(flag);
-        erase_pairs();
+        ++(d.lock_counts[index]);
+        ++(counts_[index]);
         break;
 
       case active_modifier_flag::type::decrease_lock:
         // Remove all type::increase_lock
-        active_modifier_flags_.erase(std::remove_if(std::begin(active_modifier_flags_),
-                                                    std::end(active_modifier_flags_),
-                                                    [&](auto& f) {
-                                                      return f.is_paired(flag);
-                                                    }),
-                                     std::end(active_modifier_flags_));
+        counts_[index] -= d.lock_counts[index];
+        d.lock_counts[index] = 0;
         break;
     }
+
+    update_pressed_bit(index);
+    erase_empty_device_counts();
   }
 
   void erase_all_active_modifier_flags(device_id device_id) {
-    active_modifier_flags_.erase(std::remove_if(std::begin(active_modifier_flags_),
-                                                std::end(active_modifier_flags_),
-                                                [&](const active_modifier_flag& f) {
-                                                  return f.get_device_id() == device_id;
-                                                }),
-                                 std::end(active_modifier_flags_));
+    for (auto&& d : device_counts_) {
+      if (d.device_id == device_id) {
+        for (size_t i = 0; i < flags_size; ++i) {
+          counts_[i] -= d.counts[i] + d.lock_counts[i];
+          d.counts[i] = 0;
+          d.lock_counts[i] = 0;
+          update_pressed_bit(i);
+        }
+      }
+    }
+
+    erase_empty_device_counts();
   }
 
   void erase_all_active_modifier_flags_except_lock(device_id device_id) {
-    active_modifier_flags_.erase(std::remove_if(std::begin(active_modifier_flags_),
-                                                std::end(active_modifier_flags_),
-                                                [&](const active_modifier_flag& f) {
-                                                  return f.get_device_id() == device_id &&
-                                                         (f.get_type() != active_modifier_flag::type::increase_lock &&
-                                                          f.get_type() != active_modifier_flag::type::decrease_lock);
-                                                }),
-                                 std::end(active_modifier_flags_));
+    for (auto&& d : device_counts_) {
+      if (d.device_id == device_id) {
+        for (size_t i = 0; i < flags_size; ++i) {
+          counts_[i] -= d.counts[i];
+          d.counts[i] = 0;
+          update_pressed_bit(i);
+        }
+      }
+    }
+
+    erase_empty_device_counts();
   }
 
   void reset(void) {
-    active_modifier_flags_.clear();
+    device_counts_.clear();
+    counts_.fill(0);
+    pressed_bits_ = 0;
   }
 
   bool is_pressed(modifier_flag modifier_flag) const {
-    int count = 0;
-
-    for (const auto& f : active_modifier_flags_) {
-      if (f.get_modifier_flag() == modifier_flag) {
-        count += f.get_count();
-      }
-    }
+    return (pressed_bits_ & (1u << static_cast<uint32_t>(modifier_flag))) != 0;
+  }
 
-    return count > 0;
+  // `1 << modifier_flag` is set for each pressed modifier_flag.
+  uint32_t get_pressed_bits(void) const {
+    return pressed_bits_;
   }
 
 private:
-  void erase_pairs(void) {
-    for (size_t i1 = 0; i1 < active_modifier_flags_.size(); ++i1) {
-      for (size_t i2 = i1 + 1; i2 < active_modifier_flags_.size(); ++i2) {
-        if (active_modifier_flags_[i1].is_paired(active_modifier_flags_[i2])) {
-          active_modifier_flags_.erase(std::begin(active_modifier_flags_) + i2);
-          active_modifier_flags_.erase(std::begin(active_modifier_flags_) + i1);
-          if (i1 > 0) {
-            --i1;
-          }
-          break;
+  static constexpr size_t flags_size = static_cast<size_t>(modifier_flag::end_);
+
+  static_assert(flags_size <= 32, "modifier_flag must fit in pressed_bits_");
+
+  // `counts` holds the net count of increase and decrease.
+  // (A decrease cancels a preceding increase and vice versa.)
+  struct device_counts {
+    device_counts(krbn::device_id device_id) : device_id(device_id) {
+      counts.fill(0);
+      lock_counts.fill(0);
+    }
+
+    bool empty(void) const {
+      for (size_t i = 0; i < flags_size; ++i) {
+        if (counts[i] != 0 || lock_counts[i] != 0) {
+          return false;
         }
       }
+      return true;
+    }
+
+    krbn::device_id device_id;
+    std::array<int, flags_size> counts;
+    std::array<int, flags_size> lock_counts;
+  };
+
+  device_counts& find_or_create_device_counts(device_id device_id) {
+    for (auto&& d : device_counts_) {
+      if (d.device_id == device_id) {
+        return d;
+      }
+    }
+
+    device_counts_.emplace_back(device_id);
+    return device_counts_.back();
+  }
+
+  void erase_empty_device_counts(void) {
+    device_counts_.erase(std::remove_if(std::begin(device_counts_),
+                                        std::end(device_counts_),
+                                        [](const auto& d) {
+                                          return d.empty();
+                                        }),
+                         std::end(device_counts_));
+  }
+
+  void update_pressed_bit(size_t index) {
+    auto bit = 1u << index;
+    if (counts_[index] > 0) {
+      pressed_bits_ |= bit;
+    } else {
+      pressed_bits_ &= ~bit;
     }
   }
 
-  std::vector<active_modifier_flag> active_modifier_flags_;
+  // Counts per device.
+  std::vector<device_counts> device_counts_;
+
+  // Aggregated counts of all devices (including locks).
+  std::array<int, flags_size> counts_;
+  uint32_t pressed_bits_;
 };
 } // namespace krbn
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "types.hpp"
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <ostream>
+
+namespace krbn {
+// A fixed-capacity set of modifier_flag stored in a single bitmask.
+// It never allocates and iterates flags in ascending `modifier_flag` order.
+class modifier_flag_set final {
+public:
+  class const_iterator final {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = modifier_flag;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const modifier_flag*;
+    using reference = modifier_flag;
+
+    const_iterator(uint32_t bits) : bits_(bits) {
+    }
+
+    modifier_flag operator*(void) const {
+      return modifier_flag(__builtin_ctz(bits_));
+    }
+
+    const_iterator& operator++(void) {
+      bits_ &= (bits_ - 1);
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      auto result = *this;
+      ++(*this);
+      return result;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return bits_ == other.bits_;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+  private:
+    uint32_t bits_;
+  };
+
+  modifier_flag_set(void) : bits_(0) {
+  }
+
+  modifier_flag_set(std::initializer_list<modifier_flag> flags) : bits_(0) {
+    for (const auto& f : flags) {
+      insert(f);
+    }
+  }
+
+  static modifier_flag_set from_bits(uint32_t bits) {
+    modifier_flag_set s;
+    s.bits_ = bits & all_bits();
+    return s;
+  }
+
+  static modifier_flag_set all(void) {
+    return from_bits(all_bits());
+  }
+
+  uint32_t get_bits(void) const {
+    return bits_;
+  }
+
+  void insert(modifier_flag modifier_flag) {
+    bits_ |= to_bit(modifier_flag);
+  }
+
+  void insert(const modifier_flag_set& other) {
+    bits_ |= other.bits_;
+  }
+
+  void erase(modifier_flag modifier_flag) {
+    bits_ &= ~to_bit(modifier_flag);
+  }
+
+  void erase(const modifier_flag_set& other) {
+    bits_ &= ~other.bits_;
+  }
+
+  void clear(void) {
+    bits_ = 0;
+  }
+
+  bool contains(modifier_flag modifier_flag) const {
+    return (bits_ & to_bit(modifier_flag)) != 0;
+  }
+
+  bool empty(void) const {
+    return bits_ == 0;
+  }
+
+  size_t size(void) const {
+    return __builtin_popcount(bits_);
+  }
+
+  modifier_flag front(void) const {
+    if (bits_ == 0) {
+      return modifier_flag::zero;
+    }
+    return *begin();
+  }
+
+  const_iterator begin(void) const {
+    return const_iterator(bits_);
+  }
+
+  const_iterator end(void) const {
+    return const_iterator(0);
+  }
+
+  bool operator==(const modifier_flag_set& other) const {
+    return bits_ == other.bits_;
+  }
+
+  bool operator!=(const modifier_flag_set& other) const {
+    return !(*this == other);
+  }
+
+private:
+  static uint32_t to_bit(modifier_flag modifier_flag) {
+    // modifier_flag::zero is not a real modifier.
+    if (modifier_flag == modifier_flag::zero ||
+        modifier_flag == modifier_flag::end_) {
+      return 0;
+    }
+    return 1u << static_cast<uint32_t>(modifier_flag);
+  }
+
+  static uint32_t all_bits(void) {
+    return ((1u << static_cast<uint32_t>(modifier_flag::end_)) - 1) & ~1u;
+  }
+
+  uint32_t bits_;
+};
+
+static_assert(static_cast<uint32_t>(modifier_flag::end_) <= 32, "modifier_flag_set requires modifier_flag to fit in uint32_t");
+
+inline std::ostream& operator<<(std::ostream& stream, const modifier_flag_set& values) {
+  bool first = true;
+  stream << "[";
+  for (const auto& v : values) {
+    if (first) {
+      first = false;
+    } else {
+      stream << ",";
+    }
+    stream << v;
+  }
+  stream << "]";
+  return stream;
+}
+} // namespace krbn
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace krbn {
+template <typename T>
+struct name_value_pair final {
+  const char* name;
+  T value;
+};
+
+// The power of two which is greater than or equal to `n * 2`.
+constexpr size_t make_name_table_slot_count(size_t n) {
+  size_t count = 2;
+  while (count < n * 2) {
+    count *= 2;
+  }
+  return count;
+}
+
+// A bidirectional table between names and enum values which is built at compile time.
+//
+// * value -> name: A dense array indexed by the value.
+//   Values in [0, DenseSize) and [ExtraBase, ExtraBase + ExtraSize) are supported.
+//   The first pair wins if several names have the same value.
+// * name -> value: A perfect hash (hash and displace).
+//   Each bucket has a seed which maps the names in the bucket into unique slots.
+//
+// Lookups neither lock nor allocate.
+// `valid` returns false if the table cannot be built (duplicated names or out of range values).
+template <typename T, size_t N, uint32_t DenseSize, uint32_t ExtraBase, uint32_t ExtraSize>
+class name_table final {
+public:
+  constexpr name_table(const name_value_pair<T> (&pairs)[N]) : names_{},
+                                                              lengths_{},
+                                                              values_{},
+                                                              dense_{},
+                                                              seeds_{},
+                                                              slots_{},
+                                                              valid_(true) {
+    for (size_t i = 0; i < N; ++i) {
+      names_[i] = pairs[i].name;
+      lengths_[i] = length(pairs[i].name);
+      values_[i] = pairs[i].value;
+    }
+
+    build_dense();
+    build_perfect_hash();
+  }
+
+  constexpr bool valid(void) const {
+    return valid_;
+  }
+
+  constexpr size_t size(void) const {
+    return N;
+  }
+
+  constexpr const char* get_name(size_t index) const {
+    return names_[index];
+  }
+
+  constexpr T get_value(size_t index) const {
+    return values_[index];
+  }
+
+  // Returns nullptr if `name` is not found.
+  constexpr const T* find_value(const char* name, size_t name_length) const {
+    auto b = hash(name, name_length, 0) & (bucket_count - 1);
+    auto s = hash(name, name_length, seeds_[b]) & (slot_count - 1);
+    auto i = slots_[s];
+    if (i >= 0 && equal(names_[i], lengths_[i], name, name_length)) {
+      return &(values_[i]);
+    }
+    return nullptr;
+  }
+
+  constexpr const T* find_value(const char* name) const {
+    return find_value(name, length(name));
+  }
+
+  // Returns nullptr if `value` is not found.
+  constexpr const char* find_name(T value) const {
+    auto d = dense_index(value);
+    if (d >= 0 && dense_[d] > 0) {
+      return names_[dense_[d] - 1];
+    }
+    return nullptr;
+  }
+
+  // Checks all names and values round-trip. (for static_assert)
+  constexpr bool verify(void) const {
+    if (!valid_) {
+      return false;
+    }
+
+    for (size_t i = 0; i < N; ++i) {
+      auto v = find_value(names_[i], lengths_[i]);
+      if (!v || *v != values_[i]) {
+        return false;
+      }
+
+      auto n = find_name(values_[i]);
+      if (!n) {
+        return false;
+      }
+      v = find_value(n);
+      if (!v || *v != values_[i]) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+private:
+  static constexpr size_t slot_count = make_name_table_slot_count(N);
+  static constexpr size_t bucket_count = (slot_count / 4 > 0 ? slot_count / 4 : 1);
+  static constexpr uint32_t max_seed = 1 << 16;
+
+  static constexpr size_t length(const char* s) {
+    size_t l = 0;
+    while (s[l] != '\0') {
+      ++l;
+    }
+    return l;
+  }
+
+  static constexpr bool equal(const char* s1, size_t length1, const char* s2, size_t length2) {
+    if (length1 != length2) {
+      return false;
+    }
+    for (size_t i = 0; i < length1; ++i) {
+      if (s1[i] != s2[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // FNV-1a with the murmur3 finalizer.
+  static constexpr uint32_t hash(const char* s, size_t l, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < l; ++i) {
+      h ^= static_cast<uint8_t>(s[i]);
+      h *= 16777619u;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+  }
+
+  static constexpr int dense_index(T value) {
+    auto v = static_cast<uint32_t>(value);
+    if (v < DenseSize) {
+      return static_cast<int>(v);
+    }
+    if (ExtraBase <= v && v - ExtraBase < ExtraSize) {
+      return static_cast<int>(DenseSize + (v - ExtraBase));
+    }
+    return -1;
+  }
+
+  constexpr void build_dense(void) {
+    for (size_t i = 0; i < N; ++i) {
+      auto d = dense_index(values_[i]);
+      if (d < 0) {
+        valid_ = false;
+        return;
+      }
+      // `dense_` holds index + 1 (0 means empty).
+      if (dense_[d] == 0) {
+        dense_[d] = static_cast<int16_t>(i + 1);
+      }
+    }
+  }
+
+  constexpr void build_perfect_hash(void) {
+    for (size_t s = 0; s < slot_count; ++s) {
+      slots_[s] = -1;
+    }
+
+    // Sort names by bucket. (counting sort)
+
+    size_t buckets[N] = {};
+    size_t bucket_sizes[bucket_count] = {};
+    for (size_t i = 0; i < N; ++i) {
+      buckets[i] = hash(names_[i], lengths_[i], 0) & (bucket_count - 1);
+      ++bucket_sizes[buckets[i]];
+    }
+
+    size_t bucket_starts[bucket_count + 1] = {};
+    for (size_t b = 0; b < bucket_count; ++b) {
+      bucket_starts[b + 1] = bucket_starts[b] + bucket_sizes[b];
+    }
+
+    size_t sorted[N] = {};
+    size_t positions[bucket_count] = {};
+    for (size_t i = 0; i < N; ++i) {
+      auto b = buckets[i];
+      sorted[bucket_starts[b] + positions[b]] = i;
+      ++positions[b];
+    }
+
+    size_t max_bucket_size = 0;
+    for (size_t b = 0; b < bucket_count; ++b) {
+      if (max_bucket_size < bucket_sizes[b]) {
+        max_bucket_size = bucket_sizes[b];
+      }
+    }
+
+    // Place larger buckets first.
+
+    size_t trial_slots[N] = {};
+    for (size_t size = max_bucket_size; size > 0; --size) {
+      for (size_t b = 0; b < bucket_count; ++b) {
+        if (bucket_sizes[b] != size) {
+          continue;
+        }
+
+        bool placed = false;
+        for (uint32_t seed = 1; seed < max_seed && !placed; ++seed) {
+          placed = true;
+          for (size_t j = 0; j < size && placed; ++j) {
+            auto i = sorted[bucket_starts[b] + j];
+            auto s = hash(names_[i], lengths_[i], seed) & (slot_count - 1);
+            if (slots_[s] >= 0) {
+              placed = false;
+            }
+            for (size_t k = 0; k < j; ++k) {
+              if (trial_slots[k] == s) {
+                placed = false;
+              }
+            }
+            trial_slots[j] = s;
+          }
+
+          if (placed) {
+            seeds_[b] = seed;
+            for (size_t j = 0; j < size; ++j) {
+              slots_[trial_slots[j]] = static_cast<int16_t>(sorted[bucket_starts[b] + j]);
+            }
+          }
+        }
+
+        if (!placed) {
+          valid_ = false;
+          return;
+        }
+      }
+    }
+  }
+
+  const char* names_[N];
+  size_t lengths_[N];
+  T values_[N];
+  int16_t dense_[DenseSize + ExtraSize];
+  uint32_t seeds_[bucket_count];
+  int16_t slots_[slot_count];
+  bool valid_;
+};
+
+template <uint32_t DenseSize, uint32_t ExtraBase = 0, uint32_t ExtraSize = 0, typename T, size_t N>
+constexpr name_table<T, N, DenseSize, ExtraBase, ExtraSize> make_name_table(const name_value_pair<T> (&pairs)[N]) {
+  return name_table<T, N, DenseSize, ExtraBase, ExtraSize>(pairs);
+}
+} // namespace krbn
@@ -0,0 +1,267 @@
+#pragma once
+
+#include "logger.hpp"
+#include <boost/optional.hpp>
+#include <cctype>
+#include <iterator>
+#include <regex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace krbn {
+// A set of ECMAScript regex patterns which is tested by `regex_search` semantics (true if any pattern matches).
+//
+// Most patterns in complex_modifications are plain literals such as `^com\.apple\.Terminal$`.
+// They are served without std::regex:
+//
+//   ^literal$ -> a hash set of exact strings
+//   ^literal  -> a prefix trie
+//   literal$  -> a suffix trie
+//   literal   -> substring search
+//
+// The remaining patterns are compiled into a single alternation regex.
+// (Patterns which contain backreferences are compiled separately since the alternation renumbers groups.)
+class regex_set final {
+public:
+  regex_set(void) : size_(0) {
+  }
+
+  regex_set(const std::vector<std::string>& patterns) : size_(0) {
+    std::vector<std::string> regex_patterns;
+
+    for (const auto& p : patterns) {
+      if (!add_literal_pattern(p)) {
+        regex_patterns.push_back(p);
+      }
+    }
+
+    update_regexes(regex_patterns);
+  }
+
+  // The number of valid patterns.
+  size_t size(void) const {
+    return size_;
+  }
+
+  bool empty(void) const {
+    return size_ == 0;
+  }
+
+  bool search(const std::string& string) const {
+    if (exact_strings_.find(string) != std::end(exact_strings_)) {
+      return true;
+    }
+
+    if (prefixes_.match(std::begin(string), std::end(string))) {
+      return true;
+    }
+
+    if (suffixes_.match(std::rbegin(string), std::rend(string))) {
+      return true;
+    }
+
+    for (const auto& s : substrings_) {
+      if (string.find(s) != std::string::npos) {
+        return true;
+      }
+    }
+
+    for (const auto& r : regexes_) {
+      if (regex_search(std::begin(string),
+                       std::end(string),
+                       r)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+private:
+  class trie final {
+  public:
+    trie(void) : nodes_(1) {
+    }
+
+    template <typename T>
+    void insert(T first, T last) {
+      size_t index = 0;
+      for (auto it = first; it != last; std::advance(it, 1)) {
+        auto child = find_child(index, *it);
+        if (!child) {
+          child = nodes_.size();
+          nodes_[index].children.emplace_back(*it, *child);
+          nodes_.emplace_back();
+        }
+        index = *child;
+      }
+      nodes_[index].terminal = true;
+    }
+
+    // Returns true if any inserted string is a prefix of [first, last).
+    template <typename T>
+    bool match(T first, T last) const {
+      size_t index = 0;
+      for (auto it = first;; std::advance(it, 1)) {
+        if (nodes_[index].terminal) {
+          return true;
+        }
+        if (it == last) {
+          return false;
+        }
+        auto child = find_child(index, *it);
+        if (!child) {
+          return false;
+        }
+        index = *child;
+      }
+    }
+
+  private:
+    struct node final {
+      node(void) : terminal(false) {
+      }
+
+      std::vector<std::pair<char, size_t>> children;
+      bool terminal;
+    };
+
+    boost::optional<size_t> find_child(size_t index, char c) const {
+      for (const auto& pair : nodes_[index].children) {
+        if (pair.first == c) {
+          return pair.second;
+        }
+      }
+      return boost::none;
+    }
+
+    std::vector<node> nodes_;
+  };
+
+  bool add_literal_pattern(const std::string& pattern) {
+    auto first = std::begin(pattern);
+    auto last = std::end(pattern);
+
+    bool begin_anchor = false;
+    if (first != last && *first == '^') {
+      begin_anchor = true;
+      std::advance(first, 1);
+    }
+
+    std::string literal;
+    bool end_anchor = false;
+
+    for (auto it = first; it != last; std::advance(it, 1)) {
+      switch (*it) {
+        case '$':
+          if (std::next(it) != last) {
+            return false;
+          }
+          end_anchor = true;
+          break;
+
+        case '\\': {
+          // Escaped punctuation (e.g. `\.`) is a literal.
+          // Other escapes (`\d`, `\b`, `\1`, ...) are regex.
+          std::advance(it, 1);
+          if (it == last || std::isalnum(static_cast<unsigned char>(*it))) {
+            return false;
+          }
+          literal += *it;
+          break;
+        }
+
+        case '^':
+        case '.':
+        case '*':
+        case '+':
+        case '?':
+        case '(':
+        case ')':
+        case '[':
+        case ']':
+        case '{':
+        case '}':
+        case '|':
+          return false;
+
+        default:
+          literal += *it;
+          break;
+      }
+    }
+
+    if (begin_anchor && end_anchor) {
+      exact_strings_.insert(literal);
+    } else if (begin_anchor) {
+      prefixes_.insert(std::begin(literal), std::end(literal));
+    } else if (end_anchor) {
+      suffixes_.insert(std::rbegin(literal), std::rend(literal));
+    } else {
+      substrings_.push_back(literal);
+    }
+
+    ++size_;
+    return true;
+  }
+
+  void update_regexes(const std::vector<std::string>& patterns) {
+    std::vector<std::string> combinable_patterns;
+
+    for (const auto& p : patterns) {
+      try {
+        std::regex r(p);
+        ++size_;
+
+        if (has_backreference(p)) {
+          regexes_.push_back(r);
+        } else {
+          combinable_patterns.push_back(p);
+        }
+      } catch (std::exception& e) {
+        logger::get_logger().error("complex_modifications json error: Regex error: \"{0}\" {1}", p, e.what());
+      }
+    }
+
+    if (!combinable_patterns.empty()) {
+      regexes_.emplace_back(make_alternation(combinable_patterns));
+    }
+  }
+
+  static bool has_backreference(const std::string& pattern) {
+    for (size_t i = 0; i + 1 < pattern.size(); ++i) {
+      if (pattern[i] == '\\') {
+        if ('1' <= pattern[i + 1] && pattern[i + 1] <= '9') {
+          return true;
+        }
+        ++i;
+      }
+    }
+    return false;
+  }
+
+  static std::string make_alternation(const std::vector<std::string>& patterns) {
+    if (patterns.size() == 1) {
+      return patterns.front();
+    }
+
+    std::string result;
+    for (const auto& p : patterns) {
+      if (!result.empty()) {
+        result += '|';
+      }
+      result += "(?:" + p + ")";
+    }
+    return result;
+  }
+
+  std::unordered_set<std::string> exact_strings_;
+  trie prefixes_;
+  trie suffixes_;
+  std::vector<std::string> substrings_;
+  std::vector<std::regex> regexes_;
+  size_t size_;
+};
+} // namespace krbn
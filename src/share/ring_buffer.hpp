@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace krbn {
+// A growable FIFO with O(1) `pop_front`.
+//
+// Elements are stored in a power-of-two sized circular buffer.
+// References to elements stay valid across `pop_front` and `emplace_back` as long as the capacity is not exceeded,
+// and `clear` keeps the allocated storage so that a drained queue never reallocates in steady state.
+template <typename T>
+class ring_buffer final {
+public:
+  template <bool is_const>
+  class iterator_base final {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = typename std::conditional<is_const, const T*, T*>::type;
+    using reference = typename std::conditional<is_const, const T&, T&>::type;
+    using container = typename std::conditional<is_const, const ring_buffer, ring_buffer>::type;
+
+    iterator_base(void) : ring_buffer_(nullptr),
+                          index_(0) {
+    }
+
+    iterator_base(container* ring_buffer,
+                  size_t index) : ring_buffer_(ring_buffer),
+                                  index_(index) {
+    }
+
+    reference operator*(void) const {
+      return (*ring_buffer_)[index_];
+    }
+
+    pointer operator->(void) const {
+      return &((*ring_buffer_)[index_]);
+    }
+
+    iterator_base& operator++(void) {
+      ++index_;
+      return *this;
+    }
+
+    iterator_base operator++(int) {
+      auto result = *this;
+      ++index_;
+      return result;
+    }
+
+    bool operator==(const iterator_base& other) const {
+      return ring_buffer_ == other.ring_buffer_ &&
+             index_ == other.index_;
+    }
+
+    bool operator!=(const iterator_base& other) const {
+      return !(*this == other);
+    }
+
+  private:
+    container* ring_buffer_;
+    size_t index_;
+  };
+
+  using value_type = T;
+  using iterator = iterator_base<false>;
+  using const_iterator = iterator_base<true>;
+
+  ring_buffer(void) : head_(0),
+                      size_(0),
+                      capacity_(0) {
+  }
+
+  explicit ring_buffer(size_t capacity) : ring_buffer() {
+    reserve(capacity);
+  }
+
+  ring_buffer(const ring_buffer& other) : ring_buffer(other.capacity_) {
+    for (const auto& v : other) {
+      emplace_back(v);
+    }
+  }
+
+  ring_buffer& operator=(const ring_buffer& other) {
+    if (this != &other) {
+      clear();
+      reserve(other.size_);
+      for (const auto& v : other) {
+        emplace_back(v);
+      }
+    }
+    return *this;
+  }
+
+  ~ring_buffer(void) {
+    clear();
+  }
+
+  size_t size(void) const {
+    return size_;
+  }
+
+  bool empty(void) const {
+    return size_ == 0;
+  }
+
+  size_t capacity(void) const {
+    return capacity_;
+  }
+
+  void reserve(size_t capacity) {
+    if (capacity <= capacity_) {
+      return;
+    }
+
+    size_t new_capacity = capacity_ > 0 ? capacity_ : 1;
+    while (new_capacity < capacity) {
+      new_capacity *= 2;
+    }
+
+    std::unique_ptr<storage[]> new_storage(new storage[new_capacity]);
+    for (size_t i = 0; i < size_; ++i) {
+      auto& v = (*this)[i];
+      new (&new_storage[i]) T(std::move(v));
+      v.~T();
+    }
+
+    storage_ = std::move(new_storage);
+    head_ = 0;
+    capacity_ = new_capacity;
+  }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    if (size_ == capacity_) {
+      reserve(capacity_ > 0 ? capacity_ * 2 : 16);
+    }
+
+    new (&storage_[physical_index(size_)]) T(std::forward<Args>(args)...);
+    ++size_;
+  }
+
+  void push_back(const T& value) {
+    emplace_back(value);
+  }
+
+  void pop_front(void) {
+    front().~T();
+    head_ = physical_index(1);
+    --size_;
+
+    if (size_ == 0) {
+      head_ = 0;
+    }
+  }
+
+  void clear(void) {
+    while (!empty()) {
+      pop_front();
+    }
+  }
+
+  T& front(void) {
+    return (*this)[0];
+  }
+
+  const T& front(void) const {
+    return (*this)[0];
+  }
+
+  T& back(void) {
+    return (*this)[size_ - 1];
+  }
+
+  const T& back(void) const {
+    return (*this)[size_ - 1];
+  }
+
+  T& operator[](size_t index) {
+    return *reinterpret_cast<T*>(&storage_[physical_index(index)]);
+  }
+
+  const T& operator[](size_t index) const {
+    return *reinterpret_cast<const T*>(&storage_[physical_index(index)]);
+  }
+
+  iterator begin(void) {
+    return iterator(this, 0);
+  }
+
+  iterator end(void) {
+    return iterator(this, size_);
+  }
+
+  const_iterator begin(void) const {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator end(void) const {
+    return const_iterator(this, size_);
+  }
+
+  bool operator==(const ring_buffer& other) const {
+    return size_ == other.size_ &&
+           std::equal(begin(), end(), other.begin());
+  }
+
+  bool operator==(const std::vector<T>& other) const {
+    return size_ == other.size() &&
+           std::equal(begin(), end(), std::begin(other));
+  }
+
+private:
+  using storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+  size_t physical_index(size_t index) const {
+    // capacity_ is always a power of two.
+    return (head_ + index) & (capacity_ - 1);
+  }
+
+  std::unique_ptr<storage[]> storage_;
+  size_t head_;
+  size_t size_;
+  size_t capacity_;
+};
+} // namespace krbn
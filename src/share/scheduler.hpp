@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace krbn {
+// A clock and one-shot timers.
+//
+// Time is in mach absolute time units (the same as event time stamps).
+// `main_queue_scheduler` uses mach_absolute_time and the main dispatch queue.
+// `simulated_scheduler` advances time manually for tests and benchmarks.
+class scheduler {
+public:
+  class timer {
+  public:
+    // The timer function is not called after the timer is destroyed.
+    virtual ~timer(void) {
+    }
+
+    virtual bool fired(void) const = 0;
+  };
+
+  virtual ~scheduler(void) {
+  }
+
+  virtual uint64_t now(void) const = 0;
+
+  virtual std::unique_ptr<timer> make_timer(uint64_t when,
+                                            const std::function<void(void)>& function) = 0;
+};
+} // namespace krbn
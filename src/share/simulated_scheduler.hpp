@@ -0,0 +1,122 @@
+#pragma once
+
+#include "scheduler.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace krbn {
+// A scheduler whose time advances only by `advance_to`.
+// Due timers are invoked synchronously in `when` order (creation order for the same `when`).
+class simulated_scheduler final : public scheduler {
+public:
+  simulated_scheduler(uint64_t now = 0) : now_(now),
+                                          sequence_(0) {
+  }
+
+  virtual uint64_t now(void) const {
+    return now_;
+  }
+
+  virtual std::unique_ptr<scheduler::timer> make_timer(uint64_t when,
+                                                       const std::function<void(void)>& function) {
+    auto s = std::make_shared<state>(when, sequence_++, function);
+    states_.push_back(s);
+    return std::make_unique<timer>(s);
+  }
+
+  void advance_to(uint64_t when) {
+    for (;;) {
+      auto s = find_next_state(when);
+      if (!s) {
+        break;
+      }
+
+      if (now_ < s->when) {
+        now_ = s->when;
+      }
+      s->fired = true;
+      s->function();
+    }
+
+    if (now_ < when) {
+      now_ = when;
+    }
+  }
+
+  void advance_by(uint64_t duration) {
+    advance_to(now_ + duration);
+  }
+
+  // The number of timers which are neither fired nor destroyed.
+  size_t get_pending_timer_count(void) const {
+    size_t count = 0;
+    for (const auto& s : states_) {
+      if (!s->fired && !s->canceled) {
+        ++count;
+      }
+    }
+    return count;
+  }
+
+private:
+  struct state final {
+    state(uint64_t when,
+          uint64_t sequence,
+          const std::function<void(void)>& function) : when(when),
+                                                       sequence(sequence),
+                                                       function(function),
+                                                       fired(false),
+                                                       canceled(false) {
+    }
+
+    uint64_t when;
+    uint64_t sequence;
+    std::function<void(void)> function;
+    bool fired;
+    bool canceled;
+  };
+
+  class timer final : public scheduler::timer {
+  public:
+    timer(const std::shared_ptr<state>& state) : state_(state) {
+    }
+
+    virtual ~timer(void) {
+      state_->canceled = true;
+    }
+
+    virtual bool fired(void) const {
+      return state_->fired;
+    }
+
+  private:
+    std::shared_ptr<state> state_;
+  };
+
+  std::shared_ptr<state> find_next_state(uint64_t when) {
+    // Drop fired or canceled timers.
+    states_.erase(std::remove_if(std::begin(states_),
+                                 std::end(states_),
+                                 [](auto& s) {
+                                   return s->fired || s->canceled;
+                                 }),
+                  std::end(states_));
+
+    std::shared_ptr<state> result;
+    for (const auto& s : states_) {
+      if (s->when <= when) {
+        if (!result ||
+            s->when < result->when ||
+            (s->when == result->when && s->sequence < result->sequence)) {
+          result = s;
+        }
+      }
+    }
+    return result;
+  }
+
+  uint64_t now_;
+  uint64_t sequence_;
+  std::vector<std::shared_ptr<state>> states_;
+};
+} // namespace krbn
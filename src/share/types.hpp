@@ -7,6 +7,8 @@
 #include "constants.hpp"
 #include "input_source_utility.hpp"
 #include "logger.hpp"
+#include "name_table.hpp"
+#include "regex_set.hpp"
 #include "stream_utility.hpp"
 #include "system_preferences.hpp"
 #include <CoreFoundation/CoreFoundation.h>
@@ -14,10 +16,14 @@
 #include <IOKit/hid/IOHIDUsageTables.h>
 #include <IOKit/hidsystem/IOHIDShared.h>
 #include <IOKit/hidsystem/ev_keymap.h>
+#include <array>
+#include <atomic>
+#include <boost/functional/hash.hpp>
 #include <boost/optional.hpp>
 #include <cstring>
 #include <iostream>
 #include <json/json.hpp>
+#include <mutex>
 #include <regex>
 #include <string>
 #include <thread>
@@ -434,6 +440,141 @@ private:
   bool is_pointing_device_;
 };
 
+// A registry of device_identifiers of attached devices.
+//
+// Readers (`find`) are wait-free and do not lock.
+// Writers (`attach`, `detach`) are serialized by a mutex and take bounded time.
+//
+// Devices are stored in a fixed array indexed by `device_id % slot_count`.
+// `attach` skips device ids whose slot is in use, so device ids are still unique and increasing.
+// Each slot has a stamp (the device_id in the slot) which is checked before and after reading (seqlock).
+// A reader which races with `detach` gets boost::none instead of retrying.
+class device_identifiers_registry final {
+public:
+  device_identifiers_registry(const device_identifiers_registry&) = delete;
+
+  device_identifiers_registry(void) : last_device_id_(0),
+                                      size_(0) {
+  }
+
+  device_id attach(vendor_id vendor_id,
+                   product_id product_id,
+                   bool is_keyboard,
+                   bool is_pointing_device) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (size_ >= slot_count) {
+      // Return an unique device_id which does not have device_identifiers.
+      logger::get_logger().error("device_identifiers_registry is full");
+      return next_device_id();
+    }
+
+    for (;;) {
+      auto id = next_device_id();
+      auto& s = slots_[slot_index(id)];
+      if (s.stamp.load(std::memory_order_relaxed) != 0) {
+        continue;
+      }
+
+      s.vendor_id.store(static_cast<uint32_t>(vendor_id), std::memory_order_relaxed);
+      s.product_id.store(static_cast<uint32_t>(product_id), std::memory_order_relaxed);
+      s.is_keyboard.store(is_keyboard, std::memory_order_relaxed);
+      s.is_pointing_device.store(is_pointing_device, std::memory_order_relaxed);
+      s.stamp.store(static_cast<uint32_t>(id), std::memory_order_release);
+
+      ++size_;
+      return id;
+    }
+  }
+
+  void detach(device_id device_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto id = static_cast<uint32_t>(device_id);
+    if (id == 0) {
+      return;
+    }
+
+    auto& s = slots_[slot_index(device_id)];
+    if (s.stamp.load(std::memory_order_relaxed) == id) {
+      s.stamp.store(0, std::memory_order_relaxed);
+      // The next `attach` writes the slot after the stamp is cleared.
+      std::atomic_thread_fence(std::memory_order_release);
+
+      --size_;
+    }
+  }
+
+  boost::optional<device_identifiers> find(device_id device_id) const {
+    auto id = static_cast<uint32_t>(device_id);
+    if (id == 0) {
+      return boost::none;
+    }
+
+    const auto& s = slots_[slot_index(device_id)];
+    if (s.stamp.load(std::memory_order_acquire) != id) {
+      return boost::none;
+    }
+
+    device_identifiers result(krbn::vendor_id(s.vendor_id.load(std::memory_order_relaxed)),
+                              krbn::product_id(s.product_id.load(std::memory_order_relaxed)),
+                              s.is_keyboard.load(std::memory_order_relaxed),
+                              s.is_pointing_device.load(std::memory_order_relaxed));
+
+    // The slot might be reused while reading.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s.stamp.load(std::memory_order_relaxed) != id) {
+      return boost::none;
+    }
+
+    return result;
+  }
+
+  size_t size(void) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return size_;
+  }
+
+private:
+  // The maximum number of attached devices.
+  static constexpr size_t slot_count = 1024;
+
+  struct slot final {
+    slot(void) : stamp(0),
+                 vendor_id(0),
+                 product_id(0),
+                 is_keyboard(false),
+                 is_pointing_device(false) {
+    }
+
+    // The device_id in this slot. (0 if empty)
+    std::atomic<uint32_t> stamp;
+    std::atomic<uint32_t> vendor_id;
+    std::atomic<uint32_t> product_id;
+    std::atomic<bool> is_keyboard;
+    std::atomic<bool> is_pointing_device;
+  };
+
+  static size_t slot_index(device_id device_id) {
+    return static_cast<uint32_t>(device_id) % slot_count;
+  }
+
+  device_id next_device_id(void) {
+    ++last_device_id_;
+    // device_id::zero is not used.
+    if (last_device_id_ == 0) {
+      ++last_device_id_;
+    }
+    return device_id(last_device_id_);
+  }
+
+  mutable std::mutex mutex_;
+  uint32_t last_device_id_;
+  size_t size_;
+  std::array<slot, slot_count> slots_;
+};
+
 class input_source_identifiers final {
 public:
   input_source_identifiers(void) {
@@ -521,6 +662,15 @@ public:
            input_mode_id_ == other.input_mode_id_;
   }
 
+  // For boost::hash. Consistent with `operator==`.
+  friend size_t hash_value(const input_source_identifiers& value) {
+    size_t seed = 0;
+    boost::hash_combine(seed, value.language_.get_value_or(""));
+    boost::hash_combine(seed, value.input_source_id_.get_value_or(""));
+    boost::hash_combine(seed, value.input_mode_id_.get_value_or(""));
+    return seed;
+  }
+
 private:
   boost::optional<std::string> language_;
   boost::optional<std::string> input_source_id_;
@@ -606,9 +756,7 @@ public:
   bool test(const input_source_identifiers& input_source_identifiers) const {
     if (language_regex_) {
       if (auto& v = input_source_identifiers.get_language()) {
-        if (!regex_search(std::begin(*v),
-                          std::end(*v),
-                          *language_regex_)) {
+        if (!language_regex_->search(*v)) {
           return false;
         }
       } else {
@@ -618,9 +766,7 @@ public:
 
     if (input_source_id_regex_) {
       if (auto& v = input_source_identifiers.get_input_source_id()) {
-        if (!regex_search(std::begin(*v),
-                          std::end(*v),
-                          *input_source_id_regex_)) {
+        if (!input_source_id_regex_->search(*v)) {
           return false;
         }
       } else {
@@ -630,9 +776,7 @@ public:
 
     if (input_mode_id_regex_) {
       if (auto& v = input_source_identifiers.get_input_mode_id()) {
-        if (!regex_search(std::begin(*v),
-                          std::end(*v),
-                          *input_mode_id_regex_)) {
+        if (!input_mode_id_regex_->search(*v)) {
           return false;
         }
       } else {
@@ -649,37 +793,304 @@ public:
            input_mode_id_string_ == other.input_mode_id_string_;
   }
 
+  // For boost::hash. Consistent with `operator==`.
+  friend size_t hash_value(const input_source_selector& value) {
+    size_t seed = 0;
+    boost::hash_combine(seed, value.language_string_.get_value_or(""));
+    boost::hash_combine(seed, value.input_source_id_string_.get_value_or(""));
+    boost::hash_combine(seed, value.input_mode_id_string_.get_value_or(""));
+    return seed;
+  }
+
 private:
   void update_regexs(void) {
-    std::string s;
+    language_regex_ = make_regex(language_string_);
+    input_source_id_regex_ = make_regex(input_source_id_string_);
+    input_mode_id_regex_ = make_regex(input_mode_id_string_);
+  }
+
+  static boost::optional<regex_set> make_regex(const boost::optional<std::string>& string) {
+    if (string) {
+      regex_set r({*string});
+      if (!r.empty()) {
+        return r;
+      }
+    }
+    return boost::none;
+  }
+
+  boost::optional<std::string> language_string_;
+  boost::optional<std::string> input_source_id_string_;
+  boost::optional<std::string> input_mode_id_string_;
+
+  boost::optional<regex_set> language_regex_;
+  boost::optional<regex_set> input_source_id_regex_;
+  boost::optional<regex_set> input_mode_id_regex_;
+};
+
+// Attributes of key_code which are used for each event.
+class key_code_attributes final {
+public:
+  constexpr key_code_attributes(void) : key_code_(key_code::vk_none),
+                                        hid_usage_page_(hid_usage_page::zero),
+                                        hid_usage_(hid_usage::zero),
+                                        modifier_flag_(modifier_flag::zero) {
+  }
 
-    try {
-      if (language_string_) {
-        s = *language_string_;
-        language_regex_ = std::regex(s);
+  constexpr key_code_attributes(key_code key_code,
+                                hid_usage_page hid_usage_page,
+                                hid_usage hid_usage,
+                                modifier_flag modifier_flag) : key_code_(key_code),
+                                                               hid_usage_page_(hid_usage_page),
+                                                               hid_usage_(hid_usage),
+                                                               modifier_flag_(modifier_flag) {
+  }
+
+  constexpr key_code get_key_code(void) const {
+    return key_code_;
+  }
+
+  // hid_usage_page::zero if the key_code is not sent to the virtual devices. (e.g., key_code::vk_none)
+  constexpr hid_usage_page get_hid_usage_page(void) const {
+    return hid_usage_page_;
+  }
+
+  constexpr hid_usage get_hid_usage(void) const {
+    return hid_usage_;
+  }
+
+  constexpr bool has_hid_usage(void) const {
+    return hid_usage_page_ != hid_usage_page::zero;
+  }
+
+  // modifier_flag::zero if the key_code is not a modifier. (caps_lock is not a modifier.)
+  constexpr modifier_flag get_modifier_flag(void) const {
+    return modifier_flag_;
+  }
+
+  constexpr bool is_modifier(void) const {
+    return modifier_flag_ != modifier_flag::zero;
+  }
+
+private:
+  key_code key_code_;
+  hid_usage_page hid_usage_page_;
+  hid_usage hid_usage_;
+  modifier_flag modifier_flag_;
+};
+
+// key_code <-> (hid_usage_page, hid_usage) lookup arrays which are built at compile time.
+//
+// * key_code -> key_code_attributes: An array indexed by key_code.
+//   (0x00 - 0xff and `extra_size` key codes from key_code::extra_.)
+// * (hid_usage_page, hid_usage) -> key_code_attributes: Arrays of key_code indices for each usage page.
+//   Usages in keyboard_or_keypad usage page which are greater than 0xff are mapped to key_code(usage) without the array.
+class key_code_attributes_table final {
+public:
+  constexpr key_code_attributes_table(void) : key_code_entries_{},
+                                              keyboard_or_keypad_indices_{},
+                                              apple_vendor_keyboard_indices_{},
+                                              apple_vendor_top_case_indices_{} {
+    for (uint32_t i = 0; i < dense_size; ++i) {
+      key_code_entries_[i] = make_keyboard_or_keypad_attributes(key_code(i));
+    }
+    for (uint32_t i = 0; i < extra_size; ++i) {
+      // Undefined extra key codes are not sent.
+      key_code_entries_[dense_size + i] = key_code_attributes(key_code(static_cast<uint32_t>(key_code::extra_) + i),
+                                                              hid_usage_page::zero,
+                                                              hid_usage::zero,
+                                                              modifier_flag::zero);
+    }
+
+    set_hid_usage(key_code::fn, hid_usage_page::apple_vendor_top_case, hid_usage::av_top_case_keyboard_fn);
+    set_hid_usage(key_code::illumination_decrement, hid_usage_page::apple_vendor_top_case, hid_usage::av_top_case_illumination_down);
+    set_hid_usage(key_code::illumination_increment, hid_usage_page::apple_vendor_top_case, hid_usage::av_top_case_illumination_up);
+    set_hid_usage(key_code::apple_top_case_display_brightness_decrement, hid_usage_page::apple_vendor_top_case, hid_usage::av_top_case_brightness_down);
+    set_hid_usage(key_code::apple_top_case_display_brightness_increment, hid_usage_page::apple_vendor_top_case, hid_usage::av_top_case_brightness_up);
+
+    set_hid_usage(key_code::dashboard, hid_usage_page::apple_vendor_keyboard, hid_usage::apple_vendor_keyboard_dashboard);
+    set_hid_usage(key_code::launchpad, hid_usage_page::apple_vendor_keyboard, hid_usage::apple_vendor_keyboard_launchpad);
+    set_hid_usage(key_code::mission_control, hid_usage_page::apple_vendor_keyboard, hid_usage::apple_vendor_keyboard_expose_all);
+    set_hid_usage(key_code::apple_display_brightness_decrement, hid_usage_page::apple_vendor_keyboard, hid_usage::apple_vendor_keyboard_brightness_down);
+    set_hid_usage(key_code::apple_display_brightness_increment, hid_usage_page::apple_vendor_keyboard, hid_usage::apple_vendor_keyboard_brightness_up);
+
+    set_hid_usage(key_code::mute, hid_usage_page::consumer, hid_usage::csmr_mute);
+    set_hid_usage(key_code::volume_decrement, hid_usage_page::consumer, hid_usage::csmr_volume_decrement);
+    set_hid_usage(key_code::volume_increment, hid_usage_page::consumer, hid_usage::csmr_volume_increment);
+    set_hid_usage(key_code::display_brightness_decrement, hid_usage_page::consumer, hid_usage::csmr_display_brightness_decrement);
+    set_hid_usage(key_code::display_brightness_increment, hid_usage_page::consumer, hid_usage::csmr_display_brightness_increment);
+    set_hid_usage(key_code::rewind, hid_usage_page::consumer, hid_usage::csmr_rewind);
+    set_hid_usage(key_code::play_or_pause, hid_usage_page::consumer, hid_usage::csmr_play_or_pause);
+    set_hid_usage(key_code::fastforward, hid_usage_page::consumer, hid_usage::csmr_fastforward);
+    set_hid_usage(key_code::eject, hid_usage_page::consumer, hid_usage::csmr_eject);
+
+    set_modifier_flag(key_code::left_control, modifier_flag::left_control);
+    set_modifier_flag(key_code::left_shift, modifier_flag::left_shift);
+    set_modifier_flag(key_code::left_option, modifier_flag::left_option);
+    set_modifier_flag(key_code::left_command, modifier_flag::left_command);
+    set_modifier_flag(key_code::right_control, modifier_flag::right_control);
+    set_modifier_flag(key_code::right_shift, modifier_flag::right_shift);
+    set_modifier_flag(key_code::right_option, modifier_flag::right_option);
+    set_modifier_flag(key_code::right_command, modifier_flag::right_command);
+    set_modifier_flag(key_code::fn, modifier_flag::fn);
+
+    for (uint32_t i = 0; i < usage_size; ++i) {
+      keyboard_or_keypad_indices_[i] = -1;
+      apple_vendor_keyboard_indices_[i] = -1;
+      apple_vendor_top_case_indices_[i] = -1;
+    }
+    for (uint32_t i = kHIDUsage_KeyboardErrorUndefined + 1; i < usage_size; ++i) {
+      keyboard_or_keypad_indices_[i] = static_cast<int16_t>(i);
+    }
+    apple_vendor_keyboard_indices_[static_cast<uint32_t>(hid_usage::apple_vendor_keyboard_function)] = static_cast<int16_t>(key_code_index(key_code::fn));
+    apple_vendor_top_case_indices_[static_cast<uint32_t>(hid_usage::av_top_case_keyboard_fn)] = static_cast<int16_t>(key_code_index(key_code::fn));
+  }
+
+  constexpr key_code_attributes get(key_code key_code) const {
+    auto i = key_code_index(key_code);
+    if (i >= 0) {
+      return key_code_entries_[i];
+    }
+    if (static_cast<uint32_t>(key_code) < static_cast<uint32_t>(key_code::extra_)) {
+      return make_keyboard_or_keypad_attributes(key_code);
+    }
+    return key_code_attributes(key_code, hid_usage_page::zero, hid_usage::zero, modifier_flag::zero);
+  }
+
+  // Returns key_code_attributes() (`has_hid_usage() == false`) if no key_code is assigned to the usage.
+  constexpr key_code_attributes find(hid_usage_page usage_page, hid_usage usage) const {
+    auto u = static_cast<uint32_t>(usage);
+
+    switch (usage_page) {
+      case hid_usage_page::keyboard_or_keypad:
+        if (u < usage_size) {
+          return get_entry(keyboard_or_keypad_indices_[u]);
+        }
+        if (u < kHIDUsage_Keyboard_Reserved) {
+          return make_keyboard_or_keypad_attributes(key_code(u));
+        }
+        break;
+
+      case hid_usage_page::apple_vendor_keyboard:
+        if (u < usage_size) {
+          return get_entry(apple_vendor_keyboard_indices_[u]);
+        }
+        break;
+
+      case hid_usage_page::apple_vendor_top_case:
+        if (u < usage_size) {
+          return get_entry(apple_vendor_top_case_indices_[u]);
+        }
+        break;
+
+      default:
+        break;
+    }
+
+    return key_code_attributes();
+  }
+
+  // Checks key_code -> usage -> key_code round-trips. (for static_assert)
+  constexpr bool verify(void) const {
+    for (uint32_t i = 0; i < dense_size + extra_size; ++i) {
+      const auto& e = key_code_entries_[i];
+
+      if (key_code_index(e.get_key_code()) != static_cast<int>(i)) {
+        return false;
+      }
+
+      if (e.is_modifier()) {
+        // Modifiers must be sent and received by the same usage.
+        auto f = find(e.get_hid_usage_page(), e.get_hid_usage());
+        if (f.get_key_code() != e.get_key_code() ||
+            f.get_modifier_flag() != e.get_modifier_flag()) {
+          return false;
+        }
+
+        for (uint32_t j = 0; j < i; ++j) {
+          if (key_code_entries_[j].get_modifier_flag() == e.get_modifier_flag()) {
+            return false;
+          }
+        }
       }
 
-      if (input_source_id_string_) {
-        s = *input_source_id_string_;
-        input_source_id_regex_ = std::regex(s);
+      if (e.has_hid_usage()) {
+        auto f = find(e.get_hid_usage_page(), e.get_hid_usage());
+        if (f.has_hid_usage() && f.get_key_code() != e.get_key_code()) {
+          return false;
+        }
       }
+    }
 
-      if (input_mode_id_string_) {
-        s = *input_mode_id_string_;
-        input_mode_id_regex_ = std::regex(s);
+    for (uint32_t u = 0; u < usage_size; ++u) {
+      if (!verify_usage(hid_usage_page::keyboard_or_keypad, hid_usage(u)) ||
+          !verify_usage(hid_usage_page::apple_vendor_keyboard, hid_usage(u)) ||
+          !verify_usage(hid_usage_page::apple_vendor_top_case, hid_usage(u))) {
+        return false;
       }
-    } catch (std::exception& e) {
-      logger::get_logger().error("complex_modifications json error: Regex error: \"{0}\" {1}", s, e.what());
     }
+
+    return true;
   }
 
-  boost::optional<std::string> language_string_;
-  boost::optional<std::string> input_source_id_string_;
-  boost::optional<std::string> input_mode_id_string_;
+private:
+  static constexpr uint32_t dense_size = 0x100;
+  static constexpr uint32_t extra_size = 0x100;
+  static constexpr uint32_t usage_size = 0x100;
+
+  static constexpr int key_code_index(key_code key_code) {
+    auto v = static_cast<uint32_t>(key_code);
+    if (v < dense_size) {
+      return static_cast<int>(v);
+    }
+    auto e = static_cast<uint32_t>(key_code::extra_);
+    if (e <= v && v - e < extra_size) {
+      return static_cast<int>(dense_size + (v - e));
+    }
+    return -1;
+  }
+
+  static constexpr key_code_attributes make_keyboard_or_keypad_attributes(key_code key_code) {
+    return key_code_attributes(key_code,
+                               hid_usage_page::keyboard_or_keypad,
+                               hid_usage(static_cast<uint32_t>(key_code)),
+                               modifier_flag::zero);
+  }
+
+  constexpr key_code_attributes get_entry(int16_t index) const {
+    if (index >= 0) {
+      return key_code_entries_[index];
+    }
+    return key_code_attributes();
+  }
+
+  constexpr void set_hid_usage(key_code key_code, hid_usage_page hid_usage_page, hid_usage hid_usage) {
+    auto& e = key_code_entries_[key_code_index(key_code)];
+    e = key_code_attributes(key_code, hid_usage_page, hid_usage, e.get_modifier_flag());
+  }
+
+  constexpr void set_modifier_flag(key_code key_code, modifier_flag modifier_flag) {
+    auto& e = key_code_entries_[key_code_index(key_code)];
+    e = key_code_attributes(key_code, e.get_hid_usage_page(), e.get_hid_usage(), modifier_flag);
+  }
 
-  boost::optional<std::regex> language_regex_;
-  boost::optional<std::regex> input_source_id_regex_;
-  boost::optional<std::regex> input_mode_id_regex_;
+  // A received key must be sent as a key which has the same modifier flag.
+  constexpr bool verify_usage(hid_usage_page usage_page, hid_usage usage) const {
+    auto f = find(usage_page, usage);
+    if (f.has_hid_usage()) {
+      auto e = get(f.get_key_code());
+      if (!e.has_hid_usage() ||
+          e.get_modifier_flag() != f.get_modifier_flag()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  key_code_attributes key_code_entries_[dense_size + extra_size];
+  int16_t keyboard_or_keypad_indices_[usage_size];
+  int16_t apple_vendor_keyboard_indices_[usage_size];
+  int16_t apple_vendor_top_case_indices_[usage_size];
 };
 
 class types final {
@@ -688,66 +1099,50 @@ public:
                                       product_id product_id,
                                       bool is_keyboard,
                                       bool is_pointing_device) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
+    return get_device_identifiers_registry().attach(vendor_id,
+                                                    product_id,
+                                                    is_keyboard,
+                                                    is_pointing_device);
+  }
 
-    static auto id = device_id::zero;
+  static void detach_device_id(device_id device_id) {
+    get_device_identifiers_registry().detach(device_id);
+  }
 
-    id = device_id(static_cast<uint32_t>(id) + 1);
+  static boost::optional<device_identifiers> find_device_identifiers(device_id device_id) {
+    return get_device_identifiers_registry().find(device_id);
+  }
 
-    auto& map = get_device_identifiers_map();
-    map[id] = device_identifiers(vendor_id,
-                                 product_id,
-                                 is_keyboard,
-                                 is_pointing_device);
+  static const key_code_attributes_table& get_key_code_attributes_table(void) {
+    static constexpr key_code_attributes_table table;
+    static_assert(table.verify(), "key_code_attributes_table must be consistent");
 
-    return id;
+    return table;
   }
 
-  static void detach_device_id(device_id device_id) {
-    auto& map = get_device_identifiers_map();
-    map.erase(device_id);
+  static key_code_attributes get_key_code_attributes(key_code key_code) {
+    return get_key_code_attributes_table().get(key_code);
   }
 
-  static const device_identifiers* find_device_identifiers(device_id device_id) {
-    auto& map = get_device_identifiers_map();
-    auto it = map.find(device_id);
-    if (it == std::end(map)) {
-      return nullptr;
-    }
-    return &(it->second);
+  // `has_hid_usage() == false` if no key_code is assigned to the usage.
+  static key_code_attributes find_key_code_attributes(hid_usage_page usage_page, hid_usage usage) {
+    return get_key_code_attributes_table().find(usage_page, usage);
   }
 
   static boost::optional<modifier_flag> make_modifier_flag(key_code key_code) {
     // make_modifier_flag(key_code::caps_lock) == boost::none
 
-    switch (key_code) {
-      case key_code::left_control:
-        return modifier_flag::left_control;
-      case key_code::left_shift:
-        return modifier_flag::left_shift;
-      case key_code::left_option:
-        return modifier_flag::left_option;
-      case key_code::left_command:
-        return modifier_flag::left_command;
-      case key_code::right_control:
-        return modifier_flag::right_control;
-      case key_code::right_shift:
-        return modifier_flag::right_shift;
-      case key_code::right_option:
-        return modifier_flag::right_option;
-      case key_code::right_command:
-        return modifier_flag::right_command;
-      case key_code::fn:
-        return modifier_flag::fn;
-      default:
-        return boost::none;
+    auto a = get_key_code_attributes(key_code);
+    if (a.is_modifier()) {
+      return a.get_modifier_flag();
     }
+    return boost::none;
   }
 
   static boost::optional<modifier_flag> make_modifier_flag(hid_usage_page usage_page, hid_usage usage) {
-    if (auto key_code = make_key_code(usage_page, usage)) {
-      return make_modifier_flag(*key_code);
+    auto a = find_key_code_attributes(usage_page, usage);
+    if (a.is_modifier()) {
+      return a.get_modifier_flag();
     }
     return boost::none;
   }
@@ -792,12 +1187,9 @@ public:
     }
   }
 
-  // string -> hid usage map
-  static const std::vector<std::pair<std::string, key_code>>& get_key_code_name_value_pairs(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::vector<std::pair<std::string, key_code>> pairs({
+  // name <-> key_code
+  static const auto& get_key_code_name_table(void) {
+    static constexpr name_value_pair<key_code> pairs[] = {
         // From IOHIDUsageTables.h
         {"a", key_code(kHIDUsage_KeyboardA)},
         {"b", key_code(kHIDUsage_KeyboardB)},
@@ -1011,186 +1403,55 @@ public:
         {"vk_consumer_next", key_code::fastforward},
         {"volume_down", key_code(kHIDUsage_KeyboardVolumeDown)},
         {"volume_up", key_code(kHIDUsage_KeyboardVolumeUp)},
-    });
-
-    return pairs;
-  }
-
-  static const std::unordered_map<std::string, key_code>& get_key_code_name_value_map(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
+    };
 
-    static std::unordered_map<std::string, key_code> map;
-
-    if (map.empty()) {
-      for (const auto& pair : get_key_code_name_value_pairs()) {
-        auto it = map.find(pair.first);
-        if (it != std::end(map)) {
-          logger::get_logger().error("duplicate entry in get_key_code_name_value_pairs: {0}", pair.first);
-        } else {
-          map.emplace(pair.first, pair.second);
-        }
-      }
-    }
+    static constexpr auto table = make_name_table<0x100, static_cast<uint32_t>(key_code::extra_), 0x100>(pairs);
+    static_assert(table.verify(), "key_code names must be unique and in the table range");
 
-    return map;
+    return table;
   }
 
   static boost::optional<key_code> make_key_code(const std::string& name) {
-    auto& map = get_key_code_name_value_map();
-    auto it = map.find(name);
-    if (it == map.end()) {
-      logger::get_logger().error("unknown key_code: \"{0}\"", name);
-      return boost::none;
+    if (auto v = get_key_code_name_table().find_value(name.c_str(), name.size())) {
+      return *v;
     }
-    return it->second;
+    logger::get_logger().error("unknown key_code: \"{0}\"", name);
+    return boost::none;
   }
 
   static boost::optional<std::string> make_key_code_name(key_code key_code) {
-    for (const auto& pair : get_key_code_name_value_pairs()) {
-      if (pair.second == key_code) {
-        return pair.first;
-      }
+    if (auto n = get_key_code_name_table().find_name(key_code)) {
+      return std::string(n);
     }
     return boost::none;
   }
 
   static boost::optional<key_code> make_key_code(hid_usage_page usage_page, hid_usage usage) {
-    auto u = static_cast<uint32_t>(usage);
-
-    switch (usage_page) {
-      case hid_usage_page::keyboard_or_keypad:
-        if (kHIDUsage_KeyboardErrorUndefined < u && u < kHIDUsage_Keyboard_Reserved) {
-          return key_code(u);
-        }
-        break;
-
-      case hid_usage_page::apple_vendor_top_case:
-        if (usage == hid_usage::av_top_case_keyboard_fn) {
-          return key_code::fn;
-        }
-        break;
-
-      case hid_usage_page::apple_vendor_keyboard:
-        if (usage == hid_usage::apple_vendor_keyboard_function) {
-          return key_code::fn;
-        }
-        break;
-
-      default:
-        break;
+    auto a = find_key_code_attributes(usage_page, usage);
+    if (a.has_hid_usage()) {
+      return a.get_key_code();
     }
-
     return boost::none;
   }
 
   static boost::optional<hid_usage_page> make_hid_usage_page(key_code key_code) {
-    switch (key_code) {
-      case key_code::fn:
-      case key_code::illumination_decrement:
-      case key_code::illumination_increment:
-      case key_code::apple_top_case_display_brightness_decrement:
-      case key_code::apple_top_case_display_brightness_increment:
-        return hid_usage_page::apple_vendor_top_case;
-
-      case key_code::dashboard:
-      case key_code::launchpad:
-      case key_code::mission_control:
-      case key_code::apple_display_brightness_decrement:
-      case key_code::apple_display_brightness_increment:
-        return hid_usage_page::apple_vendor_keyboard;
-
-      case key_code::mute:
-      case key_code::volume_decrement:
-      case key_code::volume_increment:
-      case key_code::display_brightness_decrement:
-      case key_code::display_brightness_increment:
-      case key_code::rewind:
-      case key_code::play_or_pause:
-      case key_code::fastforward:
-      case key_code::eject:
-        return hid_usage_page::consumer;
-
-      case key_code::vk_none:
-        return boost::none;
-
-      default:
-        return hid_usage_page::keyboard_or_keypad;
+    auto a = get_key_code_attributes(key_code);
+    if (a.has_hid_usage()) {
+      return a.get_hid_usage_page();
     }
+    return boost::none;
   }
 
   static boost::optional<hid_usage> make_hid_usage(key_code key_code) {
-    switch (key_code) {
-      case key_code::fn:
-        return hid_usage::av_top_case_keyboard_fn;
-
-      case key_code::illumination_decrement:
-        return hid_usage::av_top_case_illumination_down;
-
-      case key_code::illumination_increment:
-        return hid_usage::av_top_case_illumination_up;
-
-      case key_code::apple_top_case_display_brightness_decrement:
-        return hid_usage::av_top_case_brightness_down;
-
-      case key_code::apple_top_case_display_brightness_increment:
-        return hid_usage::av_top_case_brightness_up;
-
-      case key_code::dashboard:
-        return hid_usage::apple_vendor_keyboard_dashboard;
-
-      case key_code::launchpad:
-        return hid_usage::apple_vendor_keyboard_launchpad;
-
-      case key_code::mission_control:
-        return hid_usage::apple_vendor_keyboard_expose_all;
-
-      case key_code::apple_display_brightness_decrement:
-        return hid_usage::apple_vendor_keyboard_brightness_down;
-
-      case key_code::apple_display_brightness_increment:
-        return hid_usage::apple_vendor_keyboard_brightness_up;
-
-      case key_code::mute:
-        return hid_usage::csmr_mute;
-
-      case key_code::volume_decrement:
-        return hid_usage::csmr_volume_decrement;
-
-      case key_code::volume_increment:
-        return hid_usage::csmr_volume_increment;
-
-      case key_code::display_brightness_decrement:
-        return hid_usage::csmr_display_brightness_decrement;
-
-      case key_code::display_brightness_increment:
-        return hid_usage::csmr_display_brightness_increment;
-
-      case key_code::rewind:
-        return hid_usage::csmr_rewind;
-
-      case key_code::play_or_pause:
-        return hid_usage::csmr_play_or_pause;
-
-      case key_code::fastforward:
-        return hid_usage::csmr_fastforward;
-
-      case key_code::eject:
-        return hid_usage::csmr_eject;
-
-      case key_code::vk_none:
-        return boost::none;
-
-      default:
-        return hid_usage(key_code);
+    auto a = get_key_code_attributes(key_code);
+    if (a.has_hid_usage()) {
+      return a.get_hid_usage();
     }
+    return boost::none;
   }
 
-  static const std::vector<std::pair<std::string, consumer_key_code>>& get_consumer_key_code_name_value_pairs(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::vector<std::pair<std::string, consumer_key_code>> pairs({
+  static const auto& get_consumer_key_code_name_table(void) {
+    static constexpr name_value_pair<consumer_key_code> pairs[] = {
         {"power", consumer_key_code::power},
         {"display_brightness_increment", consumer_key_code::display_brightness_increment},
         {"display_brightness_decrement", consumer_key_code::display_brightness_decrement},
@@ -1203,46 +1464,25 @@ public:
         {"mute", consumer_key_code::mute},
         {"volume_increment", consumer_key_code::volume_increment},
         {"volume_decrement", consumer_key_code::volume_decrement},
-    });
-
-    return pairs;
-  }
-
-  static const std::unordered_map<std::string, consumer_key_code>& get_consumer_key_code_name_value_map(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
+    };
 
-    static std::unordered_map<std::string, consumer_key_code> map;
-
-    if (map.empty()) {
-      for (const auto& pair : get_consumer_key_code_name_value_pairs()) {
-        auto it = map.find(pair.first);
-        if (it != std::end(map)) {
-          logger::get_logger().error("duplicate entry in get_consumer_key_code_name_value_pairs: {0}", pair.first);
-        } else {
-          map.emplace(pair.first, pair.second);
-        }
-      }
-    }
+    static constexpr auto table = make_name_table<0x100>(pairs);
+    static_assert(table.verify(), "consumer_key_code names must be unique and in the table range");
 
-    return map;
+    return table;
   }
 
   static boost::optional<consumer_key_code> make_consumer_key_code(const std::string& name) {
-    auto& map = get_consumer_key_code_name_value_map();
-    auto it = map.find(name);
-    if (it == map.end()) {
-      logger::get_logger().error("unknown consumer_key_code: \"{0}\"", name);
-      return boost::none;
+    if (auto v = get_consumer_key_code_name_table().find_value(name.c_str(), name.size())) {
+      return *v;
     }
-    return it->second;
+    logger::get_logger().error("unknown consumer_key_code: \"{0}\"", name);
+    return boost::none;
   }
 
   static boost::optional<std::string> make_consumer_key_code_name(consumer_key_code consumer_key_code) {
-    for (const auto& pair : get_consumer_key_code_name_value_pairs()) {
-      if (pair.second == consumer_key_code) {
-        return pair.first;
-      }
+    if (auto n = get_consumer_key_code_name_table().find_name(consumer_key_code)) {
+      return std::string(n);
     }
     return boost::none;
   }
@@ -1283,11 +1523,8 @@ public:
     return hid_usage(static_cast<uint32_t>(consumer_key_code));
   }
 
-  static const std::vector<std::pair<std::string, pointing_button>>& get_pointing_button_name_value_pairs(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::vector<std::pair<std::string, pointing_button>> pairs({
+  static const auto& get_pointing_button_name_table(void) {
+    static constexpr name_value_pair<pointing_button> pairs[] = {
         // From IOHIDUsageTables.h
 
         {"button1", pointing_button::button1},
@@ -1325,46 +1562,25 @@ public:
         {"button30", pointing_button::button30},
         {"button31", pointing_button::button31},
         {"button32", pointing_button::button32},
-    });
+    };
 
-    return pairs;
-  }
-
-  static const std::unordered_map<std::string, pointing_button>& get_pointing_button_name_value_map(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::unordered_map<std::string, pointing_button> map;
-
-    if (map.empty()) {
-      for (const auto& pair : get_pointing_button_name_value_pairs()) {
-        auto it = map.find(pair.first);
-        if (it != std::end(map)) {
-          logger::get_logger().error("duplicate entry in get_pointing_button_name_value_pairs: {0}", pair.first);
-        } else {
-          map.emplace(pair.first, pair.second);
-        }
-      }
-    }
+    static constexpr auto table = make_name_table<0x100>(pairs);
+    static_assert(table.verify(), "pointing_button names must be unique and in the table range");
 
-    return map;
+    return table;
   }
 
   static boost::optional<pointing_button> make_pointing_button(const std::string& name) {
-    auto& map = get_pointing_button_name_value_map();
-    auto it = map.find(name);
-    if (it == map.end()) {
-      logger::get_logger().error("unknown pointing_button: \"{0}\"", name);
-      return boost::none;
+    if (auto v = get_pointing_button_name_table().find_value(name.c_str(), name.size())) {
+      return *v;
     }
-    return it->second;
+    logger::get_logger().error("unknown pointing_button: \"{0}\"", name);
+    return boost::none;
   }
 
   static boost::optional<std::string> make_pointing_button_name(pointing_button pointing_button) {
-    for (const auto& pair : get_pointing_button_name_value_pairs()) {
-      if (pair.second == pointing_button) {
-        return pair.first;
-      }
+    if (auto n = get_pointing_button_name_table().find_name(pointing_button)) {
+      return std::string(n);
     }
     return boost::none;
   }
@@ -1398,9 +1614,9 @@ public:
   }
 
 private:
-  static std::unordered_map<device_id, device_identifiers>& get_device_identifiers_map(void) {
-    static std::unordered_map<device_id, device_identifiers> map;
-    return map;
+  static device_identifiers_registry& get_device_identifiers_registry(void) {
+    static device_identifiers_registry registry;
+    return registry;
   }
 };
 
@@ -0,0 +1,112 @@
+#define CATCH_CONFIG_RUNNER
+#include "../../vendor/catch/catch.hpp"
+
+#include "async_json_file_writer.hpp"
+#include "manipulator_environment.hpp"
+#include "thread_utility.hpp"
+
+namespace {
+nlohmann::json read_json(const std::string& file_path) {
+  std::ifstream input(file_path);
+  return nlohmann::json::parse(input);
+}
+} // namespace
+
+TEST_CASE("async_save") {
+  std::string file_path("tmp/async_save.json");
+
+  {
+    krbn::async_json_file_writer writer(file_path, std::chrono::milliseconds(10));
+
+    writer.async_save(nlohmann::json({{"value", 1}}));
+
+    // Wait for the interval.
+    for (int i = 0; i < 500; ++i) {
+      if (writer.get_write_count() > 0) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    REQUIRE(writer.get_write_count() == 1);
+    REQUIRE(read_json(file_path) == nlohmann::json({{"value", 1}}));
+    REQUIRE(!krbn::filesystem::exists(file_path + ".tmp"));
+
+    // Pending json is written in the destructor.
+
+    writer.async_save(nlohmann::json({{"value", 2}}));
+  }
+
+  REQUIRE(read_json(file_path) == nlohmann::json({{"value", 2}}));
+}
+
+TEST_CASE("burst") {
+  // 1000 toggles are coalesced into one write.
+
+  std::string file_path("tmp/burst.json");
+
+  krbn::manipulator_environment manipulator_environment;
+  manipulator_environment.enable_json_output(file_path, std::chrono::milliseconds(1000));
+
+  for (int i = 0; i < 1000; ++i) {
+    manipulator_environment.set_variable("toggle", i % 2 == 0 ? 1 : 0);
+  }
+
+  auto writer = manipulator_environment.get_json_file_writer();
+  REQUIRE(writer);
+
+  writer->flush();
+
+  REQUIRE(writer->get_write_count() == 1);
+  REQUIRE(read_json(file_path)["variables"]["toggle"] == 0);
+
+  // flush without pending json
+
+  writer->flush();
+
+  REQUIRE(writer->get_write_count() == 1);
+}
+
+TEST_CASE("interval") {
+  // Continuous updates do not postpone the write.
+
+  std::string file_path("tmp/interval.json");
+  krbn::async_json_file_writer writer(file_path, std::chrono::milliseconds(50));
+
+  for (int i = 0; i < 100 && writer.get_write_count() == 0; ++i) {
+    writer.async_save(nlohmann::json({{"value", i}}));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  REQUIRE(writer.get_write_count() > 0);
+}
+
+TEST_CASE("manipulator_environment") {
+  std::string file_path("tmp/manipulator_environment.json");
+
+  krbn::manipulator_environment manipulator_environment;
+  manipulator_environment.enable_json_output(file_path);
+
+  for (int i = 0; i < 1000; ++i) {
+    manipulator_environment.set_variable("toggle", i % 2 == 0 ? 1 : 0);
+  }
+  manipulator_environment.set_frontmost_application(krbn::manipulator_environment::frontmost_application("com.apple.Terminal",
+                                                                                                         "/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal"));
+
+  manipulator_environment.disable_json_output();
+
+  auto json = read_json(file_path);
+  REQUIRE(json["variables"]["toggle"] == 0);
+  REQUIRE(json["frontmost_application"]["bundle_identifier"] == "com.apple.Terminal");
+
+  // Changes are not written after `disable_json_output`.
+
+  manipulator_environment.set_variable("toggle", 1);
+
+  REQUIRE(read_json(file_path)["variables"]["toggle"] == 0);
+}
+
+int main(int argc, char* const argv[]) {
+  krbn::thread_utility::register_main_thread();
+  return Catch::Session().run(argc, argv);
+}
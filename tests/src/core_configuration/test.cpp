@@ -672,6 +672,7 @@ TEST_CASE("profile.to_json") {
                                             }},
                             {"ignore", true},
                             {"disable_built_in_keyboard_if_exists", true},
+                            {"coalesce_pointing_motion", false},
                             {"simple_modifications", nlohmann::json::array()},
                             {"fn_function_keys", nlohmann::json::array()},
                         },
@@ -1183,6 +1184,7 @@ TEST_CASE("device") {
     REQUIRE(device.get_identifiers().get_is_pointing_device() == false);
     REQUIRE(device.get_ignore() == false);
     REQUIRE(device.get_disable_built_in_keyboard_if_exists() == false);
+    REQUIRE(device.get_coalesce_pointing_motion() == false);
   }
 
   // load values from json
@@ -1204,6 +1206,7 @@ TEST_CASE("device") {
                         }},
         {"ignore", true},
         {"disable_built_in_keyboard_if_exists", true},
+        {"coalesce_pointing_motion", true},
     });
     krbn::core_configuration::profile::device device(json);
     REQUIRE(device.get_identifiers().get_vendor_id() == krbn::vendor_id(1234));
@@ -1212,6 +1215,7 @@ TEST_CASE("device") {
     REQUIRE(device.get_identifiers().get_is_pointing_device() == true);
     REQUIRE(device.get_ignore() == true);
     REQUIRE(device.get_disable_built_in_keyboard_if_exists() == true);
+    REQUIRE(device.get_coalesce_pointing_motion() == true);
   }
 
   // invalid values in json
@@ -1220,6 +1224,7 @@ TEST_CASE("device") {
         {"identifiers", nullptr},
         {"ignore", 1},
         {"disable_built_in_keyboard_if_exists", nlohmann::json::array()},
+        {"coalesce_pointing_motion", 1},
     });
     krbn::core_configuration::profile::device device(json);
     REQUIRE(device.get_identifiers().get_vendor_id() == krbn::vendor_id(0));
@@ -1228,6 +1233,7 @@ TEST_CASE("device") {
     REQUIRE(device.get_identifiers().get_is_pointing_device() == false);
     REQUIRE(device.get_ignore() == false);
     REQUIRE(device.get_disable_built_in_keyboard_if_exists() == false);
+    REQUIRE(device.get_coalesce_pointing_motion() == false);
   }
 }
 
@@ -1252,6 +1258,7 @@ TEST_CASE("device.to_json") {
                         }},
         {"ignore", false},
         {"disable_built_in_keyboard_if_exists", false},
+        {"coalesce_pointing_motion", false},
         {"simple_modifications", nlohmann::json::array()},
         {"fn_function_keys", nlohmann::json::array()},
     });
@@ -1294,6 +1301,7 @@ TEST_CASE("device.to_json") {
                         }},
         {"ignore", true},
         {"disable_built_in_keyboard_if_exists", false},
+        {"coalesce_pointing_motion", false},
         {"simple_modifications", nlohmann::json::array()},
         {"fn_function_keys", nlohmann::json::array()},
         {"dummy", {{"keep_me", true}}},
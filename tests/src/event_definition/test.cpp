@@ -5,6 +5,7 @@
 #include "manipulator/details/types.hpp"
 #include "thread_utility.hpp"
 #include <boost/optional/optional_io.hpp>
+#include <random>
 
 namespace {
 krbn::modifier_flag_manager::active_modifier_flag left_command_1(krbn::modifier_flag_manager::active_modifier_flag::type::increase,
@@ -156,7 +157,7 @@ TEST_CASE("event_definition.test_modifiers") {
 
     {
       krbn::modifier_flag_manager modifier_flag_manager;
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({}));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
@@ -178,7 +179,7 @@ TEST_CASE("event_definition.test_modifiers") {
 
     {
       krbn::modifier_flag_manager modifier_flag_manager;
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({}));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
@@ -202,12 +203,12 @@ TEST_CASE("event_definition.test_modifiers") {
 
     {
       krbn::modifier_flag_manager modifier_flag_manager;
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({}));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_shift,
                                                                         }));
     }
@@ -215,7 +216,7 @@ TEST_CASE("event_definition.test_modifiers") {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_command_1);
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_command,
                                                                             krbn::modifier_flag::left_shift,
                                                                         }));
@@ -237,18 +238,18 @@ TEST_CASE("event_definition.test_modifiers") {
 
     {
       krbn::modifier_flag_manager modifier_flag_manager;
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({}));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({}));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_command_1);
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({}));
     }
   }
 
@@ -274,7 +275,7 @@ TEST_CASE("event_definition.test_modifiers") {
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_control_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_control,
                                                                         }));
     }
@@ -282,7 +283,7 @@ TEST_CASE("event_definition.test_modifiers") {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_control_1);
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_control,
                                                                         }));
     }
@@ -316,7 +317,7 @@ TEST_CASE("event_definition.test_modifiers") {
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_shift,
                                                                         }));
     }
@@ -324,7 +325,7 @@ TEST_CASE("event_definition.test_modifiers") {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_command_1);
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_shift,
                                                                         }));
     }
@@ -351,7 +352,7 @@ TEST_CASE("event_definition.test_modifiers") {
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_shift,
                                                                         }));
     }
@@ -386,14 +387,14 @@ TEST_CASE("event_definition.test_modifiers") {
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_shift,
                                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(right_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::right_shift,
                                                                         }));
     }
@@ -401,7 +402,7 @@ TEST_CASE("event_definition.test_modifiers") {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
       modifier_flag_manager.push_back_active_modifier_flag(right_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_shift,
                                                                         }));
     }
@@ -410,7 +411,7 @@ TEST_CASE("event_definition.test_modifiers") {
       modifier_flag_manager.push_back_active_modifier_flag(left_command_1);
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
       modifier_flag_manager.push_back_active_modifier_flag(right_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_shift,
                                                                         }));
     }
@@ -437,14 +438,14 @@ TEST_CASE("event_definition.test_modifiers") {
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_shift,
                                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(right_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::right_shift,
                                                                         }));
     }
@@ -452,7 +453,7 @@ TEST_CASE("event_definition.test_modifiers") {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
       modifier_flag_manager.push_back_active_modifier_flag(right_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_set({
                                                                             krbn::modifier_flag::left_shift,
                                                                         }));
     }
@@ -466,6 +467,90 @@ TEST_CASE("event_definition.test_modifiers") {
   }
 }
 
+namespace {
+// The straightforward form of `from_event_definition::test_modifiers` which uses `test_modifier`.
+boost::optional<krbn::modifier_flag_set> reference_test_modifiers(const krbn::manipulator::details::from_event_definition& from,
+                                                                  const krbn::modifier_flag_manager& modifier_flag_manager) {
+  using krbn::manipulator::details::event_definition;
+  using krbn::manipulator::details::from_event_definition;
+
+  const auto& mandatory_modifiers = from.get_mandatory_modifiers();
+  const auto& optional_modifiers = from.get_optional_modifiers();
+
+  krbn::modifier_flag_set modifier_flags;
+
+  if (mandatory_modifiers.find(event_definition::modifier::any) != std::end(mandatory_modifiers)) {
+    for (const auto& f : krbn::modifier_flag_set::all()) {
+      if (modifier_flag_manager.is_pressed(f)) {
+        modifier_flags.insert(f);
+      }
+    }
+    return modifier_flags;
+  }
+
+  for (const auto& m : mandatory_modifiers) {
+    auto pair = from_event_definition::test_modifier(modifier_flag_manager, m);
+    if (!pair.first) {
+      return boost::none;
+    }
+    modifier_flags.insert(pair.second);
+  }
+
+  if (optional_modifiers.find(event_definition::modifier::any) == std::end(optional_modifiers)) {
+    for (const auto& f : krbn::modifier_flag_set::all()) {
+      bool allowed = false;
+      for (const auto& modifiers : {mandatory_modifiers, optional_modifiers}) {
+        for (const auto& m : modifiers) {
+          if (event_definition::get_modifier_flags(m).contains(f)) {
+            allowed = true;
+          }
+        }
+      }
+      if (!allowed && modifier_flag_manager.is_pressed(f)) {
+        return boost::none;
+      }
+    }
+  }
+
+  return modifier_flags;
+}
+} // namespace
+
+TEST_CASE("event_definition.test_modifiers (random)") {
+  using krbn::manipulator::details::event_definition;
+  using krbn::manipulator::details::from_event_definition;
+
+  std::mt19937 engine(1234);
+  std::uniform_int_distribution<int> modifier_distribution(0, static_cast<int>(event_definition::modifier::end_) - 1);
+  std::uniform_int_distribution<int> count_distribution(0, 3);
+  std::uniform_int_distribution<uint32_t> bits_distribution(0, (1u << static_cast<uint32_t>(krbn::modifier_flag::end_)) - 1);
+
+  for (int i = 0; i < 1000; ++i) {
+    std::unordered_set<event_definition::modifier> mandatory_modifiers;
+    std::unordered_set<event_definition::modifier> optional_modifiers;
+    for (int n = count_distribution(engine); n > 0; --n) {
+      mandatory_modifiers.insert(event_definition::modifier(modifier_distribution(engine)));
+    }
+    for (int n = count_distribution(engine); n > 0; --n) {
+      optional_modifiers.insert(event_definition::modifier(modifier_distribution(engine)));
+    }
+    from_event_definition from(krbn::key_code::a, mandatory_modifiers, optional_modifiers);
+
+    for (int j = 0; j < 20; ++j) {
+      krbn::modifier_flag_manager modifier_flag_manager;
+      // Keep the number of pressed flags small so that both results appear.
+      auto bits = bits_distribution(engine) & bits_distribution(engine);
+      for (const auto& f : krbn::modifier_flag_set::from_bits(bits)) {
+        modifier_flag_manager.push_back_active_modifier_flag(krbn::modifier_flag_manager::active_modifier_flag(krbn::modifier_flag_manager::active_modifier_flag::type::increase,
+                                                                                                               f,
+                                                                                                               krbn::device_id(1)));
+      }
+
+      REQUIRE(from.test_modifiers(modifier_flag_manager) == reference_test_modifiers(from, modifier_flag_manager));
+    }
+  }
+}
+
 TEST_CASE("manipulator.details.from_event_definition") {
   {
     nlohmann::json json;
@@ -4,6 +4,7 @@
 #include "event_queue.hpp"
 #include "thread_utility.hpp"
 #include <boost/optional/optional_io.hpp>
+#include <random>
 
 #define ENQUEUE_EVENT(QUEUE, DEVICE_ID, TIME_STAMP, EVENT, EVENT_TYPE, ORIGINAL_EVENT) \
   QUEUE.emplace_back_event(krbn::device_id(DEVICE_ID),                                 \
@@ -194,6 +195,95 @@ TEST_CASE("get_frontmost_application_bundle_identifier") {
   }
 }
 
+TEST_CASE("event.operator==") {
+  auto e1 = krbn::event_queue::queued_event::event::make_shell_command_event("open https://pqrs.org");
+  auto e2 = krbn::event_queue::queued_event::event::make_shell_command_event("open https://pqrs.org");
+  auto e3 = krbn::event_queue::queued_event::event::make_shell_command_event("open https://github.com");
+  auto e4 = krbn::event_queue::queued_event::event::make_set_variable_event(std::make_pair("open https://pqrs.org", 1));
+
+  REQUIRE(e1 == e2);
+  REQUIRE(!(e1 == e3));
+  REQUIRE(!(e1 == e4));
+  REQUIRE(e3.get_shell_command() == std::string("open https://github.com"));
+
+  // Events without value
+
+  krbn::event_queue::queued_event::event e5(nlohmann::json::parse(R"({"type": "key_code"})"));
+  REQUIRE(e5.get_type() == krbn::event_queue::queued_event::event::type::key_code);
+  REQUIRE(e5.get_key_code() == boost::none);
+  REQUIRE(!(e5 == krbn::event_queue::queued_event::event(krbn::key_code(0))));
+}
+
+TEST_CASE("event.interned_values") {
+  using event = krbn::event_queue::queued_event::event;
+
+  {
+    std::vector<krbn::input_source_selector> selectors1{krbn::input_source_selector(std::string("^en$"), boost::none, boost::none)};
+    std::vector<krbn::input_source_selector> selectors2{krbn::input_source_selector(std::string("^ja$"), boost::none, boost::none)};
+    auto e1 = event::make_select_input_source_event(selectors1);
+    auto e2 = event::make_select_input_source_event(selectors1);
+    auto e3 = event::make_select_input_source_event(selectors2);
+
+    REQUIRE(e1 == e2);
+    REQUIRE(!(e1 == e3));
+    REQUIRE(e3.get_input_source_selectors() == selectors2);
+  }
+  {
+    auto e1 = event::make_frontmost_application_changed_event("com.apple.Terminal", "/Applications/Utilities/Terminal.app");
+    auto e2 = event::make_frontmost_application_changed_event("com.apple.Terminal", "/Applications/Utilities/Terminal.app");
+    auto e3 = event::make_frontmost_application_changed_event("com.apple.Terminal", "");
+
+    REQUIRE(e1 == e2);
+    REQUIRE(!(e1 == e3));
+    REQUIRE(e3.get_frontmost_application()->get_bundle_identifier() == "com.apple.Terminal");
+    REQUIRE(e3.get_frontmost_application()->get_file_path() == "");
+  }
+  {
+    krbn::input_source_identifiers identifiers1(std::string("en"), boost::none, boost::none);
+    krbn::input_source_identifiers identifiers2(boost::none, std::string("en"), boost::none);
+    auto e1 = event::make_input_source_changed_event(identifiers1);
+    auto e2 = event::make_input_source_changed_event(identifiers1);
+    auto e3 = event::make_input_source_changed_event(identifiers2);
+
+    REQUIRE(e1 == e2);
+    REQUIRE(!(e1 == e3));
+    REQUIRE(e3.get_input_source_identifiers() == identifiers2);
+  }
+}
+
+TEST_CASE("event.set_variable") {
+  auto e1 = krbn::event_queue::queued_event::event::make_set_variable_event(std::make_pair("layer1", -2));
+  auto e2 = krbn::event_queue::queued_event::event::make_set_variable_event(std::make_pair("layer2", 2147483647));
+
+  auto id1 = krbn::manipulator_environment::make_variable_id("layer1");
+  auto id2 = krbn::manipulator_environment::make_variable_id("layer2");
+  REQUIRE(id1 != id2);
+  REQUIRE(krbn::manipulator_environment::make_variable_id("layer1") == id1);
+  REQUIRE(krbn::manipulator_environment::get_variable_name(id1) == "layer1");
+
+  REQUIRE(e1.get_set_variable_id_and_value()->first == id1);
+  REQUIRE(e1.get_set_variable_id_and_value()->second == -2);
+  REQUIRE(e2.get_set_variable_id_and_value()->first == id2);
+  REQUIRE(e2.get_set_variable_id_and_value()->second == 2147483647);
+  REQUIRE(e1.get_set_variable()->first == "layer1");
+  REQUIRE(e1.get_set_variable()->second == -2);
+
+  // manipulator_environment
+
+  krbn::event_queue event_queue;
+  event_queue.emplace_back_event(krbn::device_id(1), 100, e1, krbn::event_type::key_down, e1);
+  event_queue.emplace_back_event(krbn::device_id(1), 200, e2, krbn::event_type::key_down, e2);
+
+  REQUIRE(event_queue.get_manipulator_environment().get_variable(id1) == -2);
+  REQUIRE(event_queue.get_manipulator_environment().get_variable("layer2") == 2147483647);
+  REQUIRE(event_queue.get_manipulator_environment().get_variable("layer3") == 0);
+  // get_variable does not intern unknown names.
+  REQUIRE(!krbn::manipulator_environment::find_variable_id("layer3"));
+  REQUIRE(krbn::manipulator_environment::find_variable_id("layer1") == id1);
+  REQUIRE(event_queue.get_manipulator_environment().to_json()["variables"] == nlohmann::json({{"layer1", -2},
+                                                                                              {"layer2", 2147483647}}));
+}
+
 TEST_CASE("emplace_back_event") {
   // Normal order
   {
@@ -383,6 +473,68 @@ TEST_CASE("needs_swap") {
   REQUIRE(krbn::event_queue::needs_swap(right_shift_down, spacebar_up) == false);
 }
 
+TEST_CASE("sort_events") {
+  // Compare with the previous sort algorithm which restarts a bubble pass from the first event.
+
+  auto previous_sort_events = [](std::vector<krbn::event_queue::queued_event>& events) {
+    for (size_t i = 0; i < events.size() - 1;) {
+      if (krbn::event_queue::needs_swap(events[i], events[i + 1])) {
+        std::swap(events[i], events[i + 1]);
+        if (i > 0) {
+          --i;
+        }
+        continue;
+      }
+      ++i;
+    }
+  };
+
+  std::vector<krbn::event_queue::queued_event::event> events{
+      a_event,
+      b_event,
+      escape_event,
+      spacebar_event,
+      left_control_event,
+      left_shift_event,
+      right_control_event,
+      right_shift_event,
+      button2_event,
+      pointing_x_10_event,
+  };
+
+  std::mt19937 engine(1234);
+
+  for (int n = 0; n < 100; ++n) {
+    krbn::event_queue event_queue;
+    std::vector<krbn::event_queue::queued_event> expected;
+    uint64_t time_stamp = 0;
+
+    for (int i = 0; i < 200; ++i) {
+      // Make a lot of events which have the same time stamp.
+      if (engine() % 4 == 0) {
+        ++time_stamp;
+      }
+
+      auto& e = events[engine() % events.size()];
+      auto event_type = e.get_type() == krbn::event_queue::queued_event::event::type::pointing_x
+                            ? krbn::event_type::single
+                            : (engine() % 2 ? krbn::event_type::key_down : krbn::event_type::key_up);
+
+      event_queue.emplace_back_event(krbn::device_id(1), time_stamp, e, event_type, e);
+
+      expected.emplace_back(krbn::device_id(1), time_stamp, e, event_type, e);
+      previous_sort_events(expected);
+
+      if (engine() % 8 == 0) {
+        event_queue.erase_front_event();
+        expected.erase(std::begin(expected));
+      }
+
+      REQUIRE(event_queue.get_events() == expected);
+    }
+  }
+}
+
 TEST_CASE("emplace_back_event.usage_page") {
   krbn::event_queue event_queue;
 
@@ -404,6 +556,65 @@ TEST_CASE("emplace_back_event.usage_page") {
   REQUIRE(event_queue.get_events() == expected);
 }
 
+TEST_CASE("pointing_motion_coalescing") {
+  using type = krbn::event_queue::queued_event::event::type;
+
+  // Disabled
+  {
+    krbn::event_queue event_queue;
+    REQUIRE(event_queue.get_pointing_motion_coalescing_window() == boost::none);
+
+    ENQUEUE_USAGE(event_queue, 1, 100, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 10);
+    ENQUEUE_USAGE(event_queue, 1, 200, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 10);
+    REQUIRE(event_queue.get_events().size() == 2);
+  }
+
+  // Enabled
+  {
+    krbn::event_queue event_queue;
+    event_queue.set_pointing_motion_coalescing_window(uint64_t(1000));
+
+    ENQUEUE_USAGE(event_queue, 1, 100, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 10);
+    ENQUEUE_USAGE(event_queue, 1, 100, kHIDPage_GenericDesktop, kHIDUsage_GD_Y, -10);
+    ENQUEUE_USAGE(event_queue, 1, 200, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 20);
+    ENQUEUE_USAGE(event_queue, 1, 200, kHIDPage_GenericDesktop, kHIDUsage_GD_Y, -20);
+    ENQUEUE_USAGE(event_queue, 1, 200, kHIDPage_GenericDesktop, kHIDUsage_GD_Wheel, 1);
+    ENQUEUE_USAGE(event_queue, 1, 300, kHIDPage_GenericDesktop, kHIDUsage_GD_Wheel, 2);
+    ENQUEUE_USAGE(event_queue, 1, 300, kHIDPage_Consumer, kHIDUsage_Csmr_ACPan, -1);
+
+    // Out of the window
+    ENQUEUE_USAGE(event_queue, 1, 1200, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 1);
+
+    // Button transitions
+    ENQUEUE_USAGE(event_queue, 1, 1300, kHIDPage_Button, 2, 1);
+    ENQUEUE_USAGE(event_queue, 1, 1300, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 1);
+    ENQUEUE_USAGE(event_queue, 1, 1400, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 1);
+    ENQUEUE_USAGE(event_queue, 1, 1500, kHIDPage_Button, 2, 0);
+    ENQUEUE_USAGE(event_queue, 1, 1500, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 1);
+
+    // Other devices
+    ENQUEUE_USAGE(event_queue, 2, 1500, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 1);
+
+    // Overflow (1 + 126 is merged and 127 + 10 is not merged.)
+    ENQUEUE_USAGE(event_queue, 2, 1600, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 126);
+    ENQUEUE_USAGE(event_queue, 2, 1700, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 10);
+
+    std::vector<krbn::event_queue::queued_event> expected;
+    PUSH_BACK_QUEUED_EVENT(expected, 1, 100, krbn::event_queue::queued_event::event(type::pointing_x, 30), single, krbn::event_queue::queued_event::event(type::pointing_x, 30));
+    PUSH_BACK_QUEUED_EVENT(expected, 1, 100, krbn::event_queue::queued_event::event(type::pointing_y, -30), single, krbn::event_queue::queued_event::event(type::pointing_y, -30));
+    PUSH_BACK_QUEUED_EVENT(expected, 1, 200, krbn::event_queue::queued_event::event(type::pointing_vertical_wheel, 3), single, krbn::event_queue::queued_event::event(type::pointing_vertical_wheel, 3));
+    PUSH_BACK_QUEUED_EVENT(expected, 1, 300, krbn::event_queue::queued_event::event(type::pointing_horizontal_wheel, -1), single, krbn::event_queue::queued_event::event(type::pointing_horizontal_wheel, -1));
+    PUSH_BACK_QUEUED_EVENT(expected, 1, 1200, krbn::event_queue::queued_event::event(type::pointing_x, 1), single, krbn::event_queue::queued_event::event(type::pointing_x, 1));
+    PUSH_BACK_QUEUED_EVENT(expected, 1, 1300, button2_event, key_down, button2_event);
+    PUSH_BACK_QUEUED_EVENT(expected, 1, 1300, krbn::event_queue::queued_event::event(type::pointing_x, 2), single, krbn::event_queue::queued_event::event(type::pointing_x, 2));
+    PUSH_BACK_QUEUED_EVENT(expected, 1, 1500, button2_event, key_up, button2_event);
+    PUSH_BACK_QUEUED_EVENT(expected, 1, 1500, krbn::event_queue::queued_event::event(type::pointing_x, 1), single, krbn::event_queue::queued_event::event(type::pointing_x, 1));
+    PUSH_BACK_QUEUED_EVENT(expected, 2, 1500, krbn::event_queue::queued_event::event(type::pointing_x, 127), single, krbn::event_queue::queued_event::event(type::pointing_x, 127));
+    PUSH_BACK_QUEUED_EVENT(expected, 2, 1700, krbn::event_queue::queued_event::event(type::pointing_x, 10), single, krbn::event_queue::queued_event::event(type::pointing_x, 10));
+    REQUIRE(event_queue.get_events() == expected);
+  }
+}
+
 TEST_CASE("increase_time_stamp_delay") {
   {
     krbn::event_queue event_queue;
@@ -5,6 +5,7 @@
 #include "manipulator/details/post_event_to_virtual_devices.hpp"
 #include "thread_utility.hpp"
 #include <boost/optional/optional_io.hpp>
+#include <random>
 
 using krbn::manipulator::details::event_definition;
 using krbn::manipulator::details::from_event_definition;
@@ -84,12 +85,12 @@ TEST_CASE("manipulator_timer") {
   REQUIRE(krbn::manipulator::manipulator_timer::get_instance().get_entries().empty());
 
   std::vector<krbn::manipulator::manipulator_timer::timer_id> timer_ids;
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(1234));
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(1234));
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(5678));
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(5678));
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(2345));
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(2345));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(1234, nullptr));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(1234, nullptr));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(5678, nullptr));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(5678, nullptr));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(2345, nullptr));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(2345, nullptr));
 
   REQUIRE(krbn::manipulator::manipulator_timer::get_instance().get_entries().size() == 6);
   REQUIRE(krbn::manipulator::manipulator_timer::get_instance().get_entries()[0].get_when() == 1234);
@@ -133,6 +134,179 @@ TEST_CASE("needs_virtual_hid_pointing") {
   }
 }
 
+namespace {
+// The previous `manipulator_manager::manipulate` which calls all manipulators for each event.
+void manipulate_linearly(const std::vector<std::shared_ptr<krbn::manipulator::details::base>>& manipulators,
+                         krbn::event_queue& input_event_queue,
+                         const std::shared_ptr<krbn::event_queue>& output_event_queue) {
+  while (!input_event_queue.empty()) {
+    auto& front_input_event = input_event_queue.get_front_event();
+
+    for (auto&& m : manipulators) {
+      m->manipulate(front_input_event,
+                    input_event_queue,
+                    output_event_queue);
+    }
+
+    if (input_event_queue.get_front_event().get_valid()) {
+      output_event_queue->push_back_event(input_event_queue.get_front_event());
+    }
+
+    input_event_queue.erase_front_event();
+  }
+}
+
+nlohmann::json make_random_manipulator_json(std::mt19937& engine) {
+  std::vector<std::string> key_codes({"a", "b", "c", "spacebar", "left_shift", "tab"});
+  std::uniform_int_distribution<size_t> key_code_distribution(0, key_codes.size() - 1);
+  std::uniform_int_distribution<int> percent_distribution(0, 99);
+
+  nlohmann::json from;
+  if (percent_distribution(engine) < 10) {
+    from["any"] = "key_code";
+  } else {
+    from["key_code"] = key_codes[key_code_distribution(engine)];
+  }
+  if (percent_distribution(engine) < 30) {
+    from["modifiers"]["mandatory"] = nlohmann::json::array({"shift"});
+  }
+  if (percent_distribution(engine) < 50) {
+    from["modifiers"]["optional"] = nlohmann::json::array({"any"});
+  }
+
+  nlohmann::json json;
+  json["type"] = "basic";
+  json["from"] = from;
+  json["to"] = nlohmann::json::array({{{"key_code", key_codes[key_code_distribution(engine)]}}});
+  if (percent_distribution(engine) < 30) {
+    json["to_if_alone"] = nlohmann::json::array({{{"key_code", key_codes[key_code_distribution(engine)]}}});
+  }
+  if (percent_distribution(engine) < 10) {
+    json["to_delayed_action"]["to_canceled"] = nlohmann::json::array({{{"key_code", key_codes[key_code_distribution(engine)]}}});
+  }
+  return json;
+}
+} // namespace
+
+TEST_CASE("manipulator_manager.dispatch_table") {
+  // Compare `manipulator_manager::manipulate` with calling all manipulators.
+
+  std::mt19937 engine(1234);
+
+  std::vector<krbn::key_code> key_codes({
+      krbn::key_code::a,
+      krbn::key_code::b,
+      krbn::key_code::c,
+      krbn::key_code::spacebar,
+      krbn::key_code::left_shift,
+      krbn::key_code::tab,
+  });
+  std::uniform_int_distribution<size_t> key_code_distribution(0, key_codes.size() - 1);
+
+  for (int i = 0; i < 20; ++i) {
+    krbn::core_configuration::profile::complex_modifications::parameters parameters;
+    krbn::manipulator::manipulator_manager manager;
+    std::vector<std::shared_ptr<krbn::manipulator::details::base>> manipulators;
+
+    for (int j = 0; j < 50; ++j) {
+      auto json = make_random_manipulator_json(engine);
+      manager.push_back_manipulator(json, parameters);
+      manipulators.push_back(krbn::manipulator::manipulator_factory::make_manipulator(json, parameters));
+    }
+
+    auto input_event_queue = std::make_shared<krbn::event_queue>();
+    auto output_event_queue = std::make_shared<krbn::event_queue>();
+    krbn::event_queue expected_input_event_queue;
+    auto expected_output_event_queue = std::make_shared<krbn::event_queue>();
+
+    std::vector<krbn::key_code> pressed_keys;
+    uint64_t time_stamp = 0;
+
+    for (int j = 0; j < 200; ++j) {
+      auto key_code = key_codes[key_code_distribution(engine)];
+      auto it = std::find(std::begin(pressed_keys), std::end(pressed_keys), key_code);
+      auto event_type = krbn::event_type::key_down;
+      if (it == std::end(pressed_keys)) {
+        pressed_keys.push_back(key_code);
+      } else {
+        pressed_keys.erase(it);
+        event_type = krbn::event_type::key_up;
+      }
+
+      krbn::event_queue::queued_event::event event(key_code);
+      time_stamp += 100 * 1000 * 1000;
+      input_event_queue->emplace_back_event(krbn::device_id(1), time_stamp, event, event_type, event);
+      expected_input_event_queue.emplace_back_event(krbn::device_id(1), time_stamp, event, event_type, event);
+
+      manager.manipulate(input_event_queue, output_event_queue);
+      manipulate_linearly(manipulators, expected_input_event_queue, expected_output_event_queue);
+
+      REQUIRE(output_event_queue->get_events() == expected_output_event_queue->get_events());
+    }
+  }
+}
+
+TEST_CASE("basic::manipulated_original_events") {
+  // Compare with a vector and `std::find_if` (the oldest entry is found first).
+
+  std::mt19937 engine(1234);
+  std::uniform_int_distribution<int> device_id_distribution(1, 3);
+  std::uniform_int_distribution<int> key_code_distribution(0, 40);
+  std::uniform_int_distribution<int> operation_distribution(0, 99);
+
+  krbn::manipulator::details::basic::manipulated_original_events manipulated_original_events;
+  std::vector<krbn::manipulator::details::basic::manipulated_original_event> expected;
+
+  for (uint64_t time_stamp = 0; time_stamp < 20000; ++time_stamp) {
+    auto device_id = krbn::device_id(device_id_distribution(engine));
+    krbn::event_queue::queued_event::event event(krbn::key_code(static_cast<uint32_t>(krbn::key_code::a) + key_code_distribution(engine)));
+    auto operation = operation_distribution(engine);
+
+    if (operation < 55) {
+      // key_down (Same keys might be pressed twice.)
+      manipulated_original_events.emplace_back(device_id, event, krbn::modifier_flag_set(), time_stamp);
+      expected.emplace_back(device_id, event, krbn::modifier_flag_set(), time_stamp);
+
+    } else if (operation < 99) {
+      // key_up
+      auto actual = manipulated_original_events.take(device_id, event);
+      auto it = std::find_if(std::begin(expected),
+                             std::end(expected),
+                             [&](const auto& e) {
+                               return e.get_device_id() == device_id &&
+                                      e.get_original_event() == event;
+                             });
+      if (it == std::end(expected)) {
+        REQUIRE(!actual);
+      } else {
+        REQUIRE(actual);
+        REQUIRE(actual->get_key_down_time_stamp() == it->get_key_down_time_stamp());
+        expected.erase(it);
+      }
+
+    } else {
+      // device_ungrabbed
+      manipulated_original_events.erase_if([&](const auto& e) {
+        return e.get_device_id() == device_id;
+      });
+      expected.erase(std::remove_if(std::begin(expected),
+                                    std::end(expected),
+                                    [&](const auto& e) {
+                                      return e.get_device_id() == device_id;
+                                    }),
+                     std::end(expected));
+    }
+
+    REQUIRE(manipulated_original_events.size() == expected.size());
+  }
+
+  size_t count = 0;
+  manipulated_original_events.for_each([&](auto& e) {
+    ++count;
+  });
+  REQUIRE(count == expected.size());
+}
+
 int main(int argc, char* const argv[]) {
   krbn::thread_utility::register_main_thread();
   return Catch::Session().run(argc, argv);
@@ -0,0 +1,277 @@
+#define CATCH_CONFIG_RUNNER
+#include "../../vendor/catch/catch.hpp"
+
+#include "manipulator/details/post_event_to_virtual_devices.hpp"
+#include "manipulator/manipulator_managers_connector.hpp"
+#include "thread_utility.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+// Count global operator new calls while `counting` is set.
+std::atomic<bool> counting(false);
+std::atomic<size_t> allocation_count(0);
+
+class allocation_counter final {
+public:
+  allocation_counter(void) {
+    allocation_count = 0;
+    counting = true;
+  }
+
+  ~allocation_counter(void) {
+    counting = false;
+  }
+
+  size_t get_count(void) const {
+    return allocation_count;
+  }
+};
+} // namespace
+
+void* operator new(size_t size) {
+  if (counting) {
+    ++allocation_count;
+  }
+  if (auto p = std::malloc(size > 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+namespace {
+class pipeline final {
+public:
+  pipeline(void) : merged_input_event_queue_(std::make_shared<krbn::event_queue>()),
+                   simple_modifications_applied_event_queue_(std::make_shared<krbn::event_queue>()),
+                   complex_modifications_applied_event_queue_(std::make_shared<krbn::event_queue>()),
+                   posted_event_queue_(std::make_shared<krbn::event_queue>()),
+                   post_event_to_virtual_devices_manipulator_(std::make_shared<krbn::manipulator::details::post_event_to_virtual_devices>()),
+                   time_stamp_(1000) {
+    krbn::core_configuration::profile::complex_modifications::parameters parameters;
+
+    // caps_lock -> left_control
+    simple_modifications_manipulator_manager_.push_back_manipulator(nlohmann::json::parse(R"(
+      {
+        "type": "basic",
+        "from": {"key_code": "caps_lock", "modifiers": {"optional": ["any"]}},
+        "to": [{"key_code": "left_control"}]
+      }
+    )"),
+                                                                    parameters);
+
+    // control-h -> delete_or_backspace
+    complex_modifications_manipulator_manager_.push_back_manipulator(nlohmann::json::parse(R"(
+      {
+        "type": "basic",
+        "from": {"key_code": "h", "modifiers": {"mandatory": ["control"]}},
+        "to": [{"key_code": "delete_or_backspace"}]
+      }
+    )"),
+                                                                     parameters);
+
+    // spacebar -> left_shift (spacebar if alone)
+    complex_modifications_manipulator_manager_.push_back_manipulator(nlohmann::json::parse(R"(
+      {
+        "type": "basic",
+        "from": {"key_code": "spacebar", "modifiers": {"optional": ["any"]}},
+        "to": [{"key_code": "left_shift"}],
+        "to_if_alone": [{"key_code": "spacebar"}]
+      }
+    )"),
+                                                                     parameters);
+
+    // a -> command-tab
+    complex_modifications_manipulator_manager_.push_back_manipulator(nlohmann::json::parse(R"(
+      {
+        "type": "basic",
+        "from": {"key_code": "a"},
+        "to": [{"key_code": "tab", "modifiers": ["left_command"]}]
+      }
+    )"),
+                                                                     parameters);
+
+    // t -> t_pressed variable
+    complex_modifications_manipulator_manager_.push_back_manipulator(nlohmann::json::parse(R"(
+      {
+        "type": "basic",
+        "from": {"key_code": "t"},
+        "to": [{"set_variable": {"name": "t_pressed", "value": 1}}],
+        "to_after_key_up": [{"set_variable": {"name": "t_pressed", "value": 0}}]
+      }
+    )"),
+                                                                     parameters);
+
+    post_event_to_virtual_devices_manipulator_manager_.push_back_manipulator(std::shared_ptr<krbn::manipulator::details::base>(post_event_to_virtual_devices_manipulator_));
+
+    connector_.emplace_back_connection(simple_modifications_manipulator_manager_,
+                                       merged_input_event_queue_,
+                                       simple_modifications_applied_event_queue_);
+    connector_.emplace_back_connection(complex_modifications_manipulator_manager_,
+                                       complex_modifications_applied_event_queue_);
+    connector_.emplace_back_connection(post_event_to_virtual_devices_manipulator_manager_,
+                                       posted_event_queue_);
+  }
+
+  void key(krbn::key_code key_code, krbn::event_type event_type) {
+    krbn::event_queue::queued_event::event event(key_code);
+    merged_input_event_queue_->emplace_back_event(krbn::device_id(1),
+                                                  time_stamp_++,
+                                                  event,
+                                                  event_type,
+                                                  event);
+    manipulate();
+  }
+
+  void type_sequence(void) {
+    // control-h (caps_lock as control)
+    key(krbn::key_code::caps_lock, krbn::event_type::key_down);
+    key(krbn::key_code::h, krbn::event_type::key_down);
+    key(krbn::key_code::h, krbn::event_type::key_up);
+    key(krbn::key_code::caps_lock, krbn::event_type::key_up);
+
+    // spacebar alone
+    key(krbn::key_code::spacebar, krbn::event_type::key_down);
+    key(krbn::key_code::spacebar, krbn::event_type::key_up);
+
+    // shift-b via spacebar
+    key(krbn::key_code::spacebar, krbn::event_type::key_down);
+    key(krbn::key_code::b, krbn::event_type::key_down);
+    key(krbn::key_code::b, krbn::event_type::key_up);
+    key(krbn::key_code::spacebar, krbn::event_type::key_up);
+
+    // a -> command-tab
+    key(krbn::key_code::a, krbn::event_type::key_down);
+    key(krbn::key_code::a, krbn::event_type::key_up);
+  }
+
+  void toggle_variable(void) {
+    key(krbn::key_code::t, krbn::event_type::key_down);
+    key(krbn::key_code::t, krbn::event_type::key_up);
+  }
+
+  void enable_manipulator_environment_json_output(const std::string& file_path,
+                                                  std::chrono::milliseconds interval) {
+    complex_modifications_applied_event_queue_->enable_manipulator_environment_json_output(file_path, interval);
+  }
+
+  const krbn::manipulator_environment& get_manipulator_environment(void) const {
+    return complex_modifications_applied_event_queue_->get_manipulator_environment();
+  }
+
+  size_t get_posted_events_size(void) const {
+    return post_event_to_virtual_devices_manipulator_->get_queue().get_events().size();
+  }
+
+  void clear_posted_events(void) {
+    post_event_to_virtual_devices_manipulator_->clear_queue();
+  }
+
+private:
+  void manipulate(void) {
+    connector_.manipulate();
+
+    // `device_grabber` posts the queue to virtual_hid_device_client here.
+    posted_event_queue_->clear_events();
+  }
+
+  std::shared_ptr<krbn::event_queue> merged_input_event_queue_;
+  std::shared_ptr<krbn::event_queue> simple_modifications_applied_event_queue_;
+  std::shared_ptr<krbn::event_queue> complex_modifications_applied_event_queue_;
+  std::shared_ptr<krbn::event_queue> posted_event_queue_;
+  krbn::manipulator::manipulator_manager simple_modifications_manipulator_manager_;
+  krbn::manipulator::manipulator_manager complex_modifications_manipulator_manager_;
+  std::shared_ptr<krbn::manipulator::details::post_event_to_virtual_devices> post_event_to_virtual_devices_manipulator_;
+  krbn::manipulator::manipulator_manager post_event_to_virtual_devices_manipulator_manager_;
+  krbn::manipulator::manipulator_managers_connector connector_;
+  uint64_t time_stamp_;
+};
+} // namespace
+
+TEST_CASE("allocation_counter") {
+  size_t count = 0;
+  {
+    allocation_counter counter;
+    auto p = ::operator new(16);
+    count = counter.get_count();
+    ::operator delete(p);
+  }
+  REQUIRE(count == 1);
+}
+
+TEST_CASE("steady state") {
+  pipeline pipeline;
+
+  // Warm up (interned values, vector capacities)
+
+  for (int i = 0; i < 4; ++i) {
+    pipeline.type_sequence();
+    pipeline.clear_posted_events();
+  }
+
+  size_t count = 0;
+  size_t posted_events_size = 0;
+  {
+    allocation_counter counter;
+
+    for (int i = 0; i < 100; ++i) {
+      pipeline.type_sequence();
+      posted_events_size += pipeline.get_posted_events_size();
+      pipeline.clear_posted_events();
+    }
+
+    count = counter.get_count();
+  }
+
+  REQUIRE(posted_events_size > 0);
+  REQUIRE(count == 0);
+}
+
+TEST_CASE("json output") {
+  // The json file is written by the device_grabber pipeline.
+  // Toggling variables must not copy the environment for each change.
+
+  pipeline pipeline;
+  // Use a long interval in order not to write the file (and allocate in the writer thread) while counting.
+  pipeline.enable_manipulator_environment_json_output("tmp/manipulator_environment.json",
+                                                      std::chrono::hours(1));
+
+  for (int i = 0; i < 4; ++i) {
+    pipeline.toggle_variable();
+    pipeline.clear_posted_events();
+  }
+
+  size_t count = 0;
+  {
+    allocation_counter counter;
+
+    for (int i = 0; i < 100; ++i) {
+      pipeline.toggle_variable();
+      pipeline.clear_posted_events();
+    }
+
+    count = counter.get_count();
+  }
+
+  REQUIRE(pipeline.get_manipulator_environment().get_variable("t_pressed") == 0);
+  REQUIRE(count == 0);
+
+  auto writer = pipeline.get_manipulator_environment().get_json_file_writer();
+  REQUIRE(writer);
+  writer->flush();
+  REQUIRE(writer->get_write_count() == 1);
+}
+
+int main(int argc, char* const argv[]) {
+  krbn::thread_utility::register_main_thread();
+  return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,259 @@
+#define CATCH_CONFIG_RUNNER
+#include "../../vendor/catch/catch.hpp"
+
+#include "manipulator/manipulator_cache.hpp"
+#include "manipulator/manipulator_manager.hpp"
+#include "manipulator/profile_manipulators_builder.hpp"
+#include "thread_utility.hpp"
+
+namespace {
+nlohmann::json make_json(const std::string& from, const std::string& to) {
+  return nlohmann::json::parse(R"({"type": "basic", "from": {"key_code": ")" + from + R"("}, "to": [{"key_code": ")" + to + R"("}]})");
+}
+
+class factory final {
+public:
+  factory(void) : count_(0) {
+  }
+
+  std::function<std::shared_ptr<krbn::manipulator::details::base>(void)> make(const nlohmann::json& json) {
+    return [this, json] {
+      ++count_;
+      krbn::core_configuration::profile::complex_modifications::parameters parameters;
+      return krbn::manipulator::manipulator_factory::make_manipulator(json, parameters);
+    };
+  }
+
+  size_t get_count(void) const {
+    return count_;
+  }
+
+private:
+  size_t count_;
+};
+
+void push_back_key_event(krbn::event_queue& event_queue,
+                         uint64_t time_stamp,
+                         krbn::key_code key_code,
+                         krbn::event_type event_type) {
+  krbn::event_queue::queued_event::event event(key_code);
+  event_queue.emplace_back_event(krbn::device_id(1),
+                                 time_stamp,
+                                 event,
+                                 event_type,
+                                 event);
+}
+
+std::vector<std::pair<krbn::key_code, krbn::event_type>> get_key_events(const krbn::event_queue& event_queue) {
+  std::vector<std::pair<krbn::key_code, krbn::event_type>> result;
+  for (const auto& e : event_queue.get_events()) {
+    if (auto key_code = e.get_event().get_key_code()) {
+      result.emplace_back(*key_code, e.get_event_type());
+    }
+  }
+  return result;
+}
+} // namespace
+
+TEST_CASE("find_or_make") {
+  krbn::manipulator::manipulator_cache cache;
+  factory factory;
+
+  auto json_a = make_json("a", "b");
+  auto json_c = make_json("c", "d");
+
+  auto a1 = cache.find_or_make(json_a, factory.make(json_a));
+  auto c1 = cache.find_or_make(json_c, factory.make(json_c));
+  // Same json in the same generation
+  auto a2 = cache.find_or_make(json_a, factory.make(json_a));
+  cache.commit();
+
+  REQUIRE(factory.get_count() == 3);
+  REQUIRE(a1 != a2);
+  REQUIRE(cache.size() == 3);
+
+  // Reuse
+
+  auto a3 = cache.find_or_make(json_a, factory.make(json_a));
+  auto a4 = cache.find_or_make(json_a, factory.make(json_a));
+  cache.commit();
+
+  REQUIRE(factory.get_count() == 3);
+  REQUIRE((a3 == a1 || a3 == a2));
+  REQUIRE((a4 == a1 || a4 == a2));
+  REQUIRE(a3 != a4);
+  REQUIRE(cache.size() == 2);
+  REQUIRE(cache.get_stats().reused_count == 2);
+  REQUIRE(cache.get_stats().made_count == 3);
+
+  // `c1` is dropped by the last commit.
+
+  auto c2 = cache.find_or_make(json_c, factory.make(json_c));
+  cache.commit();
+
+  REQUIRE(factory.get_count() == 4);
+  REQUIRE(c1 != c2);
+
+  // Dropped manipulators are not released in `commit`.
+
+  {
+    std::weak_ptr<krbn::manipulator::details::base> weak_c1 = c1;
+    c1 = nullptr;
+    REQUIRE(!weak_c1.expired());
+
+    auto dropped = cache.take_dropped_manipulators();
+    REQUIRE(dropped.size() == 3);
+    REQUIRE(cache.take_dropped_manipulators().empty());
+
+    dropped.clear();
+    REQUIRE(weak_c1.expired());
+  }
+
+  // Object key order does not matter.
+
+  auto c3 = cache.find_or_make(nlohmann::json::parse(R"({"to": [{"key_code": "d"}], "from": {"key_code": "c"}, "type": "basic"})"),
+                               factory.make(json_c));
+  cache.commit();
+
+  REQUIRE(factory.get_count() == 4);
+  REQUIRE(c3 == c2);
+
+  // Invalidated manipulators are not reused.
+
+  c3->set_valid(false);
+  auto c4 = cache.find_or_make(json_c, factory.make(json_c));
+  cache.commit();
+
+  REQUIRE(factory.get_count() == 5);
+  REQUIRE(c4 != c3);
+
+  // rollback
+
+  auto json_e = make_json("e", "f");
+  auto c5 = cache.find_or_make(json_c, factory.make(json_c));
+  cache.find_or_make(json_e, factory.make(json_e));
+  cache.rollback();
+
+  REQUIRE(factory.get_count() == 6);
+  REQUIRE(c5 == c4);
+  REQUIRE(cache.size() == 2);
+
+  auto c6 = cache.find_or_make(json_c, factory.make(json_c));
+  cache.commit();
+
+  REQUIRE(factory.get_count() == 6);
+  REQUIRE(c6 == c4);
+  REQUIRE(cache.size() == 1);
+
+  // clear
+
+  cache.take_dropped_manipulators();
+  cache.clear();
+  REQUIRE(cache.size() == 0);
+  REQUIRE(cache.take_dropped_manipulators() == std::vector<std::shared_ptr<krbn::manipulator::details::base>>({c6}));
+}
+
+TEST_CASE("profile_manipulators_builder") {
+  auto core_configuration = std::make_shared<krbn::core_configuration>("../core_configuration/json/example.json");
+  krbn::manipulator::profile_manipulators_builder builder;
+
+  auto snapshot1 = builder.build(core_configuration);
+  REQUIRE(snapshot1);
+  REQUIRE(!snapshot1->get_complex_modifications_manipulators().empty());
+
+  // A canceled build returns nullptr and keeps the cache.
+
+  REQUIRE(!builder.build(core_configuration, [] { return true; }));
+
+  auto snapshot2 = builder.build(core_configuration, [] { return false; });
+  REQUIRE(snapshot2);
+  REQUIRE(snapshot2->get_complex_modifications_manipulators() == snapshot1->get_complex_modifications_manipulators());
+  REQUIRE(snapshot2->get_simple_modifications_manipulators() == snapshot1->get_simple_modifications_manipulators());
+  REQUIRE(snapshot2->get_dropped_manipulators().empty());
+
+  // Manipulators which are dropped by `build` are kept by the snapshot.
+
+  std::weak_ptr<krbn::manipulator::details::base> weak_manipulator = snapshot1->get_complex_modifications_manipulators().front();
+  snapshot1 = nullptr;
+  snapshot2 = nullptr;
+
+  // to_json_default.json has no rules.
+  auto snapshot3 = builder.build(std::make_shared<krbn::core_configuration>("../core_configuration/json/to_json_default.json"));
+  REQUIRE(snapshot3);
+  REQUIRE(snapshot3->get_complex_modifications_manipulators().empty());
+  REQUIRE(!snapshot3->get_dropped_manipulators().empty());
+  REQUIRE(!weak_manipulator.expired());
+
+  snapshot3 = nullptr;
+  REQUIRE(weak_manipulator.expired());
+}
+
+TEST_CASE("replace_manipulators") {
+  krbn::manipulator::manipulator_cache cache;
+  krbn::manipulator::manipulator_manager manager;
+  factory factory;
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  auto output_event_queue = std::make_shared<krbn::event_queue>();
+
+  auto json_a = make_json("a", "b");
+  auto json_c = make_json("c", "d");
+  auto json_e = make_json("e", "f");
+
+  auto update = [&](const std::vector<nlohmann::json>& jsons) {
+    std::vector<std::shared_ptr<krbn::manipulator::details::base>> manipulators;
+    for (const auto& j : jsons) {
+      manipulators.push_back(cache.find_or_make(j, factory.make(j)));
+    }
+    cache.commit();
+    manager.replace_manipulators(manipulators);
+  };
+
+  update({json_a, json_c});
+  REQUIRE(manager.get_manipulators_size() == 2);
+
+  // Hold a and c.
+
+  push_back_key_event(*input_event_queue, 100, krbn::key_code::a, krbn::event_type::key_down);
+  push_back_key_event(*input_event_queue, 200, krbn::key_code::c, krbn::event_type::key_down);
+  manager.manipulate(input_event_queue, output_event_queue);
+
+  // Remove `c -> d` and add `e -> f` while keys are held.
+
+  auto a = manager.get_manipulators()[0];
+  auto c = manager.get_manipulators()[1];
+
+  update({json_e, json_a});
+  REQUIRE(factory.get_count() == 3);
+
+  // The active `c -> d` manipulator is kept until c is released.
+  REQUIRE(manager.get_manipulators().size() == 3);
+  REQUIRE(manager.get_manipulators()[0] == c);
+  REQUIRE(manager.get_manipulators()[2] == a);
+  REQUIRE(!c->get_valid());
+  REQUIRE(a->get_valid());
+
+  // The reused manipulator keeps its state.
+
+  push_back_key_event(*input_event_queue, 300, krbn::key_code::a, krbn::event_type::key_up);
+  push_back_key_event(*input_event_queue, 400, krbn::key_code::c, krbn::event_type::key_up);
+  push_back_key_event(*input_event_queue, 500, krbn::key_code::e, krbn::event_type::key_down);
+  push_back_key_event(*input_event_queue, 600, krbn::key_code::e, krbn::event_type::key_up);
+  manager.manipulate(input_event_queue, output_event_queue);
+
+  std::vector<std::pair<krbn::key_code, krbn::event_type>> expected({
+      {krbn::key_code::b, krbn::event_type::key_down},
+      {krbn::key_code::d, krbn::event_type::key_down},
+      {krbn::key_code::b, krbn::event_type::key_up},
+      {krbn::key_code::d, krbn::event_type::key_up},
+      {krbn::key_code::f, krbn::event_type::key_down},
+      {krbn::key_code::f, krbn::event_type::key_up},
+  });
+  REQUIRE(get_key_events(*output_event_queue) == expected);
+
+  REQUIRE(manager.get_manipulators().size() == 2);
+}
+
+int main(int argc, char* const argv[]) {
+  krbn::thread_utility::register_main_thread();
+  return Catch::Session().run(argc, argv);
+}
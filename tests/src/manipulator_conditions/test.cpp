@@ -4,7 +4,10 @@
 #include "manipulator/condition_manager.hpp"
 #include "manipulator/manipulator_factory.hpp"
 #include "thread_utility.hpp"
+#include <atomic>
 #include <boost/optional/optional_io.hpp>
+#include <deque>
+#include <thread>
 
 TEST_CASE("manipulator.manipulator_factory") {
   {
@@ -311,6 +314,309 @@ TEST_CASE("conditions.device") {
 #undef QUEUED_EVENT
 }
 
+TEST_CASE("conditions.device (hotplug)") {
+  // Devices are attached and detached in a thread while device conditions are evaluated in another thread.
+
+  krbn::manipulator_environment manipulator_environment;
+  krbn::manipulator::details::conditions::device condition(krbn::device_identifiers(krbn::vendor_id(1000),
+                                                                                    krbn::product_id(2000),
+                                                                                    true,
+                                                                                    false));
+
+  auto make_queued_event = [](krbn::device_id device_id) {
+    return krbn::event_queue::queued_event(device_id,
+                                           0,
+                                           krbn::event_queue::queued_event::event(krbn::key_code::a),
+                                           krbn::event_type::key_down,
+                                           krbn::event_queue::queued_event::event(krbn::key_code::a));
+  };
+
+  // (device_id, expected result)
+  std::vector<std::pair<krbn::device_id, bool>> stable_devices;
+  for (int i = 0; i < 4; ++i) {
+    auto product_id = (i % 2 == 0 ? krbn::product_id(2000) : krbn::product_id(2001));
+    stable_devices.emplace_back(krbn::types::make_new_device_id(krbn::vendor_id(1000), product_id, true, false),
+                                product_id == krbn::product_id(2000));
+  }
+
+  // (device_id << 32) | product_id of the last attached device.
+  std::atomic<uint64_t> last_attached(0);
+  std::atomic<bool> exit(false);
+
+  std::thread hotplug_thread([&] {
+    std::deque<krbn::device_id> attached_device_ids;
+    uint32_t count = 0;
+
+    while (!exit) {
+      uint32_t product_id = (count % 2 == 0 ? 2000 : 2001);
+      auto device_id = krbn::types::make_new_device_id(krbn::vendor_id(1000), krbn::product_id(product_id), true, false);
+      last_attached = (static_cast<uint64_t>(device_id) << 32) | product_id;
+
+      attached_device_ids.push_back(device_id);
+      if (attached_device_ids.size() > 8) {
+        krbn::types::detach_device_id(attached_device_ids.front());
+        attached_device_ids.pop_front();
+      }
+
+      ++count;
+    }
+
+    for (const auto& device_id : attached_device_ids) {
+      krbn::types::detach_device_id(device_id);
+    }
+  });
+
+  size_t errors = 0;
+  size_t found_count = 0;
+
+  for (int i = 0; i < 1000000; ++i) {
+    // Alternate devices in order to avoid cached_result.
+    const auto& pair = stable_devices[i % stable_devices.size()];
+    if (condition.is_fulfilled(make_queued_event(pair.first), manipulator_environment) != pair.second) {
+      ++errors;
+    }
+
+    if (auto v = last_attached.load()) {
+      auto device_id = krbn::device_id(static_cast<uint32_t>(v >> 32));
+      auto product_id = krbn::product_id(static_cast<uint32_t>(v));
+
+      // The device might be already detached.
+      if (auto di = krbn::types::find_device_identifiers(device_id)) {
+        ++found_count;
+        if (di->get_vendor_id() != krbn::vendor_id(1000) ||
+            di->get_product_id() != product_id) {
+          ++errors;
+        }
+      }
+
+      if (condition.is_fulfilled(make_queued_event(device_id), manipulator_environment) &&
+          product_id != krbn::product_id(2000)) {
+        ++errors;
+      }
+    }
+  }
+
+  exit = true;
+  hotplug_thread.join();
+
+  REQUIRE(errors == 0);
+  REQUIRE(found_count > 0);
+
+  for (const auto& pair : stable_devices) {
+    REQUIRE(krbn::types::find_device_identifiers(pair.first));
+    krbn::types::detach_device_id(pair.first);
+    REQUIRE(!krbn::types::find_device_identifiers(pair.first));
+  }
+}
+
+TEST_CASE("conditions.cached_result") {
+  krbn::manipulator_environment manipulator_environment1;
+  krbn::manipulator_environment manipulator_environment2;
+
+  // generation
+
+  {
+    REQUIRE(manipulator_environment1.get_generation() != manipulator_environment2.get_generation());
+
+    auto generation = manipulator_environment1.get_generation();
+    manipulator_environment1.set_frontmost_application({"com.apple.Terminal",
+                                                        "/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal"});
+    REQUIRE(manipulator_environment1.get_generation() > generation);
+
+    generation = manipulator_environment1.get_generation();
+    manipulator_environment1.set_input_source_identifiers({std::string("en"),
+                                                           std::string("com.apple.keylayout.US"),
+                                                           boost::none});
+    REQUIRE(manipulator_environment1.get_generation() > generation);
+
+    generation = manipulator_environment1.get_generation();
+    manipulator_environment1.set_variable("variable1", 1);
+    REQUIRE(manipulator_environment1.get_generation() > generation);
+
+    generation = manipulator_environment1.get_generation();
+    manipulator_environment1.get_variable("variable1");
+    REQUIRE(manipulator_environment1.get_generation() == generation);
+  }
+
+  auto device_id_1000_2000 = krbn::types::make_new_device_id(krbn::vendor_id(1000), krbn::product_id(2000), true, false);
+  auto device_id_1000_2001 = krbn::types::make_new_device_id(krbn::vendor_id(1000), krbn::product_id(2001), true, false);
+
+#define QUEUED_EVENT(DEVICE_ID)                                                              \
+  krbn::event_queue::queued_event(DEVICE_ID,                                                 \
+                                  0,                                                         \
+                                  krbn::event_queue::queued_event::event(krbn::key_code::a), \
+                                  krbn::event_type::key_down,                                \
+                                  krbn::event_queue::queued_event::event(krbn::key_code::a))
+
+  // variable
+
+  {
+    auto condition = krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+        {"type", "variable_if"},
+        {"name", "variable1"},
+        {"value", 1},
+    }));
+
+    REQUIRE(condition->is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment1) == true);
+    REQUIRE(condition->is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment1) == true);
+    REQUIRE(condition->is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment2) == false);
+    REQUIRE(condition->is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment1) == true);
+
+    manipulator_environment1.set_variable("variable1", 0);
+    REQUIRE(condition->is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment1) == false);
+
+    manipulator_environment1.set_variable("variable1", 1);
+    REQUIRE(condition->is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment1) == true);
+  }
+
+  // frontmost_application
+
+  {
+    auto condition = krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+        {"type", "frontmost_application_if"},
+        {"bundle_identifiers", {"^com\\.apple\\.Terminal$"}},
+    }));
+
+    REQUIRE(condition->is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment1) == true);
+    REQUIRE(condition->is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment2) == false);
+
+    manipulator_environment1.set_frontmost_application({"com.googlecode.iterm2",
+                                                        "/Applications/iTerm.app"});
+    REQUIRE(condition->is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment1) == false);
+
+    // Changing a variable does not change the result.
+    manipulator_environment1.set_variable("variable2", 1);
+    REQUIRE(condition->is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment1) == false);
+  }
+
+  // device
+
+  {
+    krbn::manipulator::details::conditions::device condition(krbn::device_identifiers(krbn::vendor_id(1000),
+                                                                                      krbn::product_id(2000),
+                                                                                      true,
+                                                                                      false));
+
+    REQUIRE(condition.is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment1) == true);
+    REQUIRE(condition.is_fulfilled(QUEUED_EVENT(device_id_1000_2001), manipulator_environment1) == false);
+    REQUIRE(condition.is_fulfilled(QUEUED_EVENT(device_id_1000_2001), manipulator_environment1) == false);
+    REQUIRE(condition.is_fulfilled(QUEUED_EVENT(device_id_1000_2000), manipulator_environment1) == true);
+  }
+
+#undef QUEUED_EVENT
+}
+
+TEST_CASE("condition_manager") {
+  krbn::manipulator::condition_manager condition_manager;
+  condition_manager.push_back_condition(krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+      {"type", "input_source_if"},
+      {"input_sources", {{{"language", "^en$"}}}},
+  })));
+  condition_manager.push_back_condition(krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+      {"type", "frontmost_application_if"},
+      {"bundle_identifiers", {"^com\\.apple\\.Terminal$"}},
+  })));
+  condition_manager.push_back_condition(krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+      {"type", "variable_if"},
+      {"name", "variable1"},
+      {"value", 1},
+  })));
+  condition_manager.push_back_condition(krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+      {"type", "variable_unless"},
+      {"name", "variable2"},
+      {"value", 1},
+  })));
+
+  // Sorted by cost. (variables keep the pushed order.)
+
+  const auto& conditions = condition_manager.get_conditions();
+  REQUIRE(conditions.size() == 4);
+  REQUIRE(dynamic_cast<krbn::manipulator::details::conditions::variable*>(conditions[0].get()) != nullptr);
+  REQUIRE(dynamic_cast<krbn::manipulator::details::conditions::variable*>(conditions[1].get()) != nullptr);
+  REQUIRE(dynamic_cast<krbn::manipulator::details::conditions::frontmost_application*>(conditions[2].get()) != nullptr);
+  REQUIRE(dynamic_cast<krbn::manipulator::details::conditions::input_source*>(conditions[3].get()) != nullptr);
+
+  krbn::manipulator_environment manipulator_environment;
+  krbn::event_queue::queued_event queued_event(krbn::device_id(1),
+                                               0,
+                                               krbn::event_queue::queued_event::event(krbn::key_code::a),
+                                               krbn::event_type::key_down,
+                                               krbn::event_queue::queued_event::event(krbn::key_code::a));
+
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == false);
+
+  manipulator_environment.set_variable("variable1", 1);
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == false);
+
+  manipulator_environment.set_frontmost_application({"com.apple.Terminal",
+                                                     "/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal"});
+  manipulator_environment.set_input_source_identifiers({std::string("en"),
+                                                        std::string("com.apple.keylayout.US"),
+                                                        boost::none});
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == true);
+}
+
+namespace {
+class counting_condition final : public krbn::manipulator::details::conditions::base {
+public:
+  counting_condition(int cost,
+                     bool fulfilled) : cost_(cost),
+                                       fulfilled_(fulfilled),
+                                       evaluated_count_(0) {
+  }
+
+  virtual bool is_fulfilled(const krbn::event_queue::queued_event& queued_event,
+                            const krbn::manipulator_environment& manipulator_environment) const {
+    ++evaluated_count_;
+    return fulfilled_;
+  }
+
+  virtual int get_cost(void) const {
+    return cost_;
+  }
+
+  void set_fulfilled(bool value) {
+    fulfilled_ = value;
+  }
+
+  size_t get_evaluated_count(void) const {
+    return evaluated_count_;
+  }
+
+private:
+  int cost_;
+  bool fulfilled_;
+  mutable size_t evaluated_count_;
+};
+} // namespace
+
+TEST_CASE("condition_manager short-circuit") {
+  auto expensive = std::make_shared<counting_condition>(4, true);
+  auto cheap = std::make_shared<counting_condition>(1, false);
+
+  krbn::manipulator::condition_manager condition_manager;
+  condition_manager.push_back_condition(expensive);
+  condition_manager.push_back_condition(cheap);
+
+  krbn::manipulator_environment manipulator_environment;
+  krbn::event_queue::queued_event queued_event(krbn::device_id(1),
+                                               0,
+                                               krbn::event_queue::queued_event::event(krbn::key_code::a),
+                                               krbn::event_type::key_down,
+                                               krbn::event_queue::queued_event::event(krbn::key_code::a));
+
+  // Stop at the first (cheapest) unfulfilled condition.
+
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == false);
+  REQUIRE(cheap->get_evaluated_count() == 1);
+  REQUIRE(expensive->get_evaluated_count() == 0);
+
+  cheap->set_fulfilled(true);
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == true);
+  REQUIRE(cheap->get_evaluated_count() == 2);
+  REQUIRE(expensive->get_evaluated_count() == 1);
+}
+
 int main(int argc, char* const argv[]) {
   krbn::thread_utility::register_main_thread();
   return Catch::Session().run(argc, argv);
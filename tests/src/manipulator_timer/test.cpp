@@ -0,0 +1,263 @@
+#define CATCH_CONFIG_RUNNER
+#include "../../vendor/catch/catch.hpp"
+
+#include "manipulator/manipulator_factory.hpp"
+#include "manipulator/manipulator_timer.hpp"
+#include "thread_utility.hpp"
+#include <random>
+
+namespace {
+using timer_id = krbn::manipulator::manipulator_timer::timer_id;
+
+// Drives a manipulator_timer::core without mach_absolute_time.
+class virtual_clock final {
+public:
+  virtual_clock(krbn::manipulator::manipulator_timer::core& core) : core_(core),
+                                                                    now_(0) {
+  }
+
+  uint64_t get_now(void) const {
+    return now_;
+  }
+
+  void advance_to(uint64_t now) {
+    now_ = now;
+    core_.signal(now_);
+  }
+
+private:
+  krbn::manipulator::manipulator_timer::core& core_;
+  uint64_t now_;
+};
+
+class recorder final {
+public:
+  std::function<void(timer_id)> make_callback(const std::string& name) {
+    return [this, name](auto timer_id) {
+      invoked_.push_back(name);
+    };
+  }
+
+  const std::vector<std::string>& get_invoked(void) const {
+    return invoked_;
+  }
+
+private:
+  std::vector<std::string> invoked_;
+};
+} // namespace
+
+TEST_CASE("order") {
+  krbn::manipulator::manipulator_timer::core core;
+  virtual_clock clock(core);
+  recorder recorder;
+
+  core.add_entry(300, recorder.make_callback("300"));
+  core.add_entry(100, recorder.make_callback("100a"));
+  core.add_entry(200, recorder.make_callback("200"));
+  core.add_entry(100, recorder.make_callback("100b"));
+
+  REQUIRE(core.get_entries().size() == 4);
+  REQUIRE(core.get_entries()[0].get_when() == 100);
+  REQUIRE(core.get_entries()[1].get_when() == 100);
+  REQUIRE(core.get_entries()[2].get_when() == 200);
+  REQUIRE(core.get_entries()[3].get_when() == 300);
+
+  clock.advance_to(50);
+  REQUIRE(recorder.get_invoked().empty());
+
+  clock.advance_to(100);
+  REQUIRE(recorder.get_invoked() == std::vector<std::string>({"100a", "100b"}));
+
+  clock.advance_to(250);
+  REQUIRE(recorder.get_invoked() == std::vector<std::string>({"100a", "100b", "200"}));
+
+  clock.advance_to(1000);
+  REQUIRE(recorder.get_invoked() == std::vector<std::string>({"100a", "100b", "200", "300"}));
+  REQUIRE(core.get_entries().empty());
+}
+
+TEST_CASE("targeted dispatch") {
+  krbn::manipulator::manipulator_timer::core core;
+  virtual_clock clock(core);
+
+  std::vector<timer_id> invoked1;
+  std::vector<timer_id> invoked2;
+
+  auto id1 = core.add_entry(100, [&](auto timer_id) {
+    invoked1.push_back(timer_id);
+  });
+  auto id2 = core.add_entry(100, [&](auto timer_id) {
+    invoked2.push_back(timer_id);
+  });
+
+  clock.advance_to(100);
+  REQUIRE(invoked1 == std::vector<timer_id>({id1}));
+  REQUIRE(invoked2 == std::vector<timer_id>({id2}));
+}
+
+TEST_CASE("cancel_entry") {
+  krbn::manipulator::manipulator_timer::core core;
+  virtual_clock clock(core);
+  recorder recorder;
+
+  auto id1 = core.add_entry(100, recorder.make_callback("100"));
+  auto id2 = core.add_entry(200, recorder.make_callback("200"));
+  core.add_entry(300, recorder.make_callback("300"));
+
+  core.cancel_entry(id1);
+  REQUIRE(core.get_entries().size() == 2);
+
+  clock.advance_to(250);
+  REQUIRE(recorder.get_invoked() == std::vector<std::string>({"200"}));
+
+  // Canceling invoked or canceled entries does nothing.
+  core.cancel_entry(id1);
+  core.cancel_entry(id2);
+  REQUIRE(core.get_entries().size() == 1);
+
+  clock.advance_to(300);
+  REQUIRE(recorder.get_invoked() == std::vector<std::string>({"200", "300"}));
+}
+
+TEST_CASE("stats") {
+  krbn::manipulator::manipulator_timer::core core;
+  virtual_clock clock(core);
+  recorder recorder;
+
+  auto id1 = core.add_entry(100, recorder.make_callback("100a"));
+  auto id2 = core.add_entry(100, recorder.make_callback("100b"));
+  auto id3 = core.add_entry(200, recorder.make_callback("200"));
+  auto id4 = core.add_entry(300, recorder.make_callback("300"));
+
+  // The next wakeup (100) is not changed.
+  core.cancel_entry(id1);
+  REQUIRE(core.get_stats().canceled_count == 1);
+  REQUIRE(core.get_stats().avoided_wakeup_count == 0);
+
+  // The next wakeup is postponed to 200.
+  core.cancel_entry(id2);
+  REQUIRE(core.get_stats().canceled_count == 2);
+  REQUIRE(core.get_stats().avoided_wakeup_count == 1);
+
+  // Entries after the next wakeup do not affect.
+  core.cancel_entry(id4);
+  REQUIRE(core.get_stats().canceled_count == 3);
+  REQUIRE(core.get_stats().avoided_wakeup_count == 1);
+
+  // The last entry is removed.
+  core.cancel_entry(id3);
+  REQUIRE(core.get_stats().canceled_count == 4);
+  REQUIRE(core.get_stats().avoided_wakeup_count == 2);
+
+  // Canceled entries do nothing.
+  core.cancel_entry(id3);
+  REQUIRE(core.get_stats().canceled_count == 4);
+
+  core.add_entry(400, recorder.make_callback("400"));
+  clock.advance_to(500);
+  REQUIRE(recorder.get_invoked() == std::vector<std::string>({"400"}));
+  REQUIRE(core.get_stats().wakeup_count == 1);
+  REQUIRE(core.get_stats().invoked_count == 1);
+}
+
+TEST_CASE("callback modifies entries") {
+  krbn::manipulator::manipulator_timer::core core;
+  virtual_clock clock(core);
+  recorder recorder;
+
+  timer_id canceled_id = timer_id::zero;
+
+  core.add_entry(100, [&](auto timer_id) {
+    recorder.make_callback("100")(timer_id);
+
+    // Entries which are already due are invoked in the same `signal`.
+    core.add_entry(clock.get_now(), recorder.make_callback("added_due"));
+    core.add_entry(clock.get_now() + 1000, recorder.make_callback("added_future"));
+    core.cancel_entry(canceled_id);
+  });
+  canceled_id = core.add_entry(150, recorder.make_callback("canceled"));
+
+  clock.advance_to(200);
+  REQUIRE(recorder.get_invoked() == std::vector<std::string>({"100", "added_due"}));
+
+  clock.advance_to(1200);
+  REQUIRE(recorder.get_invoked() == std::vector<std::string>({"100", "added_due", "added_future"}));
+}
+
+TEST_CASE("random") {
+  krbn::manipulator::manipulator_timer::core core;
+  virtual_clock clock(core);
+
+  std::mt19937 engine(1234);
+  std::uniform_int_distribution<uint64_t> when_distribution(1, 10000);
+  std::uniform_int_distribution<int> cancel_distribution(0, 2);
+
+  std::vector<std::pair<uint64_t, timer_id>> expected;
+  std::vector<std::pair<uint64_t, timer_id>> actual;
+
+  for (int i = 0; i < 1000; ++i) {
+    auto when = when_distribution(engine);
+    auto id = core.add_entry(when, [&, when](auto timer_id) {
+      actual.emplace_back(when, timer_id);
+    });
+
+    if (cancel_distribution(engine) == 0) {
+      core.cancel_entry(id);
+    } else {
+      expected.emplace_back(when, id);
+    }
+  }
+
+  std::sort(std::begin(expected), std::end(expected));
+
+  REQUIRE(core.get_entries().size() == expected.size());
+
+  for (uint64_t now = 0; now <= 10000; now += 100) {
+    clock.advance_to(now);
+  }
+
+  REQUIRE(actual == expected);
+  REQUIRE(core.get_entries().empty());
+}
+
+TEST_CASE("to_delayed_action") {
+  auto& core = krbn::manipulator::manipulator_timer::get_instance();
+  auto size = core.get_entries().size();
+
+  {
+    krbn::core_configuration::profile::complex_modifications::parameters parameters;
+    auto manipulator = krbn::manipulator::manipulator_factory::make_manipulator(nlohmann::json::parse(R"(
+      {
+        "type": "basic",
+        "from": {"key_code": "a"},
+        "to": [{"key_code": "b"}],
+        "to_delayed_action": {"to_invoked": [{"key_code": "c"}]}
+      }
+    )"),
+                                                                                parameters);
+
+    krbn::event_queue input_event_queue;
+    auto output_event_queue = std::make_shared<krbn::event_queue>();
+
+    krbn::event_queue::queued_event::event event(krbn::key_code::a);
+    input_event_queue.emplace_back_event(krbn::device_id(1),
+                                         1000,
+                                         event,
+                                         krbn::event_type::key_down,
+                                         event);
+    manipulator->manipulate(input_event_queue.get_front_event(),
+                            input_event_queue,
+                            output_event_queue);
+
+    REQUIRE(core.get_entries().size() == size + 1);
+  }
+
+  // The destroyed manipulator cancels its entry.
+  REQUIRE(core.get_entries().size() == size);
+}
+
+int main(int argc, char* const argv[]) {
+  krbn::thread_utility::register_main_thread();
+  return Catch::Session().run(argc, argv);
+}
@@ -2,6 +2,7 @@
 #include "../../vendor/catch/catch.hpp"
 
 #include "modifier_flag_manager.hpp"
+#include "modifier_flag_set.hpp"
 #include "thread_utility.hpp"
 
 TEST_CASE("manipulator.modifier_flag_manager") {
@@ -136,6 +137,109 @@ TEST_CASE("manipulator.modifier_flag_manager") {
     modifier_flag_manager.push_back_active_modifier_flag(decrease_lock_left_shift_1);
     REQUIRE(modifier_flag_manager.is_pressed(krbn::modifier_flag::left_shift) == false);
   }
+
+  // ----------------------------------------
+  // type::increase_lock with type::increase
+  {
+    krbn::modifier_flag_manager modifier_flag_manager;
+
+    modifier_flag_manager.push_back_active_modifier_flag(lock_left_shift_1);
+    modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
+    REQUIRE(modifier_flag_manager.get_active_modifier_flags().size() == 2);
+
+    modifier_flag_manager.push_back_active_modifier_flag(decrease_lock_left_shift_1);
+    REQUIRE(modifier_flag_manager.get_active_modifier_flags().size() == 1);
+    REQUIRE(modifier_flag_manager.is_pressed(krbn::modifier_flag::left_shift) == true);
+
+    modifier_flag_manager.push_back_active_modifier_flag(decrease_left_shift_1);
+    REQUIRE(modifier_flag_manager.get_active_modifier_flags().size() == 0);
+    REQUIRE(modifier_flag_manager.is_pressed(krbn::modifier_flag::left_shift) == false);
+  }
+
+  // ----------------------------------------
+  // decrease of other device
+  {
+    krbn::modifier_flag_manager modifier_flag_manager;
+
+    modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
+    modifier_flag_manager.push_back_active_modifier_flag(decrease_left_shift_2);
+    REQUIRE(modifier_flag_manager.get_active_modifier_flags().size() == 2);
+    REQUIRE(modifier_flag_manager.is_pressed(krbn::modifier_flag::left_shift) == false);
+
+    modifier_flag_manager.erase_all_active_modifier_flags(krbn::device_id(2));
+    REQUIRE(modifier_flag_manager.is_pressed(krbn::modifier_flag::left_shift) == true);
+  }
+
+  // ----------------------------------------
+  // get_pressed_bits
+  {
+    krbn::modifier_flag_manager modifier_flag_manager;
+    REQUIRE(modifier_flag_manager.get_pressed_bits() == 0);
+
+    krbn::modifier_flag_manager::active_modifier_flag right_command_1(krbn::modifier_flag_manager::active_modifier_flag::type::increase,
+                                                                      krbn::modifier_flag::right_command,
+                                                                      krbn::device_id(1));
+
+    modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
+    modifier_flag_manager.push_back_active_modifier_flag(right_command_1);
+    REQUIRE(modifier_flag_manager.get_pressed_bits() == ((1u << static_cast<uint32_t>(krbn::modifier_flag::left_shift)) |
+                                                         (1u << static_cast<uint32_t>(krbn::modifier_flag::right_command))));
+
+    modifier_flag_manager.push_back_active_modifier_flag(decrease_left_shift_1);
+    REQUIRE(modifier_flag_manager.get_pressed_bits() == (1u << static_cast<uint32_t>(krbn::modifier_flag::right_command)));
+
+    modifier_flag_manager.reset();
+    REQUIRE(modifier_flag_manager.get_pressed_bits() == 0);
+    REQUIRE(modifier_flag_manager.get_active_modifier_flags().size() == 0);
+  }
+}
+
+TEST_CASE("modifier_flag_set") {
+  {
+    krbn::modifier_flag_set s;
+    REQUIRE(s.empty());
+    REQUIRE(s.size() == 0);
+    REQUIRE(s.front() == krbn::modifier_flag::zero);
+    REQUIRE(s.begin() == s.end());
+  }
+  {
+    krbn::modifier_flag_set s({krbn::modifier_flag::right_shift,
+                               krbn::modifier_flag::left_control,
+                               krbn::modifier_flag::fn});
+    REQUIRE(!s.empty());
+    REQUIRE(s.size() == 3);
+    REQUIRE(s.contains(krbn::modifier_flag::left_control));
+    REQUIRE(!s.contains(krbn::modifier_flag::left_shift));
+    REQUIRE(s.front() == krbn::modifier_flag::left_control);
+
+    std::vector<krbn::modifier_flag> actual(std::begin(s), std::end(s));
+    std::vector<krbn::modifier_flag> expected({krbn::modifier_flag::left_control,
+                                               krbn::modifier_flag::right_shift,
+                                               krbn::modifier_flag::fn});
+    REQUIRE(actual == expected);
+
+    s.erase(krbn::modifier_flag::left_control);
+    REQUIRE(s == krbn::modifier_flag_set({krbn::modifier_flag::right_shift,
+                                          krbn::modifier_flag::fn}));
+
+    s.erase(krbn::modifier_flag_set({krbn::modifier_flag::fn}));
+    REQUIRE(s == krbn::modifier_flag_set({krbn::modifier_flag::right_shift}));
+
+    s.clear();
+    REQUIRE(s.empty());
+  }
+  {
+    // modifier_flag::zero is ignored.
+    krbn::modifier_flag_set s({krbn::modifier_flag::zero});
+    REQUIRE(s.empty());
+  }
+  {
+    auto s = krbn::modifier_flag_set::all();
+    REQUIRE(s.size() == static_cast<size_t>(krbn::modifier_flag::end_) - 1);
+    REQUIRE(!s.contains(krbn::modifier_flag::zero));
+    REQUIRE(s.contains(krbn::modifier_flag::caps_lock));
+    REQUIRE(s.contains(krbn::modifier_flag::fn));
+  }
 }
 
 int main(int argc, char* const argv[]) {
@@ -2,15 +2,521 @@
 #include "../../vendor/catch/catch.hpp"
 
 #include "../share/manipulator_helper.hpp"
+#include "../share/mock_virtual_hid_device_client.hpp"
 #include "manipulator/details/post_event_to_virtual_devices.hpp"
+#include "simulated_scheduler.hpp"
 #include "thread_utility.hpp"
 #include <boost/optional/optional_io.hpp>
+#include <map>
+
+namespace {
+using queue = krbn::manipulator::details::post_event_to_virtual_devices::queue;
+
+void emplace_back_key_event(queue& queue, krbn::key_code key_code, krbn::event_type event_type, uint64_t time_stamp) {
+  queue.emplace_back_key_event(krbn::hid_usage_page::keyboard_or_keypad,
+                               krbn::hid_usage(static_cast<uint32_t>(key_code)),
+                               event_type,
+                               time_stamp);
+}
+
+void tap(queue& queue, krbn::key_code key_code, uint64_t time_stamp) {
+  emplace_back_key_event(queue, key_code, krbn::event_type::key_down, time_stamp);
+  emplace_back_key_event(queue, key_code, krbn::event_type::key_up, time_stamp);
+}
+
+// Post events including delayed ones. (See `adjust_time_stamp`.)
+void post_events(queue& queue,
+                 krbn::simulated_scheduler& scheduler,
+                 krbn::unit_testing::mock_virtual_hid_device_client& client) {
+  queue.post_events(client);
+  while (!queue.empty()) {
+    scheduler.advance_by(krbn::time_utility::nano_to_absolute(NSEC_PER_MSEC));
+  }
+}
+
+// Each key is pressed and released the same number of times in the same order.
+void check_key_transitions(const krbn::unit_testing::mock_virtual_hid_device_client& client) {
+  std::map<std::pair<uint32_t, uint32_t>, bool> pressed;
+  for (const auto& t : client.get_key_transitions()) {
+    REQUIRE(pressed[t.first] != t.second);
+    pressed[t.first] = t.second;
+  }
+  for (const auto& p : pressed) {
+    REQUIRE(p.second == false);
+  }
+
+  REQUIRE(client.get_keyboard_input().modifiers == 0);
+  for (const auto& k : client.get_keyboard_input().keys) {
+    REQUIRE(k == 0);
+  }
+}
+
+std::vector<std::pair<std::pair<uint32_t, uint32_t>, bool>> make_key_transitions(const std::vector<std::pair<krbn::key_code, bool>>& key_codes) {
+  std::vector<std::pair<std::pair<uint32_t, uint32_t>, bool>> result;
+  for (const auto& k : key_codes) {
+    result.emplace_back(std::make_pair(static_cast<uint32_t>(krbn::hid_usage_page::keyboard_or_keypad),
+                                       static_cast<uint32_t>(k.first)),
+                        k.second);
+  }
+  return result;
+}
+} // namespace
 
 TEST_CASE("actual examples") {
   krbn::unit_testing::manipulator_helper::run_tests(nlohmann::json::parse(std::ifstream("json/tests.json")));
 }
 
+TEST_CASE("keyboard_input coalescing") {
+  // Taps in a macro
+  {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    std::vector<krbn::key_code> key_codes{
+        krbn::key_code::h,
+        krbn::key_code::e,
+        krbn::key_code::l,
+        krbn::key_code::l,
+        krbn::key_code::o,
+    };
+    for (const auto& k : key_codes) {
+      tap(queue, k, 1000);
+    }
+
+    queue.post_events(client);
+
+    REQUIRE(queue.empty());
+    REQUIRE(client.get_dispatch_keyboard_event_count() == 0);
+    // The key up of each key is posted with the key down of the next key.
+    // (10 events -> 7 reports since the repeated `l` requires a report between its key up and key down.)
+    REQUIRE(client.get_post_keyboard_input_report_count() == 7);
+    REQUIRE(client.get_key_transitions() == make_key_transitions({
+                                                {krbn::key_code::h, true},
+                                                {krbn::key_code::h, false},
+                                                {krbn::key_code::e, true},
+                                                {krbn::key_code::e, false},
+                                                {krbn::key_code::l, true},
+                                                {krbn::key_code::l, false},
+                                                {krbn::key_code::l, true},
+                                                {krbn::key_code::l, false},
+                                                {krbn::key_code::o, true},
+                                                {krbn::key_code::o, false},
+                                            }));
+    check_key_transitions(client);
+  }
+
+  // Chord
+  {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    emplace_back_key_event(queue, krbn::key_code::a, krbn::event_type::key_down, 1000);
+    emplace_back_key_event(queue, krbn::key_code::b, krbn::event_type::key_down, 1000);
+    emplace_back_key_event(queue, krbn::key_code::c, krbn::event_type::key_down, 1000);
+    emplace_back_key_event(queue, krbn::key_code::c, krbn::event_type::key_up, 1000);
+    emplace_back_key_event(queue, krbn::key_code::b, krbn::event_type::key_up, 1000);
+    emplace_back_key_event(queue, krbn::key_code::a, krbn::event_type::key_up, 1000);
+
+    queue.post_events(client);
+
+    REQUIRE(client.get_call_count() == 2);
+    REQUIRE(client.get_post_keyboard_input_report_count() == 2);
+    check_key_transitions(client);
+  }
+
+  // Keys which do not fit into keyboard_input.keys
+  {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    std::vector<krbn::key_code> key_codes{
+        krbn::key_code::a,
+        krbn::key_code::b,
+        krbn::key_code::c,
+        krbn::key_code::d,
+        krbn::key_code::e,
+        krbn::key_code::f,
+        krbn::key_code::g,
+        krbn::key_code::h,
+    };
+    for (const auto& k : key_codes) {
+      emplace_back_key_event(queue, k, krbn::event_type::key_down, 1000);
+    }
+    for (const auto& k : key_codes) {
+      emplace_back_key_event(queue, k, krbn::event_type::key_up, 1000);
+    }
+
+    queue.post_events(client);
+
+    // g and h are posted by dispatch_keyboard_event.
+    REQUIRE(client.get_dispatch_keyboard_event_count() == 4);
+    REQUIRE(client.get_post_keyboard_input_report_count() == 2);
+    REQUIRE(client.get_key_transitions() == make_key_transitions({
+                                                {krbn::key_code::a, true},
+                                                {krbn::key_code::b, true},
+                                                {krbn::key_code::c, true},
+                                                {krbn::key_code::d, true},
+                                                {krbn::key_code::e, true},
+                                                {krbn::key_code::f, true},
+                                                {krbn::key_code::g, true},
+                                                {krbn::key_code::h, true},
+                                                {krbn::key_code::a, false},
+                                                {krbn::key_code::b, false},
+                                                {krbn::key_code::c, false},
+                                                {krbn::key_code::d, false},
+                                                {krbn::key_code::e, false},
+                                                {krbn::key_code::f, false},
+                                                {krbn::key_code::g, false},
+                                                {krbn::key_code::h, false},
+                                            }));
+    check_key_transitions(client);
+  }
+
+  // Tap a key while keyboard_input.keys is full
+  {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    std::vector<krbn::key_code> key_codes{
+        krbn::key_code::a,
+        krbn::key_code::b,
+        krbn::key_code::c,
+        krbn::key_code::d,
+        krbn::key_code::e,
+        krbn::key_code::f,
+    };
+    for (const auto& k : key_codes) {
+      emplace_back_key_event(queue, k, krbn::event_type::key_down, 1000);
+    }
+    tap(queue, krbn::key_code::g, 1000);
+    for (const auto& k : key_codes) {
+      emplace_back_key_event(queue, k, krbn::event_type::key_up, 1000);
+    }
+
+    queue.post_events(client);
+
+    REQUIRE(client.get_dispatch_keyboard_event_count() == 2);
+    REQUIRE(client.get_post_keyboard_input_report_count() == 2);
+    REQUIRE(client.get_key_transitions() == make_key_transitions({
+                                                {krbn::key_code::a, true},
+                                                {krbn::key_code::b, true},
+                                                {krbn::key_code::c, true},
+                                                {krbn::key_code::d, true},
+                                                {krbn::key_code::e, true},
+                                                {krbn::key_code::f, true},
+                                                {krbn::key_code::g, true},
+                                                {krbn::key_code::g, false},
+                                                {krbn::key_code::a, false},
+                                                {krbn::key_code::b, false},
+                                                {krbn::key_code::c, false},
+                                                {krbn::key_code::d, false},
+                                                {krbn::key_code::e, false},
+                                                {krbn::key_code::f, false},
+                                            }));
+    check_key_transitions(client);
+  }
+
+  // Modifiers
+  {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    emplace_back_key_event(queue, krbn::key_code::left_shift, krbn::event_type::key_down, 1000);
+    tap(queue, krbn::key_code::a, 1000);
+    tap(queue, krbn::key_code::b, 1000);
+    emplace_back_key_event(queue, krbn::key_code::left_shift, krbn::event_type::key_up, 1000);
+    tap(queue, krbn::key_code::caps_lock, 1000);
+
+    // Events are delayed around modifiers by `adjust_time_stamp`.
+    while (!queue.empty()) {
+      queue.post_events(client);
+      scheduler->advance_by(krbn::time_utility::nano_to_absolute(NSEC_PER_MSEC));
+    }
+
+    REQUIRE(client.get_dispatch_keyboard_event_count() == 0);
+    REQUIRE(client.get_post_keyboard_input_report_count() == 7);
+    REQUIRE(client.get_key_transitions() == make_key_transitions({
+                                                {krbn::key_code::left_shift, true},
+                                                {krbn::key_code::a, true},
+                                                {krbn::key_code::a, false},
+                                                {krbn::key_code::b, true},
+                                                {krbn::key_code::b, false},
+                                                {krbn::key_code::left_shift, false},
+                                                {krbn::key_code::caps_lock, true},
+                                                {krbn::key_code::caps_lock, false},
+                                            }));
+    check_key_transitions(client);
+  }
+
+  // Modifiers and keys which are posted at once
+  {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    emplace_back_key_event(queue, krbn::key_code::left_shift, krbn::event_type::key_down, 1000);
+    emplace_back_key_event(queue, krbn::key_code::right_command, krbn::event_type::key_down, 1000);
+    emplace_back_key_event(queue, krbn::key_code::a, krbn::event_type::key_down, 1000);
+    emplace_back_key_event(queue, krbn::key_code::right_command, krbn::event_type::key_up, 1000);
+    emplace_back_key_event(queue, krbn::key_code::a, krbn::event_type::key_up, 1000);
+    emplace_back_key_event(queue, krbn::key_code::left_shift, krbn::event_type::key_up, 1000);
+
+    scheduler->advance_to(krbn::time_utility::nano_to_absolute(NSEC_PER_SEC));
+    queue.post_events(client);
+
+    REQUIRE(queue.empty());
+    // Modifiers are not posted in the same report with the other keys.
+    REQUIRE(client.get_dispatch_keyboard_event_count() == 0);
+    REQUIRE(client.get_post_keyboard_input_report_count() == 5);
+    REQUIRE(client.get_key_transitions() == make_key_transitions({
+                                                {krbn::key_code::left_shift, true},
+                                                {krbn::key_code::right_command, true},
+                                                {krbn::key_code::a, true},
+                                                {krbn::key_code::right_command, false},
+                                                {krbn::key_code::a, false},
+                                                {krbn::key_code::left_shift, false},
+                                            }));
+    check_key_transitions(client);
+  }
+
+  // clear_keyboard_modifier_flags
+  {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    emplace_back_key_event(queue, krbn::key_code::left_control, krbn::event_type::key_down, 1000);
+    queue.push_back_clear_keyboard_modifier_flags_event(1000);
+
+    post_events(queue, *scheduler, client);
+
+    REQUIRE(client.get_post_keyboard_input_report_count() == 2);
+    REQUIRE(client.get_clear_keyboard_modifier_flags_count() == 1);
+    check_key_transitions(client);
+  }
+
+  // Delayed events
+  {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    emplace_back_key_event(queue, krbn::key_code::a, krbn::event_type::key_down, 1000);
+    emplace_back_key_event(queue, krbn::key_code::a, krbn::event_type::key_up, 2000);
+
+    queue.post_events(client);
+
+    // The pending report is posted before waiting.
+    REQUIRE(client.get_post_keyboard_input_report_count() == 1);
+    REQUIRE(client.get_keyboard_input().keys[0] == static_cast<uint8_t>(krbn::key_code::a));
+    REQUIRE(scheduler->get_pending_timer_count() == 1);
+
+    scheduler->advance_to(2000);
+
+    REQUIRE(queue.empty());
+    REQUIRE(client.get_post_keyboard_input_report_count() == 2);
+    check_key_transitions(client);
+  }
+}
+
+TEST_CASE("keyboard_input coalescing with manipulators") {
+  // to_if_alone with a macro
+  auto manipulator = krbn::manipulator::manipulator_factory::make_manipulator(nlohmann::json::parse(R"(
+    {
+      "type": "basic",
+      "from": {"key_code": "spacebar"},
+      "to": [{"key_code": "left_control"}],
+      "to_if_alone": [
+        {"key_code": "k"},
+        {"key_code": "a"},
+        {"key_code": "r"},
+        {"key_code": "a"},
+        {"key_code": "b"},
+        {"key_code": "i"},
+        {"key_code": "n"},
+        {"key_code": "e"},
+        {"key_code": "r"}
+      ]
+    }
+  )"),
+                                                                              krbn::core_configuration::profile::complex_modifications::parameters());
+
+  auto scheduler = std::make_shared<krbn::simulated_scheduler>(0);
+  auto post_event_to_virtual_devices_manipulator = std::make_shared<krbn::manipulator::details::post_event_to_virtual_devices>(scheduler);
+
+  krbn::manipulator::manipulator_manager manipulator_manager;
+  manipulator_manager.push_back_manipulator(manipulator);
+
+  krbn::manipulator::manipulator_manager post_event_to_virtual_devices_manipulator_manager;
+  post_event_to_virtual_devices_manipulator_manager.push_back_manipulator(std::shared_ptr<krbn::manipulator::details::base>(post_event_to_virtual_devices_manipulator));
+
+  krbn::manipulator::manipulator_managers_connector connector;
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  auto middle_event_queue = std::make_shared<krbn::event_queue>();
+  auto output_event_queue = std::make_shared<krbn::event_queue>();
+  connector.emplace_back_connection(manipulator_manager, input_event_queue, middle_event_queue);
+  connector.emplace_back_connection(post_event_to_virtual_devices_manipulator_manager, output_event_queue);
+
+  krbn::event_queue::queued_event::event spacebar(krbn::key_code::spacebar);
+  input_event_queue->emplace_back_event(krbn::device_id(1), 100, spacebar, krbn::event_type::key_down, spacebar);
+  connector.manipulate();
+  input_event_queue->emplace_back_event(krbn::device_id(1), 200, spacebar, krbn::event_type::key_up, spacebar);
+  connector.manipulate();
+
+  auto event_count = post_event_to_virtual_devices_manipulator->get_queue().get_events().size();
+  // left_control, clear_keyboard_modifier_flags and to_if_alone
+  REQUIRE(event_count == 21);
+
+  scheduler->advance_to(krbn::time_utility::nano_to_absolute(NSEC_PER_SEC));
+
+  krbn::unit_testing::mock_virtual_hid_device_client client;
+  post_event_to_virtual_devices_manipulator->post_events(client);
+
+  REQUIRE(post_event_to_virtual_devices_manipulator->get_queue().empty());
+  REQUIRE(client.get_dispatch_keyboard_event_count() == 0);
+  REQUIRE(client.get_clear_keyboard_modifier_flags_count() == 1);
+  REQUIRE(client.get_post_keyboard_input_report_count() == 12);
+  REQUIRE(client.get_call_count() == 13);
+  check_key_transitions(client);
+}
+
+TEST_CASE("pointing_input coalescing") {
+  auto make_report = [](uint8_t buttons, int x, int y) {
+    pqrs::karabiner_virtual_hid_device::hid_report::pointing_input report;
+    report.buttons[0] = buttons;
+    report.x = static_cast<uint8_t>(x);
+    report.y = static_cast<uint8_t>(y);
+    return report;
+  };
+
+  for (bool coalescing : {false, true}) {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    queue.set_pointing_motion_coalescing(coalescing);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    queue.emplace_back_event(make_report(0, 10, 0), 1000);
+    queue.emplace_back_event(make_report(0, 0, -10), 1000);
+    queue.emplace_back_event(make_report(0, 100, 0), 1000);
+    // Overflow
+    queue.emplace_back_event(make_report(0, 20, 0), 1000);
+    // Button transition
+    queue.emplace_back_event(make_report(1, 0, 0), 1000);
+    queue.emplace_back_event(make_report(1, 1, 1), 1000);
+    // Different time stamp
+    queue.emplace_back_event(make_report(1, 1, 1), 1001);
+
+    if (coalescing) {
+      REQUIRE(queue.get_events().size() == 4);
+      REQUIRE(*(queue.get_events()[0].get_pointing_input()) == make_report(0, 110, -10));
+      REQUIRE(*(queue.get_events()[1].get_pointing_input()) == make_report(0, 20, 0));
+      REQUIRE(*(queue.get_events()[2].get_pointing_input()) == make_report(1, 1, 1));
+      REQUIRE(*(queue.get_events()[3].get_pointing_input()) == make_report(1, 1, 1));
+    } else {
+      REQUIRE(queue.get_events().size() == 7);
+    }
+
+    scheduler->advance_to(2000);
+    queue.post_events(client);
+    REQUIRE(queue.empty());
+    REQUIRE(client.get_post_pointing_input_report_count() == (coalescing ? 4 : 7));
+  }
+}
+
 int main(int argc, char* const argv[]) {
   krbn::thread_utility::register_main_thread();
   return Catch::Session().run(argc, argv);
 }
+
+TEST_CASE("keyboard_input reset") {
+  // clear
+  {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    emplace_back_key_event(queue, krbn::key_code::left_shift, krbn::event_type::key_down, 1000);
+    post_events(queue, *scheduler, client);
+    emplace_back_key_event(queue, krbn::key_code::a, krbn::event_type::key_down, 1000);
+    post_events(queue, *scheduler, client);
+
+    REQUIRE(client.get_keyboard_input().modifiers == 0x2);
+    REQUIRE(client.get_keyboard_input().keys[0] == static_cast<uint8_t>(krbn::key_code::a));
+
+    queue.clear();
+
+    emplace_back_key_event(queue, krbn::key_code::b, krbn::event_type::key_down, 1000);
+    post_events(queue, *scheduler, client);
+
+    // Released keys are not posted again.
+    REQUIRE(client.get_keyboard_input().modifiers == 0);
+    REQUIRE(client.get_keyboard_input().keys[0] == static_cast<uint8_t>(krbn::key_code::b));
+    REQUIRE(client.get_keyboard_input().keys[1] == 0);
+
+    emplace_back_key_event(queue, krbn::key_code::b, krbn::event_type::key_up, 1000);
+    post_events(queue, *scheduler, client);
+
+    REQUIRE(client.get_post_keyboard_input_report_count() == 4);
+    REQUIRE(client.get_dispatch_keyboard_event_count() == 0);
+    check_key_transitions(client);
+  }
+
+  // Virtual keyboard initialization
+  {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    emplace_back_key_event(queue, krbn::key_code::a, krbn::event_type::key_down, 1000);
+    emplace_back_key_event(queue, krbn::key_code::b, krbn::event_type::key_down, 1000);
+    post_events(queue, *scheduler, client);
+
+    // The virtual keyboard forgets the pressed keys when it is initialized.
+    queue.reset_keyboard_input();
+    client.reset_virtual_hid_keyboard();
+
+    emplace_back_key_event(queue, krbn::key_code::c, krbn::event_type::key_down, 1000);
+    post_events(queue, *scheduler, client);
+
+    REQUIRE(client.get_keyboard_input().keys[0] == static_cast<uint8_t>(krbn::key_code::c));
+    REQUIRE(client.get_keyboard_input().keys[1] == 0);
+
+    emplace_back_key_event(queue, krbn::key_code::c, krbn::event_type::key_up, 1000);
+    post_events(queue, *scheduler, client);
+
+    check_key_transitions(client);
+  }
+
+  // reset_virtual_hid_keyboard
+  {
+    auto scheduler = std::make_shared<krbn::simulated_scheduler>(1000);
+    queue queue(scheduler);
+    krbn::unit_testing::mock_virtual_hid_device_client client;
+
+    emplace_back_key_event(queue, krbn::key_code::right_option, krbn::event_type::key_down, 1000);
+    post_events(queue, *scheduler, client);
+    emplace_back_key_event(queue, krbn::key_code::a, krbn::event_type::key_down, 1000);
+    post_events(queue, *scheduler, client);
+
+    queue.reset_virtual_hid_keyboard(client);
+
+    REQUIRE(client.get_reset_virtual_hid_keyboard_count() == 1);
+
+    emplace_back_key_event(queue, krbn::key_code::b, krbn::event_type::key_down, 1000);
+    post_events(queue, *scheduler, client);
+
+    REQUIRE(client.get_keyboard_input().modifiers == 0);
+    REQUIRE(client.get_keyboard_input().keys[0] == static_cast<uint8_t>(krbn::key_code::b));
+    REQUIRE(client.get_keyboard_input().keys[1] == 0);
+
+    emplace_back_key_event(queue, krbn::key_code::b, krbn::event_type::key_up, 1000);
+    post_events(queue, *scheduler, client);
+
+    check_key_transitions(client);
+  }
+}
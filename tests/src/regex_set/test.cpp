@@ -0,0 +1,125 @@
+#define CATCH_CONFIG_RUNNER
+#include "../../vendor/catch/catch.hpp"
+
+#include "regex_set.hpp"
+#include "thread_utility.hpp"
+#include <string>
+#include <vector>
+
+namespace {
+bool search_linearly(const std::vector<std::string>& patterns, const std::string& string) {
+  for (const auto& p : patterns) {
+    try {
+      if (regex_search(string, std::regex(p))) {
+        return true;
+      }
+    } catch (std::exception& e) {
+    }
+  }
+  return false;
+}
+} // namespace
+
+TEST_CASE("regex_set") {
+  {
+    krbn::regex_set regex_set;
+    REQUIRE(regex_set.empty());
+    REQUIRE(regex_set.search("") == false);
+    REQUIRE(regex_set.search("com.apple.Terminal") == false);
+  }
+  {
+    krbn::regex_set regex_set({"^com\\.apple\\.Terminal$"});
+    REQUIRE(regex_set.size() == 1);
+    REQUIRE(regex_set.search("com.apple.Terminal") == true);
+    REQUIRE(regex_set.search("com.apple.Terminal2") == false);
+    REQUIRE(regex_set.search("xcom.apple.Terminal") == false);
+    REQUIRE(regex_set.search("com-apple-Terminal") == false);
+  }
+  {
+    krbn::regex_set regex_set({"^com\\.apple\\.", "\\.app$", "/Terminal\\.app/"});
+    REQUIRE(regex_set.search("com.apple.Safari") == true);
+    REQUIRE(regex_set.search("/Applications/iTerm.app") == true);
+    REQUIRE(regex_set.search("/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal") == true);
+    REQUIRE(regex_set.search("org.mozilla.firefox") == false);
+  }
+  {
+    // Invalid patterns are ignored.
+    krbn::regex_set regex_set({"[", "^com\\.(apple|google)\\.", "(a)\\1"});
+    REQUIRE(regex_set.size() == 2);
+    REQUIRE(regex_set.search("com.google.Chrome") == true);
+    REQUIRE(regex_set.search("xaax") == true);
+    REQUIRE(regex_set.search("xabx") == false);
+    REQUIRE(regex_set.search("[") == false);
+  }
+}
+
+TEST_CASE("regex_set.std::regex") {
+  std::vector<std::string> patterns{
+      "",
+      "^",
+      "$",
+      "^$",
+      "^com\\.apple\\.Terminal$",
+      "^com\\.googlecode\\.iterm2$",
+      "^com\\.apple\\.",
+      "^/Users/tekezo/Applications/iTerm\\.app",
+      "/Terminal\\.app/",
+      "\\.app$",
+      "Terminal$",
+      "^com.apple.Terminal$",
+      "^com\\.(apple|google)\\.",
+      "^org\\.mozilla\\.firefox$|^com\\.google\\.Chrome$",
+      "\\bTerm",
+      "^[a-z]+\\.apple",
+      "^com\\.apple\\.Term.*",
+      "a$b",
+      "(a)\\1",
+      "^en$",
+      "^ja",
+  };
+
+  std::vector<std::string> strings{
+      "",
+      "com.apple.Terminal",
+      "com.apple.Terminal2",
+      "xcom.apple.Terminal",
+      "com-apple-Terminal",
+      "com.googlecode.iterm2",
+      "com.google.Chrome",
+      "org.mozilla.firefox",
+      "/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal",
+      "/Users/tekezo/Applications/iTerm.app",
+      "/Applications/iTerm.app",
+      "MyTerminal",
+      "aa",
+      "en",
+      "ja",
+      "jaJP",
+  };
+
+  // Each pattern alone
+  for (const auto& p : patterns) {
+    krbn::regex_set regex_set({p});
+    for (const auto& s : strings) {
+      INFO(p << " " << s);
+      REQUIRE(regex_set.search(s) == search_linearly({p}, s));
+    }
+  }
+
+  // Every window of patterns
+  for (size_t i = 0; i < patterns.size(); ++i) {
+    for (size_t n = 1; i + n <= patterns.size(); ++n) {
+      std::vector<std::string> v(std::begin(patterns) + i,
+                                 std::begin(patterns) + i + n);
+      krbn::regex_set regex_set(v);
+      for (const auto& s : strings) {
+        REQUIRE(regex_set.search(s) == search_linearly(v, s));
+      }
+    }
+  }
+}
+
+int main(int argc, char* const argv[]) {
+  krbn::thread_utility::register_main_thread();
+  return Catch::Session().run(argc, argv);
+}
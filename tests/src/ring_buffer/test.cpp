@@ -0,0 +1,106 @@
+#define CATCH_CONFIG_RUNNER
+#include "../../vendor/catch/catch.hpp"
+
+#include "ring_buffer.hpp"
+#include "thread_utility.hpp"
+#include <string>
+
+TEST_CASE("ring_buffer") {
+  krbn::ring_buffer<std::string> ring_buffer(4);
+
+  REQUIRE(ring_buffer.empty());
+  REQUIRE(ring_buffer.size() == 0);
+  REQUIRE(ring_buffer.capacity() == 4);
+
+  ring_buffer.emplace_back("a");
+  ring_buffer.emplace_back("b");
+  ring_buffer.emplace_back("c");
+
+  REQUIRE(ring_buffer.size() == 3);
+  REQUIRE(ring_buffer.front() == "a");
+  REQUIRE(ring_buffer.back() == "c");
+  REQUIRE(ring_buffer[1] == "b");
+
+  // Front reference is kept while the capacity is not exceeded.
+
+  auto& b = ring_buffer[1];
+
+  ring_buffer.pop_front();
+  ring_buffer.emplace_back("d");
+  ring_buffer.emplace_back("e");
+
+  REQUIRE(&b == &(ring_buffer.front()));
+  REQUIRE(ring_buffer.capacity() == 4);
+  REQUIRE(ring_buffer == std::vector<std::string>({"b", "c", "d", "e"}));
+
+  // Grow while wrapped around
+
+  ring_buffer.emplace_back("f");
+
+  REQUIRE(ring_buffer.capacity() == 8);
+  REQUIRE(ring_buffer == std::vector<std::string>({"b", "c", "d", "e", "f"}));
+
+  {
+    std::vector<std::string> actual;
+    for (const auto& s : ring_buffer) {
+      actual.push_back(s);
+    }
+    REQUIRE(actual == std::vector<std::string>({"b", "c", "d", "e", "f"}));
+  }
+
+  // Copy
+
+  {
+    auto copied = ring_buffer;
+    REQUIRE(copied == ring_buffer);
+
+    copied.pop_front();
+    REQUIRE(copied == std::vector<std::string>({"c", "d", "e", "f"}));
+    REQUIRE(ring_buffer.front() == "b");
+  }
+
+  // Clear keeps capacity
+
+  ring_buffer.clear();
+
+  REQUIRE(ring_buffer.empty());
+  REQUIRE(ring_buffer.capacity() == 8);
+
+  for (int i = 0; i < 100; ++i) {
+    ring_buffer.emplace_back(std::to_string(i));
+    ring_buffer.pop_front();
+  }
+
+  REQUIRE(ring_buffer.empty());
+  REQUIRE(ring_buffer.capacity() == 8);
+}
+
+TEST_CASE("ring_buffer.reserve") {
+  krbn::ring_buffer<int> ring_buffer;
+
+  REQUIRE(ring_buffer.capacity() == 0);
+
+  ring_buffer.reserve(5);
+  REQUIRE(ring_buffer.capacity() == 8);
+
+  ring_buffer.reserve(3);
+  REQUIRE(ring_buffer.capacity() == 8);
+
+  for (int i = 0; i < 1000; ++i) {
+    ring_buffer.emplace_back(i);
+  }
+  for (int i = 0; i < 500; ++i) {
+    REQUIRE(ring_buffer.front() == i);
+    ring_buffer.pop_front();
+  }
+
+  REQUIRE(ring_buffer.size() == 500);
+  REQUIRE(ring_buffer.capacity() == 1024);
+  REQUIRE(ring_buffer.front() == 500);
+  REQUIRE(ring_buffer.back() == 999);
+}
+
+int main(int argc, char* const argv[]) {
+  krbn::thread_utility::register_main_thread();
+  return Catch::Session().run(argc, argv);
+}
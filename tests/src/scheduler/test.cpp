@@ -0,0 +1,179 @@
+#define CATCH_CONFIG_RUNNER
+#include "../../vendor/catch/catch.hpp"
+
+#include "manipulator/manipulator_managers_connector.hpp"
+#include "manipulator/manipulator_timer.hpp"
+#include "simulated_scheduler.hpp"
+#include "thread_utility.hpp"
+#include "time_utility.hpp"
+
+TEST_CASE("simulated_scheduler") {
+  krbn::simulated_scheduler scheduler(1000);
+  std::vector<std::string> invoked;
+
+  REQUIRE(scheduler.now() == 1000);
+
+  auto timer1 = scheduler.make_timer(3000, [&] {
+    invoked.push_back("3000");
+  });
+  auto timer2 = scheduler.make_timer(2000, [&] {
+    invoked.push_back("2000a");
+  });
+  auto timer3 = scheduler.make_timer(2000, [&] {
+    invoked.push_back("2000b");
+  });
+  auto timer4 = scheduler.make_timer(2500, [&] {
+    invoked.push_back("2500");
+  });
+
+  REQUIRE(scheduler.get_pending_timer_count() == 4);
+
+  // Destroyed timers are not invoked.
+  timer4 = nullptr;
+  REQUIRE(scheduler.get_pending_timer_count() == 3);
+
+  scheduler.advance_to(1500);
+  REQUIRE(scheduler.now() == 1500);
+  REQUIRE(invoked.empty());
+
+  scheduler.advance_to(2000);
+  REQUIRE(invoked == std::vector<std::string>({"2000a", "2000b"}));
+  REQUIRE(timer2->fired());
+  REQUIRE(timer3->fired());
+  REQUIRE(!timer1->fired());
+
+  // A timer made in a timer function.
+  std::unique_ptr<krbn::scheduler::timer> timer5;
+  auto timer6 = scheduler.make_timer(2100, [&] {
+    invoked.push_back("2100");
+    REQUIRE(scheduler.now() == 2100);
+    timer5 = scheduler.make_timer(scheduler.now() + 100, [&] {
+      invoked.push_back("2200");
+    });
+  });
+
+  scheduler.advance_by(10000);
+  REQUIRE(scheduler.now() == 12000);
+  REQUIRE(invoked == std::vector<std::string>({"2000a", "2000b", "2100", "2200", "3000"}));
+  REQUIRE(scheduler.get_pending_timer_count() == 0);
+}
+
+TEST_CASE("manipulator_timer") {
+  auto scheduler = std::make_shared<krbn::simulated_scheduler>();
+  krbn::manipulator::manipulator_timer::core core(scheduler);
+  core.enable();
+
+  std::vector<uint64_t> invoked;
+
+  core.add_entry(300, [&](auto timer_id) {
+    invoked.push_back(scheduler->now());
+  });
+  auto timer_id = core.add_entry(100, [&](auto timer_id) {
+    invoked.push_back(scheduler->now());
+  });
+  core.add_entry(200, [&](auto timer_id) {
+    invoked.push_back(scheduler->now());
+  });
+
+  // Only the earliest entry is armed.
+  REQUIRE(scheduler->get_pending_timer_count() == 1);
+
+  core.cancel_entry(timer_id);
+  REQUIRE(scheduler->get_pending_timer_count() == 1);
+
+  scheduler->advance_to(1000);
+  REQUIRE(invoked == std::vector<uint64_t>({200, 300}));
+  REQUIRE(core.get_stats().wakeup_count == 2);
+  REQUIRE(core.get_stats().avoided_wakeup_count == 1);
+  REQUIRE(scheduler->get_pending_timer_count() == 0);
+
+  core.disable();
+  core.add_entry(2000, nullptr);
+  REQUIRE(scheduler->get_pending_timer_count() == 0);
+
+  core.enable();
+  REQUIRE(scheduler->get_pending_timer_count() == 1);
+}
+
+TEST_CASE("to_delayed_action") {
+  auto scheduler = std::make_shared<krbn::simulated_scheduler>(krbn::time_utility::nano_to_absolute(NSEC_PER_SEC));
+  auto& manipulator_timer = krbn::manipulator::manipulator_timer::get_instance();
+  manipulator_timer.set_scheduler(scheduler);
+  manipulator_timer.enable();
+
+  {
+    krbn::manipulator::manipulator_manager manipulator_manager;
+    krbn::core_configuration::profile::complex_modifications::parameters parameters;
+    manipulator_manager.push_back_manipulator(nlohmann::json::parse(R"(
+      {
+        "type": "basic",
+        "from": {"key_code": "a"},
+        "to": [{"key_code": "b"}],
+        "to_delayed_action": {
+          "to_invoked": [{"key_code": "c"}],
+          "to_canceled": [{"key_code": "d"}]
+        }
+      }
+    )"),
+                                              parameters);
+
+    auto input_event_queue = std::make_shared<krbn::event_queue>();
+    auto output_event_queue = std::make_shared<krbn::event_queue>();
+
+    auto key = [&](krbn::key_code key_code, krbn::event_type event_type) {
+      krbn::event_queue::queued_event::event event(key_code);
+      input_event_queue->emplace_back_event(krbn::device_id(1),
+                                            scheduler->now(),
+                                            event,
+                                            event_type,
+                                            event);
+      manipulator_manager.manipulate(input_event_queue, output_event_queue);
+    };
+
+    auto key_codes = [&] {
+      std::vector<krbn::key_code> result;
+      for (const auto& e : output_event_queue->get_events()) {
+        if (e.get_event_type() == krbn::event_type::key_down) {
+          if (auto key_code = e.get_event().get_key_code()) {
+            result.push_back(*key_code);
+          }
+        }
+      }
+      return result;
+    };
+
+    // to_invoked
+
+    key(krbn::key_code::a, krbn::event_type::key_down);
+    key(krbn::key_code::a, krbn::event_type::key_up);
+    scheduler->advance_by(krbn::time_utility::nano_to_absolute(299 * NSEC_PER_MSEC));
+    REQUIRE(key_codes() == std::vector<krbn::key_code>({krbn::key_code::b}));
+
+    scheduler->advance_by(krbn::time_utility::nano_to_absolute(1 * NSEC_PER_MSEC));
+    REQUIRE(key_codes() == std::vector<krbn::key_code>({krbn::key_code::b,
+                                                        krbn::key_code::c}));
+
+    // to_canceled
+
+    output_event_queue->clear_events();
+    key(krbn::key_code::a, krbn::event_type::key_down);
+    key(krbn::key_code::a, krbn::event_type::key_up);
+    scheduler->advance_by(krbn::time_utility::nano_to_absolute(100 * NSEC_PER_MSEC));
+    key(krbn::key_code::x, krbn::event_type::key_down);
+    key(krbn::key_code::x, krbn::event_type::key_up);
+    REQUIRE(key_codes() == std::vector<krbn::key_code>({krbn::key_code::b,
+                                                        krbn::key_code::d,
+                                                        krbn::key_code::x}));
+
+    // The canceled entry does not wake the scheduler.
+    REQUIRE(scheduler->get_pending_timer_count() == 0);
+  }
+
+  manipulator_timer.disable();
+  manipulator_timer.set_scheduler(krbn::main_queue_scheduler::get_instance());
+}
+
+int main(int argc, char* const argv[]) {
+  krbn::thread_utility::register_main_thread();
+  return Catch::Session().run(argc, argv);
+}
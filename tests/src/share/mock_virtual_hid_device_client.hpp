@@ -0,0 +1,123 @@
+#pragma once
+
+#include "virtual_hid_device_client.hpp"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace krbn {
+namespace unit_testing {
+// A substitute of `virtual_hid_device_client` for `post_event_to_virtual_devices::post_events`.
+// It counts method calls and records key transitions which are posted via keyboard events and keyboard reports.
+class mock_virtual_hid_device_client final {
+public:
+  mock_virtual_hid_device_client(void) : dispatch_keyboard_event_count_(0),
+                                         post_keyboard_input_report_count_(0),
+                                         clear_keyboard_modifier_flags_count_(0),
+                                         reset_virtual_hid_keyboard_count_(0),
+                                         post_pointing_input_report_count_(0) {
+  }
+
+  void dispatch_keyboard_event(const pqrs::karabiner_virtual_hid_device::hid_event_service::keyboard_event& keyboard_event) {
+    ++dispatch_keyboard_event_count_;
+
+    key_transitions_.emplace_back(std::make_pair(static_cast<uint32_t>(keyboard_event.usage_page),
+                                                 static_cast<uint32_t>(keyboard_event.usage)),
+                                  keyboard_event.value != 0);
+  }
+
+  void post_keyboard_input_report(const pqrs::karabiner_virtual_hid_device::hid_report::keyboard_input& report) {
+    ++post_keyboard_input_report_count_;
+
+    set_keyboard_input(report);
+  }
+
+  void clear_keyboard_modifier_flags(void) {
+    ++clear_keyboard_modifier_flags_count_;
+  }
+
+  void reset_virtual_hid_keyboard(void) {
+    ++reset_virtual_hid_keyboard_count_;
+
+    set_keyboard_input(pqrs::karabiner_virtual_hid_device::hid_report::keyboard_input());
+  }
+
+  void post_pointing_input_report(const pqrs::karabiner_virtual_hid_device::hid_report::pointing_input& report) {
+    ++post_pointing_input_report_count_;
+  }
+
+  size_t get_dispatch_keyboard_event_count(void) const {
+    return dispatch_keyboard_event_count_;
+  }
+
+  size_t get_post_keyboard_input_report_count(void) const {
+    return post_keyboard_input_report_count_;
+  }
+
+  size_t get_clear_keyboard_modifier_flags_count(void) const {
+    return clear_keyboard_modifier_flags_count_;
+  }
+
+  size_t get_reset_virtual_hid_keyboard_count(void) const {
+    return reset_virtual_hid_keyboard_count_;
+  }
+
+  size_t get_post_pointing_input_report_count(void) const {
+    return post_pointing_input_report_count_;
+  }
+
+  size_t get_call_count(void) const {
+    return dispatch_keyboard_event_count_ +
+           post_keyboard_input_report_count_ +
+           clear_keyboard_modifier_flags_count_ +
+           reset_virtual_hid_keyboard_count_ +
+           post_pointing_input_report_count_;
+  }
+
+  // ((usage_page, usage), pressed)
+  const std::vector<std::pair<std::pair<uint32_t, uint32_t>, bool>>& get_key_transitions(void) const {
+    return key_transitions_;
+  }
+
+  const pqrs::karabiner_virtual_hid_device::hid_report::keyboard_input& get_keyboard_input(void) const {
+    return keyboard_input_;
+  }
+
+private:
+  void set_keyboard_input(const pqrs::karabiner_virtual_hid_device::hid_report::keyboard_input& report) {
+    auto usage_page = static_cast<uint32_t>(pqrs::karabiner_virtual_hid_device::usage_page::keyboard_or_keypad);
+
+    for (uint32_t i = 0; i < 8; ++i) {
+      bool before = (keyboard_input_.modifiers >> i) & 0x1;
+      bool after = (report.modifiers >> i) & 0x1;
+      if (before != after) {
+        key_transitions_.emplace_back(std::make_pair(usage_page, static_cast<uint32_t>(key_code::left_control) + i), after);
+      }
+    }
+
+    for (const auto& k : keyboard_input_.keys) {
+      if (k != 0 && std::find(std::begin(report.keys), std::end(report.keys), k) == std::end(report.keys)) {
+        key_transitions_.emplace_back(std::make_pair(usage_page, k), false);
+      }
+    }
+    for (const auto& k : report.keys) {
+      if (k != 0 && std::find(std::begin(keyboard_input_.keys), std::end(keyboard_input_.keys), k) == std::end(keyboard_input_.keys)) {
+        key_transitions_.emplace_back(std::make_pair(usage_page, k), true);
+      }
+    }
+
+    keyboard_input_ = report;
+  }
+
+  size_t dispatch_keyboard_event_count_;
+  size_t post_keyboard_input_report_count_;
+  size_t clear_keyboard_modifier_flags_count_;
+  size_t reset_virtual_hid_keyboard_count_;
+  size_t post_pointing_input_report_count_;
+
+  pqrs::karabiner_virtual_hid_device::hid_report::keyboard_input keyboard_input_;
+  std::vector<std::pair<std::pair<uint32_t, uint32_t>, bool>> key_transitions_;
+};
+} // namespace unit_testing
+} // namespace krbn
@@ -184,6 +184,22 @@ TEST_CASE("make_key_code") {
   }
 }
 
+TEST_CASE("get_key_code_name_table") {
+  const auto& table = krbn::types::get_key_code_name_table();
+  for (size_t i = 0; i < table.size(); ++i) {
+    REQUIRE(krbn::types::make_key_code(table.get_name(i)) == table.get_value(i));
+    REQUIRE(krbn::types::make_key_code_name(table.get_value(i)) != boost::none);
+  }
+
+  REQUIRE(krbn::types::make_key_code("") == boost::none);
+  REQUIRE(krbn::types::make_key_code("spacebar ") == boost::none);
+  REQUIRE(krbn::types::make_key_code(std::string("a\0b", 3)) == boost::none);
+  REQUIRE(krbn::types::make_key_code("vk_none") == krbn::key_code::vk_none);
+  REQUIRE(krbn::types::make_key_code_name(krbn::key_code::vk_none) == std::string("vk_none"));
+  REQUIRE(krbn::types::make_key_code_name(krbn::key_code(0xffff)) == boost::none);
+  REQUIRE(krbn::types::make_key_code_name(krbn::key_code(0x20000)) == boost::none);
+}
+
 TEST_CASE("make_key_code (modifier_flag)") {
   REQUIRE(krbn::types::make_key_code(krbn::modifier_flag::zero) == boost::none);
   REQUIRE(krbn::types::make_key_code(krbn::modifier_flag::caps_lock) == krbn::key_code::caps_lock);
@@ -217,6 +233,83 @@ TEST_CASE("make_modifier_flag") {
   REQUIRE(krbn::types::make_modifier_flag(krbn::hid_usage_page::button, krbn::hid_usage(1)) == boost::none);
 }
 
+TEST_CASE("key_code_attributes") {
+  // Every key_code in the name table round-trips.
+  const auto& table = krbn::types::get_key_code_name_table();
+  for (size_t i = 0; i < table.size(); ++i) {
+    auto key_code = table.get_value(i);
+    auto attributes = krbn::types::get_key_code_attributes(key_code);
+
+    REQUIRE(attributes.get_key_code() == key_code);
+    REQUIRE(krbn::types::make_modifier_flag(key_code) == (attributes.is_modifier() ? boost::make_optional(attributes.get_modifier_flag()) : boost::none));
+
+    if (key_code == krbn::key_code::vk_none) {
+      REQUIRE(!attributes.has_hid_usage());
+      REQUIRE(krbn::types::make_hid_usage_page(key_code) == boost::none);
+      REQUIRE(krbn::types::make_hid_usage(key_code) == boost::none);
+      continue;
+    }
+
+    REQUIRE(attributes.has_hid_usage());
+    REQUIRE(krbn::types::make_hid_usage_page(key_code) == attributes.get_hid_usage_page());
+    REQUIRE(krbn::types::make_hid_usage(key_code) == attributes.get_hid_usage());
+
+    auto found = krbn::types::find_key_code_attributes(attributes.get_hid_usage_page(), attributes.get_hid_usage());
+    if (attributes.get_hid_usage_page() == krbn::hid_usage_page::consumer ||
+        (attributes.get_hid_usage_page() == krbn::hid_usage_page::apple_vendor_top_case && key_code != krbn::key_code::fn) ||
+        attributes.get_hid_usage_page() == krbn::hid_usage_page::apple_vendor_keyboard) {
+      // These keys are received as consumer_key_code or are not received.
+      REQUIRE(!found.has_hid_usage());
+    } else {
+      REQUIRE(found.get_key_code() == key_code);
+      REQUIRE(found.get_modifier_flag() == attributes.get_modifier_flag());
+      REQUIRE(krbn::types::make_key_code(attributes.get_hid_usage_page(), attributes.get_hid_usage()) == key_code);
+    }
+  }
+
+  // Usages in keyboard_or_keypad usage page
+
+  for (uint32_t u = 0; u <= kHIDUsage_Keyboard_Reserved; ++u) {
+    auto key_code = krbn::types::make_key_code(krbn::hid_usage_page::keyboard_or_keypad, krbn::hid_usage(u));
+    if (kHIDUsage_KeyboardErrorUndefined < u && u < kHIDUsage_Keyboard_Reserved) {
+      REQUIRE(key_code == krbn::key_code(u));
+    } else {
+      REQUIRE(key_code == boost::none);
+    }
+  }
+
+  {
+    auto attributes = krbn::types::find_key_code_attributes(krbn::hid_usage_page::keyboard_or_keypad, krbn::hid_usage(kHIDUsage_KeyboardLeftShift));
+    REQUIRE(attributes.get_key_code() == krbn::key_code::left_shift);
+    REQUIRE(attributes.is_modifier());
+    REQUIRE(attributes.get_modifier_flag() == krbn::modifier_flag::left_shift);
+  }
+  {
+    auto attributes = krbn::types::find_key_code_attributes(krbn::hid_usage_page::keyboard_or_keypad, krbn::hid_usage(kHIDUsage_KeyboardMute));
+    REQUIRE(attributes.get_key_code() == krbn::key_code::mute);
+    REQUIRE(attributes.get_hid_usage_page() == krbn::hid_usage_page::consumer);
+    REQUIRE(attributes.get_hid_usage() == krbn::hid_usage::csmr_mute);
+    REQUIRE(!attributes.is_modifier());
+  }
+  {
+    auto attributes = krbn::types::find_key_code_attributes(krbn::hid_usage_page::apple_vendor_keyboard, krbn::hid_usage::apple_vendor_keyboard_function);
+    REQUIRE(attributes.get_key_code() == krbn::key_code::fn);
+    REQUIRE(attributes.get_hid_usage_page() == krbn::hid_usage_page::apple_vendor_top_case);
+    REQUIRE(attributes.get_modifier_flag() == krbn::modifier_flag::fn);
+  }
+
+  REQUIRE(!krbn::types::find_key_code_attributes(krbn::hid_usage_page::apple_vendor_keyboard, krbn::hid_usage::apple_vendor_keyboard_dashboard).has_hid_usage());
+  REQUIRE(!krbn::types::find_key_code_attributes(krbn::hid_usage_page::button, krbn::hid_usage(1)).has_hid_usage());
+  REQUIRE(!krbn::types::find_key_code_attributes(krbn::hid_usage_page::consumer, krbn::hid_usage::csmr_mute).has_hid_usage());
+
+  // Undefined key codes
+
+  REQUIRE(krbn::types::make_hid_usage_page(krbn::key_code(0x1234)) == krbn::hid_usage_page::keyboard_or_keypad);
+  REQUIRE(krbn::types::make_hid_usage(krbn::key_code(0x1234)) == krbn::hid_usage(0x1234));
+  REQUIRE(krbn::types::make_hid_usage_page(krbn::key_code::extra_) == boost::none);
+  REQUIRE(krbn::types::make_hid_usage_page(krbn::key_code(0x20000)) == boost::none);
+}
+
 TEST_CASE("make_consumer_key_code") {
   REQUIRE(krbn::types::make_consumer_key_code("mute") == krbn::consumer_key_code::mute);
   REQUIRE(!krbn::types::make_consumer_key_code("unknown"));
@@ -268,12 +361,12 @@ TEST_CASE("make_new_device_id") {
   REQUIRE(krbn::types::find_device_identifiers(device_id2)->get_is_keyboard() == false);
   REQUIRE(krbn::types::find_device_identifiers(device_id2)->get_is_pointing_device() == true);
 
-  REQUIRE(krbn::types::find_device_identifiers(krbn::device_id(-1)) == nullptr);
+  REQUIRE(!krbn::types::find_device_identifiers(krbn::device_id(-1)));
 
   krbn::types::detach_device_id(device_id1);
   krbn::types::detach_device_id(krbn::device_id(-1));
 
-  REQUIRE(krbn::types::find_device_identifiers(device_id1) == nullptr);
+  REQUIRE(!krbn::types::find_device_identifiers(device_id1));
 }
 
 int main(int argc, char* const argv[]) {